@@ -0,0 +1,31 @@
+#include "ArgsS.h"
+
+bool ArgsS::ParseCount(const std::string& s, unsigned& count)
+{
+  if (s.empty() || s.find_first_not_of("0123456789") != std::string::npos || s.length() > 9) return false;
+  count = static_cast<unsigned>(std::stoul(s));
+  return true;
+}
+
+bool ArgsS::ParseSize(const std::string& s, std::size_t& size)
+{
+  std::size_t digits(0);
+  while (digits < s.length() && s[digits] >= '0' && s[digits] <= '9') ++digits;
+  if (!digits || digits > 12) return false;
+  std::size_t shift(0);
+  if (digits < s.length())
+  {
+    if (digits + 1 != s.length()) return false;
+    switch (s[digits])
+    {
+      case 'K': case 'k': shift = 10; break;
+      case 'M': case 'm': shift = 20; break;
+      case 'G': case 'g': shift = 30; break;
+      default: return false;
+    }
+  }
+  const std::size_t value(static_cast<std::size_t>(std::stoull(s.substr(0, digits))) << shift);
+  if (!value) return false;
+  size = value;
+  return true;
+}
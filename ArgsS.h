@@ -0,0 +1,17 @@
+#ifndef ARGSS_H
+#define ARGSS_H
+
+#include <cstddef>
+#include <string>
+
+// parsers for the numeric values of command line options, shared by the tools and benchmarks
+struct ArgsS
+{
+  // parse a non-negative decimal count into 'count'; returns false (leaving it untouched) if invalid
+  static bool ParseCount(const std::string& s, unsigned& count);
+
+  // parse a byte count with optional K/M/G (binary) suffix into 'size'; returns false (leaving it untouched) if invalid
+  static bool ParseSize(const std::string& s, std::size_t& size);
+};
+
+#endif
@@ -0,0 +1,346 @@
+#include "BatchS.h"
+
+#include "OutputS.h"
+#include "ParallelS.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+  // queue of the files dealt to one worker
+  struct QueueS
+  {
+    std::mutex              mutexM;
+    std::deque<std::size_t> itemsM;
+  };
+
+  // take the next file for worker self: the front of its own queue, or failing that the back of another's
+  bool NextFile(std::vector<QueueS>& queues, const std::size_t self, std::size_t& fileNum)
+  {
+    for (std::size_t offset(0); offset < queues.size(); ++offset)
+    {
+      QueueS& queue(queues[(self + offset) % queues.size()]);
+      std::lock_guard<std::mutex> lock(queue.mutexM);
+      if (queue.itemsM.empty()) continue;
+      if (offset)
+      {
+        fileNum = queue.itemsM.back();
+        queue.itemsM.pop_back();
+      }
+      else
+      {
+        fileNum = queue.itemsM.front();
+        queue.itemsM.pop_front();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  // append the file names listed in stream, one per line, skipping blank lines
+  void ReadFileList(std::istream& stream, std::vector<std::string>& names)
+  {
+    std::string line;
+    while (std::getline(stream, line))
+    {
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      if (!line.empty()) names.push_back(line);
+    }
+  }
+
+  double SecondsSince(const std::chrono::steady_clock::time_point start)
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+BatchS::BatchS(const std::string& outExt)
+  : outExtM(outExt)
+  , threadsM(1)
+  , batchedM(false)
+  , secondsM(0)
+{
+}
+
+bool BatchS::ParseArg(const std::string& arg)
+{
+  if (!arg.compare(0, 6, "--dir="))
+  {
+    sourcesM.emplace_back(SRC_DIR, arg.substr(6));
+  }
+  else if (!arg.compare(0, 13, "--files-from="))
+  {
+    sourcesM.emplace_back(SRC_LIST, arg.substr(13));
+  }
+  else if (!arg.compare(0, 10, "--out-dir="))
+  {
+    outDirM = arg.substr(10);
+  }
+  else
+  {
+    return false;
+  }
+  batchedM = true;
+  return true;
+}
+
+void BatchS::AddFile(const std::string& filename)
+{
+  sourcesM.emplace_back(SRC_FILE, filename);
+}
+
+void BatchS::Expand()
+{
+  std::vector<std::string> names;
+  for (const std::pair<SourceE, std::string>& source : sourcesM)
+  {
+    switch (source.first)
+    {
+      case SRC_FILE: names.push_back(source.second); break;
+      case SRC_DIR:
+      {
+        std::vector<std::string> dirNames;
+        std::error_code error;
+        for (std::filesystem::directory_iterator entry(source.second, error), end; !error && entry != end;
+             entry.increment(error))
+        {
+          if (entry->is_regular_file(error)) dirNames.push_back(entry->path().string());
+        }
+        if (error) throw std::runtime_error("Failed to read input directory: '" + source.second + "'");
+        std::sort(dirNames.begin(), dirNames.end());
+        names.insert(names.end(), dirNames.begin(), dirNames.end());
+      }
+      break;
+      case SRC_LIST:
+      {
+        if (source.second == "-")
+        {
+          ReadFileList(std::cin, names);
+          break;
+        }
+        std::ifstream list(source.second);
+        if (!list.is_open()) throw std::runtime_error("Failed to open file list: '" + source.second + "' for read");
+        ReadFileList(list, names);
+      }
+      break;
+    }
+  }
+  filesM.clear();
+  for (const std::string& name : names) filesM.push_back(FileS{name, std::string(), false, std::string(), 0, 0, 0});
+}
+
+std::size_t BatchS::Workers() const
+{
+  const std::size_t threads(threadsM ? threadsM : std::thread::hardware_concurrency());
+  return std::max<std::size_t>(1, std::min(threads, filesM.size()));
+}
+
+std::size_t BatchS::Run(const JobT& job)
+{
+  const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+  const std::size_t workers(Workers());
+  // deal files out round-robin, so that the stdout writer below finds them finishing roughly in order; a file
+  //  whose output path is already taken by an earlier one fails without being run
+  std::vector<QueueS> queues(workers);
+  std::map<std::string, std::size_t> outputs;
+  if (!outDirM.empty())
+  {
+    std::error_code error;
+    std::filesystem::create_directories(outDirM, error);
+  }
+  for (std::size_t fileNum(0), dealt(0); fileNum < filesM.size(); ++fileNum)
+  {
+    FileS& file(filesM[fileNum]);
+    if (!outDirM.empty())
+    {
+      const std::filesystem::path input(file.inputM);
+      file.outputM = (std::filesystem::path(outDirM) / input.stem()).string() + outExtM;
+      const auto inserted(outputs.emplace(file.outputM, fileNum));
+      if (!inserted.second)
+      {
+        file.messageM = "Output file '" + file.outputM + "' is also that of '" +
+                        filesM[inserted.first->second].inputM + "'";
+        continue;
+      }
+    }
+    queues[dealt++ % workers].itemsM.push_back(fileNum);
+  }
+  // outputs to stdout are collected per file, and written out once all earlier files' are
+  OutputS stdOut(OutputS::FD_STDOUT);
+  std::mutex writeMutex;
+  // (files not queued for running have nothing to write)
+  std::vector<std::string> pending(filesM.size());
+  std::vector<bool> finished(filesM.size(), true);
+  for (const QueueS& queue : queues)
+  {
+    for (const std::size_t fileNum : queue.itemsM) finished[fileNum] = false;
+  }
+  std::size_t nextWrite(0);
+  std::string writeError;
+  auto write([&](const std::size_t fileNum, std::string&& output)
+  {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    pending[fileNum].swap(output);
+    finished[fileNum] = true;
+    for (; nextWrite < filesM.size() && finished[nextWrite]; ++nextWrite)
+    {
+      if (writeError.empty())
+      {
+        try
+        {
+          stdOut.Write(pending[nextWrite]);
+        }
+        catch (const std::exception& e)
+        {
+          writeError = e.what();
+        }
+      }
+      std::string().swap(pending[nextWrite]);
+    }
+  });
+  ParallelS::Run(workers, [this, &job, &queues, &write](const std::size_t self)
+  {
+    std::size_t fileNum(0);
+    while (NextFile(queues, self, fileNum))
+    {
+      FileS& file(filesM[fileNum]);
+      if (!outDirM.empty())
+      {
+        RunFile(file, job, nullptr);
+        continue;
+      }
+      std::ostringstream buffer;
+      {
+        OutputS out(buffer);
+        RunFile(file, job, &out);
+      }
+      write(fileNum, file.okM ? buffer.str() : std::string());
+    }
+  });
+  if (writeError.empty())
+  {
+    try
+    {
+      stdOut.Flush();
+    }
+    catch (const std::exception& e)
+    {
+      writeError = e.what();
+    }
+  }
+  secondsM = SecondsSince(start);
+  if (!writeError.empty()) throw std::runtime_error(writeError);
+  std::size_t failed(0);
+  for (const FileS& file : filesM) failed += !file.okM;
+  return failed;
+}
+
+void BatchS::RunFile(FileS& file, const JobT& job, OutputS* const out) const
+{
+  const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+  std::error_code error;
+  const std::uintmax_t size(std::filesystem::file_size(file.inputM, error));
+  file.bytesInM = error ? 0 : static_cast<std::size_t>(size);
+  // set once the output file has been created, and so is ours to remove on failure
+  bool created(false);
+  try
+  {
+    if (out)
+    {
+      file.messageM = job(file.inputM, *out);
+      out->Flush();
+      file.bytesOutM = out->BytesWritten();
+    }
+    else
+    {
+      // inputs are memory-mapped, so truncating one for output would pull the rug out from under its own job
+      if (std::filesystem::equivalent(file.inputM, file.outputM, error))
+      {
+        throw std::runtime_error("Output file '" + file.outputM + "' is the input file");
+      }
+      std::ofstream stream(file.outputM, std::ios::binary | std::ios::trunc);
+      if (!stream.is_open())
+      {
+        throw std::runtime_error("Failed to open output file: '" + file.outputM + "' for write");
+      }
+      created = true;
+      OutputS fileOut(stream);
+      file.messageM = job(file.inputM, fileOut);
+      fileOut.Flush();
+      file.bytesOutM = fileOut.BytesWritten();
+    }
+    file.okM = true;
+  }
+  catch (const std::exception& e)
+  {
+    file.okM = false;
+    file.messageM = e.what();
+    file.bytesOutM = 0;
+    if (created) std::remove(file.outputM.c_str());
+  }
+  file.secondsM = SecondsSince(start);
+}
+
+void BatchS::PrintReport(std::ostream& out) const
+{
+  out << "status      seconds        bytes in       bytes out     MB/s  file\n";
+  std::size_t failed(0);
+  std::size_t bytesIn(0);
+  char line[256];
+  for (const FileS& file : filesM)
+  {
+    failed += !file.okM;
+    bytesIn += file.bytesInM;
+    const double mbPerSec(file.secondsM > 0 ? file.bytesInM / file.secondsM / (1 << 20) : 0);
+    std::snprintf(line, sizeof(line), "%-6s %12.6f %15zu %15zu %8.1f  ", file.okM ? "ok" : "FAILED", file.secondsM,
+                  file.bytesInM, file.bytesOutM, mbPerSec);
+    out << line << file.inputM;
+    if (!file.messageM.empty()) out << ": " << file.messageM;
+    out << '\n';
+  }
+  std::snprintf(line, sizeof(line), "files: %zu, ok: %zu, failed: %zu, seconds: %.6f, MB/s: %.1f\n", filesM.size(),
+                filesM.size() - failed, failed, secondsM, secondsM > 0 ? bytesIn / secondsM / (1 << 20) : 0);
+  out << line;
+}
+
+int BatchS::Main(const std::string& argv0, const JobT& job)
+{
+  try
+  {
+    Expand();
+  }
+  catch (const std::runtime_error& e)
+  {
+    std::cerr << argv0 << ": " << e.what() << "\n";
+    return -1;
+  }
+  if (filesM.empty())
+  {
+    std::cerr << argv0 << ": No input files specified\n";
+    return -1;
+  }
+  std::size_t failed(0);
+  try
+  {
+    failed = Run(job);
+  }
+  catch (const std::runtime_error& e)
+  {
+    PrintReport(std::cerr);
+    std::cerr << argv0 << ": " << e.what() << "\n";
+    return -2;
+  }
+  PrintReport(std::cerr);
+  return failed ? -2 : 0;
+}
@@ -0,0 +1,102 @@
+#ifndef BATCHS_H
+#define BATCHS_H
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct OutputS;
+
+// batch mode of the tools: runs a per-file conversion over many input files in one process
+// files are dealt out to a pool of worker threads, each of which works through its own queue and then steals from
+//  the back of the others', so that a few large files don't leave the rest of the pool idle
+// each file's output either goes to a file of the same name (with the tool's extension) in an output directory, or,
+//  without one, to stdout, in input order regardless of the order in which files finish
+// a file whose conversion fails (throws) is recorded as failed, contributes no output, and the rest of the batch
+//  carries on
+struct BatchS
+{
+  // an input file and the outcome of processing it
+  struct FileS
+  {
+    std::string inputM;
+    // output file path; empty when writing to stdout
+    std::string outputM;
+    bool        okM;
+    // error message if failed, otherwise any note returned by the conversion
+    std::string messageM;
+    std::size_t bytesInM;
+    std::size_t bytesOutM;
+    double      secondsM;
+  };
+
+  // conversion of one input file to output; returns a note for the report (or an empty string), and throws
+  //  std::exception on failure
+  typedef std::function<std::string(const std::string& input, OutputS& out)> JobT;
+
+  // files to process, in input order; filled in by Expand()
+  std::vector<FileS> filesM;
+  // directory to write outputs to; empty to write them all to stdout
+  std::string outDirM;
+  // extension given to output files in outDirM, replacing that of the input (e.g. ".wiki")
+  std::string outExtM;
+  // number of worker threads (0 means one per hardware thread)
+  unsigned threadsM;
+
+  // construct an empty batch, writing files with the given extension
+  explicit BatchS(const std::string& outExt);
+
+  // handle a batch mode command line option, returning false if arg isn't one:
+  // --dir=DIR         add all files in DIR, in name order
+  // --files-from=LIST add the files named in LIST, one per line ("-" for stdin)
+  // --out-dir=DIR     write outputs to DIR instead of stdout
+  bool ParseArg(const std::string& arg);
+
+  // add a single input file
+  void AddFile(const std::string& filename);
+
+  // true if any batch mode option was given
+  bool Batched() const { return batchedM; }
+
+  // build filesM from the inputs given so far, in command line order
+  // throws std::runtime_error if a directory or file list can't be read
+  void Expand();
+
+  // number of worker threads Run() will use
+  std::size_t Workers() const;
+
+  // run job on all files, and return the number that failed
+  // throws std::runtime_error if writing to stdout fails
+  std::size_t Run(const JobT& job);
+
+  // print the outcome of each file, and totals
+  void PrintReport(std::ostream& out) const;
+
+  // a tool's batch mode: Expand(), Run() and PrintReport() to stderr, writing any error that stops the batch to
+  //  stderr, prefixed with argv0
+  // returns the tool's exit code: -1 if there are no usable inputs, -2 if any file failed or output couldn't be
+  //  written, otherwise 0
+  int Main(const std::string& argv0, const JobT& job);
+
+private:
+  enum SourceE
+  {
+    SRC_FILE,
+    SRC_DIR,
+    SRC_LIST
+  };
+
+  // process one file, filling in its outcome; out is null if it goes to its own output file
+  void RunFile(FileS& file, const JobT& job, OutputS* out) const;
+
+  // inputs in command line order
+  std::vector<std::pair<SourceE, std::string>> sourcesM;
+  bool batchedM;
+  // wall time of the last Run()
+  double secondsM;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "BlockReaderS.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+BlockReaderS::BlockReaderS(const std::string& filename, const bool lineAligned, const std::size_t numBlocks,
+                           const std::size_t blockSize)
+  : inM(&std::cin)
+  , lineAlignedM(lineAligned)
+  , fullM(numBlocks)
+  , freeM(numBlocks)
+  , stoppedM(false)
+  , peekedM(nullptr)
+{
+  if (filename != MappedFileS::STDIN_NAME)
+  {
+    fileM.open(filename, std::ios::binary);
+    if (!fileM.is_open())
+    {
+      throw std::runtime_error(std::string("Failed to open input file: '") + filename + "' for read");
+    }
+    inM = &fileM;
+  }
+  for (std::size_t blockNum(0); blockNum < (numBlocks ? numBlocks : 1); ++blockNum)
+  {
+    blocksM.push_back(std::make_unique<BlockS>());
+    blocksM.back()->dataM.resize(blockSize ? blockSize : 1);
+    blocksM.back()->usedM = 0;
+    freeM.Push(blocksM.back().get());
+  }
+  threadM = std::thread(&BlockReaderS::Read, this);
+}
+
+BlockReaderS::~BlockReaderS()
+{
+  Stop();
+  threadM.join();
+}
+
+BlockReaderS::BlockS* BlockReaderS::Next()
+{
+  if (peekedM) return std::exchange(peekedM, nullptr);
+  BlockS* block(nullptr);
+  if (fullM.Pop(block)) return block;
+  // unless stopped, the reader thread has closed the channel, so errorM is settled
+  if (!stoppedM && errorM) std::rethrow_exception(errorM);
+  return nullptr;
+}
+
+const BlockReaderS::BlockS* BlockReaderS::Peek()
+{
+  if (!peekedM) peekedM = Next();
+  return peekedM;
+}
+
+void BlockReaderS::Release(BlockS* block)
+{
+  freeM.Push(std::move(block));
+}
+
+void BlockReaderS::Stop()
+{
+  stoppedM = true;
+  fullM.Close();
+  freeM.Close();
+}
+
+void BlockReaderS::Read()
+{
+  try
+  {
+    // partial line at the end of the last block, to start the next one
+    std::string carry;
+    bool eof(false);
+    while (!eof)
+    {
+      BlockS* block(nullptr);
+      if (!freeM.Pop(block)) break;
+      std::vector<char>& data(block->dataM);
+      if (carry.length() >= data.size()) data.resize(carry.length() * 2);
+      if (!carry.empty()) std::memcpy(data.data(), carry.data(), carry.length());
+      block->usedM = carry.length();
+      carry.clear();
+      for (;;)
+      {
+        inM->read(data.data() + block->usedM, static_cast<std::streamsize>(data.size() - block->usedM));
+        block->usedM += static_cast<std::size_t>(inM->gcount());
+        if (inM->bad()) throw std::runtime_error("Failed to read input");
+        eof = !*inM;
+        if (eof || !lineAlignedM) break;
+        // keep filling a block that doesn't hold a whole line yet
+        const CellT text(block->View());
+        const std::size_t lastNewline(text.rfind('\n'));
+        if (lastNewline != CellT::npos)
+        {
+          carry.assign(text.substr(lastNewline + 1));
+          block->usedM = lastNewline + 1;
+          break;
+        }
+        data.resize(data.size() * 2);
+      }
+      // nothing more was read into the last block
+      if (!block->usedM) break;
+      if (!fullM.Push(std::move(block))) break;
+    }
+  }
+  catch (...)
+  {
+    errorM = std::current_exception();
+  }
+  fullM.Close();
+}
@@ -0,0 +1,89 @@
+#ifndef BLOCKREADERS_H
+#define BLOCKREADERS_H
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "ChannelS.h"
+#include "MappedFileS.h"
+
+// reader of an input file (or stdin) on a thread of its own, which fills a small pool of fixed-size blocks ahead of
+//  the consumer, so that reading overlaps with processing what was read
+// blocks are handed to the consumer in input order, and recycled once it hands them back; the reader waits while all
+//  of them are taken, so it can't run further ahead than the pool allows (with two blocks, one is filled while the
+//  other is processed)
+struct BlockReaderS
+{
+  typedef std::string_view CellT;
+
+  // default block size
+  static const std::size_t BLOCK_SIZE = 1 << 20;
+
+  // a block of input
+  struct BlockS
+  {
+    std::vector<char> dataM;
+    std::size_t       usedM;
+
+    CellT View() const { return CellT(dataM.data(), usedM); }
+  };
+
+  // open filename (or stdin, if it's MappedFileS::STDIN_NAME), and start reading it into numBlocks blocks of
+  //  blockSize bytes
+  // if lineAligned is set, each block but the last ends just after a newline: the partial line at the end of what was
+  //  read is moved to the start of the next block, and a block is grown if a single line fills it
+  // throws std::runtime_error if file cannot be opened
+  BlockReaderS(const std::string& filename, bool lineAligned, std::size_t numBlocks = 2,
+               std::size_t blockSize = BLOCK_SIZE);
+
+  // stop reading (once any read in progress returns), and wait for the reader thread
+  ~BlockReaderS();
+
+  BlockReaderS(const BlockReaderS&) = delete;
+  BlockReaderS& operator=(const BlockReaderS&) = delete;
+
+  // take the next block, waiting while it's being read; returns nullptr once all blocks have been taken
+  // each block taken must be handed back with Release() for the reader to reuse, but need not be before the next
+  //  one is taken
+  // throws std::runtime_error if reading failed
+  BlockS* Next();
+
+  // look at the next block without taking it, waiting while it's being read; it's still returned by the next call
+  //  to Next(), so this lets the start of the input be inspected before deciding how to consume it
+  // returns nullptr if there are no more blocks; throws std::runtime_error if reading failed
+  const BlockS* Peek();
+
+  // hand back a block taken with Next()
+  void Release(BlockS* block);
+
+  // stop reading, as if the input ended after the blocks already filled, waking the reader thread (unless it's in
+  //  the middle of a read) and any thread waiting in Next()
+  // read errors are no longer reported after this
+  void Stop();
+
+private:
+  // reader thread body
+  void Read();
+
+  std::ifstream                        fileM;
+  std::istream*                        inM;
+  bool                                 lineAlignedM;
+  std::vector<std::unique_ptr<BlockS>> blocksM;
+  // blocks filled and waiting to be taken, and blocks free to be filled
+  ChannelS<BlockS*>                    fullM;
+  ChannelS<BlockS*>                    freeM;
+  std::atomic<bool>                    stoppedM;
+  // block taken by Peek(), to be returned by Next()
+  BlockS*                              peekedM;
+  // set by the reader thread before it closes fullM
+  std::exception_ptr                   errorM;
+  std::thread                          threadM;
+};
+
+#endif
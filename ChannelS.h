@@ -0,0 +1,65 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// bounded queue for handing items from one pipeline stage to the next, each running on its own thread
+// the producer blocks while the queue is full, so a fast stage can't run arbitrarily far ahead of a slow one; either
+//  side can close the channel: the producer once it's done, or the consumer to stop the producer early
+template <typename T>
+struct ChannelS
+{
+  // construct an open channel holding up to capacity items
+  explicit ChannelS(const std::size_t capacity) : capacityM(capacity ? capacity : 1), closedM(false) {}
+
+  ChannelS(const ChannelS&) = delete;
+  ChannelS& operator=(const ChannelS&) = delete;
+
+  // add an item, waiting while the channel is full
+  // returns false, dropping the item, if the channel is (or gets) closed
+  bool Push(T&& item)
+  {
+    std::unique_lock<std::mutex> lock(mutexM);
+    notFullM.wait(lock, [this]() { return closedM || itemsM.size() < capacityM; });
+    if (closedM) return false;
+    itemsM.push_back(std::move(item));
+    notEmptyM.notify_one();
+    return true;
+  }
+
+  // take the next item, waiting while the channel is empty
+  // returns false once the channel is closed and all items pushed before then have been taken
+  bool Pop(T& item)
+  {
+    std::unique_lock<std::mutex> lock(mutexM);
+    notEmptyM.wait(lock, [this]() { return closedM || !itemsM.empty(); });
+    if (itemsM.empty()) return false;
+    item = std::move(itemsM.front());
+    itemsM.pop_front();
+    notFullM.notify_one();
+    return true;
+  }
+
+  // stop accepting items, and wake all waiting threads
+  void Close()
+  {
+    std::lock_guard<std::mutex> lock(mutexM);
+    closedM = true;
+    notFullM.notify_all();
+    notEmptyM.notify_all();
+  }
+
+private:
+  std::mutex              mutexM;
+  std::condition_variable notFullM;
+  std::condition_variable notEmptyM;
+  std::deque<T>           itemsM;
+  std::size_t             capacityM;
+  bool                    closedM;
+};
+
+#endif
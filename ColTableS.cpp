@@ -0,0 +1,444 @@
+#include "ColTableS.h"
+
+#include "MappedFileS.h"
+#include "OutputS.h"
+#include "ParallelS.h"
+#include "SnapshotS.h"
+#include "StatsS.h"
+#include "TitleKeyS.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace
+{
+  // minimum input bytes per LoadTSV() worker thread
+  const std::size_t MIN_LOAD_CHUNK(1 << 20);
+  // minimum cells per column joining or cleaning worker thread
+  const std::size_t MIN_COLUMN_CELLS(1 << 18);
+  // minimum rows per sort worker thread
+  const std::size_t MIN_SORT_ROWS(1 << 15);
+  // most a value can grow by being cleaned as a title (italic markup added at both ends)
+  const std::size_t MAX_TITLE_GROWTH(4);
+  // rows a loader takes before sizing its columns for the rest of its text
+  const std::size_t SAMPLE_ROWS(4096);
+
+  // sort key of a row's title, and the row's number
+  struct SortEntryS
+  {
+    ColTableS::CellT keyM;
+    ColTableS::RowT  rowM;
+
+    bool operator<(const SortEntryS& other) const { return keyM < other.keyM; }
+  };
+
+  // loader of a contiguous range of rows into columns of its own, which are later joined into the table's
+  struct PartS
+  {
+    std::vector<ColTableS::ColumnS> columnsM;
+    std::size_t                     numRowsM;
+    std::size_t                     numCellsM;
+    // length of the text the rows come from, if known
+    std::size_t                     textLengthM;
+
+    PartS() : numRowsM(0), numCellsM(0), textLengthM(0) {}
+
+    void AddRow(const TableS::ColListT& row)
+    {
+      // a column first seen in this row reads as empty in earlier ones
+      while (columnsM.size() < row.size())
+      {
+        columnsM.emplace_back();
+        columnsM.back().offsetsM.assign(numRowsM + 1, 0);
+      }
+      // likewise, columns this row doesn't reach are padded with empty values
+      for (std::size_t col(0); col < columnsM.size(); ++col)
+      {
+        columnsM[col].Append(col < row.size() ? row[col] : ColTableS::CellT());
+      }
+      ++numRowsM;
+      numCellsM += row.size();
+      if (numRowsM == SAMPLE_ROWS && textLengthM) Reserve();
+    }
+
+    // reserve room in each column for the rest of the text, going by how much of it the rows so far took up (their
+    //  values, plus a delimiter per value), so that columns aren't regrown all the way through it
+    void Reserve()
+    {
+      std::size_t sampleLength(0);
+      for (const ColTableS::ColumnS& column : columnsM) sampleLength += column.bytesM.length() + numRowsM;
+      if (!sampleLength || sampleLength >= textLengthM) return;
+      // (a little extra, as rows vary)
+      const double scale(static_cast<double>(textLengthM) / sampleLength * 1.125);
+      for (ColTableS::ColumnS& column : columnsM)
+      {
+        column.bytesM.reserve(static_cast<std::size_t>(column.bytesM.length() * scale));
+        column.offsetsM.reserve(static_cast<std::size_t>(column.offsetsM.size() * scale));
+      }
+    }
+  };
+
+  // number of threads to split work over the given number of columns, at most one per column
+  std::size_t ColumnThreads(const unsigned requested, const std::size_t numCols, const std::size_t numRows,
+                            const std::size_t minCells)
+  {
+    return std::max<std::size_t>(1, std::min(numCols, ParallelS::NumThreads(requested, numCols * numRows, minCells)));
+  }
+}
+
+ColTableS::ColTableS()
+{
+}
+
+void ColTableS::LoadTSV(const std::string& filename)
+{
+  // open first, so that a failure leaves the current contents intact
+  MappedFileS inFile;
+  {
+    StatsS::TimerS timer(tableM.statsM, StatsS::PH_READ);
+    inFile.Open(filename);
+    timer.Count(inFile.View().length(), 0, 0);
+  }
+  tableM.Clear();
+  columnsM.clear();
+  orderM.clear();
+  tableM.inputM = std::move(inFile);
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_TOKENIZE);
+  const CellT text(tableM.inputM.View());
+  std::vector<PartS> parts;
+  if (SnapshotS::Detect(text))
+  {
+    // a snapshot's rows are already split, so parts are ranges of rows rather than of text
+    const SnapshotS snapshot(text);
+    for (std::size_t col(0); col < snapshot.NumCols(); ++col) tableM.headerM.push_back(snapshot.Cell(col));
+    const std::size_t numRows(snapshot.NumRows() - 1);
+    const std::size_t threads(ParallelS::NumThreads(tableM.threadsM, text.length(), MIN_LOAD_CHUNK));
+    parts.resize(threads);
+    ParallelS::Run(threads, [&snapshot, numRows, threads, &parts](const std::size_t part)
+    {
+      PartS& loader(parts[part]);
+      TableS::ColListT row;
+      // (data row n is snapshot row n + 1)
+      for (std::size_t rowNum(numRows * part / threads + 1); rowNum <= numRows * (part + 1) / threads; ++rowNum)
+      {
+        row.clear();
+        for (std::size_t cell(snapshot.RowBegin(rowNum)); cell < snapshot.RowEnd(rowNum); ++cell)
+        {
+          row.push_back(snapshot.Cell(cell));
+        }
+        loader.AddRow(row);
+      }
+    });
+  }
+  else
+  {
+    // header line first, so that parts only see data rows
+    std::size_t bodyStart(text.find('\n'));
+    bodyStart = (bodyStart == CellT::npos ? text.length() : bodyStart + 1);
+    TableS::ForEachTSVRow(text.substr(0, bodyStart), [this](const TableS::ColListT& row)
+    {
+      tableM.headerM.assign(row.begin(), row.end());
+    });
+    // split body into one chunk per thread, moving each boundary to just past the next newline, and load each
+    const CellT body(text.substr(bodyStart));
+    const std::size_t threads(ParallelS::NumThreads(tableM.threadsM, body.length(), MIN_LOAD_CHUNK));
+    std::vector<std::size_t> bounds(threads + 1, body.length());
+    bounds[0] = 0;
+    for (std::size_t part(1); part < threads; ++part)
+    {
+      const std::size_t newline(body.find('\n', std::max(bounds[part - 1], body.length() * part / threads)));
+      bounds[part] = (newline == CellT::npos ? body.length() : newline + 1);
+    }
+    parts.resize(threads);
+    ParallelS::Run(threads, [&body, &bounds, &parts](const std::size_t part)
+    {
+      PartS& loader(parts[part]);
+      loader.textLengthM = bounds[part + 1] - bounds[part];
+      TableS::ForEachTSVRow(body.substr(bounds[part], bounds[part + 1] - bounds[part]),
+                            [&loader](const TableS::ColListT& row) { loader.AddRow(row); });
+    });
+  }
+  // all columns have the width of the header or the widest row, whichever is greater
+  std::size_t numRows(0);
+  std::size_t numCells(tableM.headerM.size());
+  for (const PartS& part : parts)
+  {
+    numRows += part.numRowsM;
+    numCells += part.numCellsM;
+    if (part.columnsM.size() > tableM.headerM.size()) tableM.headerM.resize(part.columnsM.size());
+  }
+  if (numRows > std::numeric_limits<RowT>::max())
+  {
+    throw std::runtime_error("Too many rows for the column layout: " + std::to_string(numRows));
+  }
+  const std::size_t numCols(tableM.headerM.size());
+  columnsM.resize(numCols);
+  // join the parts' columns end to end, shifting their offsets past the bytes of the parts before them
+  const std::size_t joinThreads(ColumnThreads(tableM.threadsM, numCols, numRows, MIN_COLUMN_CELLS));
+  ParallelS::Run(joinThreads, [this, joinThreads, numCols, numRows, &parts](const std::size_t thread)
+  {
+    for (std::size_t col(thread); col < numCols; col += joinThreads)
+    {
+      ColumnS& column(columnsM[col]);
+      // a single part's column already is the whole column
+      if (parts.size() == 1 && col < parts.front().columnsM.size())
+      {
+        column = std::move(parts.front().columnsM[col]);
+        continue;
+      }
+      std::size_t numBytes(0);
+      for (const PartS& part : parts) numBytes += (col < part.columnsM.size() ? part.columnsM[col].bytesM.length() : 0);
+      column.bytesM.reserve(numBytes);
+      column.offsetsM.reserve(numRows + 1);
+      for (PartS& part : parts)
+      {
+        if (col >= part.columnsM.size())
+        {
+          // column not reached by any of the part's rows
+          column.offsetsM.resize(column.offsetsM.size() + part.numRowsM, column.bytesM.length());
+          continue;
+        }
+        ColumnS& partColumn(part.columnsM[col]);
+        const std::size_t base(column.bytesM.length());
+        column.bytesM.append(partColumn.bytesM);
+        for (std::size_t rowNum(1); rowNum <= part.numRowsM; ++rowNum)
+        {
+          column.offsetsM.push_back(base + partColumn.offsetsM[rowNum]);
+        }
+        partColumn = ColumnS();
+      }
+    }
+  });
+  orderM.resize(numRows);
+  for (std::size_t rowNum(0); rowNum < numRows; ++rowNum) orderM[rowNum] = static_cast<RowT>(rowNum);
+  // nothing but the header refers to the input any more, so give it storage of its own and let the input go
+  for (CellT& cell : tableM.headerM) cell = tableM.StoreCell({cell});
+  tableM.inputM.Close();
+  timer.Count(text.length(), numRows, numCells);
+}
+
+void ColTableS::PrintSnapshot() const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintSnapshot(out);
+  out.Flush();
+}
+
+void ColTableS::PrintSnapshot(OutputS& out) const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  const std::size_t numCols(columnsM.size());
+  const std::size_t numRows(NumRows());
+  // row 0 is the header; rows are all full width, as the columns are
+  SnapshotS::Write(numCols, numRows + 1, [numCols](const std::size_t) { return numCols; },
+                   [this](const std::size_t row, const std::size_t col)
+                   {
+                     return row ? Cell(row - 1, col) : tableM.headerM[col];
+                   },
+                   out);
+  timer.Count(out.BytesWritten() - startBytes, numRows, (numRows + 1) * numCols);
+}
+
+void ColTableS::PrintTSV() const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintTSV(out);
+  out.Flush();
+}
+
+void ColTableS::PrintTSV(OutputS& out) const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  const std::size_t numCols(columnsM.size());
+  // now print the header row (if non-empty)
+  if (numCols)
+  {
+    for (std::size_t col(0); col < numCols; ++col)
+    {
+      if (col) out << '\t';
+      out << tableM.headerM[col];
+    }
+    out << '\n';
+  }
+  // now print the data rows, gathering each one's cells from the columns
+  const std::size_t numRows(NumRows());
+  for (std::size_t rowNum(0); rowNum < numRows; ++rowNum)
+  {
+    const std::size_t row(orderM[rowNum]);
+    for (std::size_t col(0); col < numCols; ++col)
+    {
+      if (col) out << '\t';
+      out << columnsM[col].Value(row);
+    }
+    out << '\n';
+  }
+  timer.Count(out.BytesWritten() - startBytes, numRows, (numRows + 1) * numCols);
+}
+
+void ColTableS::PrintWiki() const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintWiki(out);
+  out.Flush();
+}
+
+void ColTableS::PrintWiki(OutputS& out) const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  const std::size_t numCols(columnsM.size());
+  const std::size_t numRows(NumRows());
+  TableS::PrintWikiStart(tableM.headerM, numCols, out);
+  // gather each row into a scratch row for printing
+  TableS::ColListT cells(numCols);
+  for (std::size_t rowNum(0); rowNum < numRows; ++rowNum)
+  {
+    const std::size_t row(orderM[rowNum]);
+    for (std::size_t col(0); col < numCols; ++col) cells[col] = columnsM[col].Value(row);
+    TableS::PrintWikiRow(cells, numCols, out);
+  }
+  TableS::PrintWikiEnd(out);
+  timer.Count(out.BytesWritten() - startBytes, numRows, (numRows + 1) * numCols);
+}
+
+void ColTableS::WikiTitleClean()
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_CLEAN);
+  const std::size_t numRows(NumRows());
+  const std::size_t numCols(columnsM.size());
+  if (!numCols)
+  {
+    timer.Count(0, numRows, 0);
+    return;
+  }
+  // rows (in load order) whose value in each non-title column is cleaned as a title: a row with an empty title has
+  //  its first non-empty cell cleaned as the title instead, as in TableS::WikiTitleClean()
+  // (a title cleans to empty exactly when it strips to empty, as CleanCheckCell() strips it to)
+  std::vector<std::vector<RowT>> titleRows(numCols);
+  const ColumnS& titles(columnsM.front());
+  for (std::size_t row(0); row < numRows; ++row)
+  {
+    CellT title(titles.Value(row));
+    TableS::CleanCheckCell(title);
+    if (!title.empty()) continue;
+    for (std::size_t col(1); col < numCols; ++col)
+    {
+      CellT value(columnsM[col].Value(row));
+      TableS::CleanCheckCell(value);
+      if (value.empty()) continue;
+      titleRows[col].push_back(static_cast<RowT>(row));
+      break;
+    }
+  }
+  // clean each column in one pass over its bytes; the title column and the rest are independent now, so each thread
+  //  takes every threads'th column
+  std::vector<std::size_t> changed(numCols, 0);
+  const std::size_t threads(ColumnThreads(tableM.threadsM, numCols, numRows, MIN_COLUMN_CELLS));
+  ParallelS::Run(threads, [this, threads, numCols, numRows, &titleRows, &changed](const std::size_t part)
+  {
+    for (std::size_t col(part); col < numCols; col += threads)
+    {
+      ColumnS& column(columnsM[col]);
+      const std::vector<RowT>& colTitleRows(titleRows[col]);
+      std::vector<RowT>::const_iterator titleRow(colTitleRows.begin());
+      const std::size_t numTitles(col ? colTitleRows.size() : numRows);
+      // cleaned values are written back in place, each moved down over any bytes freed before it; a value cleaned as
+      //  a checkbox is never longer than it was, but a title may grow past its own end, in which case the rest of
+      //  the column is written to a new buffer, with room for the rest of the titles to grow
+      std::string rewritten;
+      const char* const in(column.bytesM.data());
+      char* out(column.bytesM.data());
+      // holds rewritten titles until they're copied into the column
+      TableS titleStore;
+      std::size_t readStart(0);
+      std::size_t writeEnd(0);
+      for (std::size_t row(0); row < numRows; ++row)
+      {
+        const std::size_t readEnd(column.offsetsM[row + 1]);
+        CellT value(in + readStart, readEnd - readStart);
+        bool rewrote(false);
+        if (!col)
+        {
+          rewrote = titleStore.CleanTitleCell(value);
+        }
+        else if (titleRow != colTitleRows.end() && *titleRow == row)
+        {
+          rewrote = titleStore.CleanTitleCell(value);
+          ++titleRow;
+        }
+        else
+        {
+          rewrote = TableS::CleanCheckCell(value);
+        }
+        if (rewrote) ++changed[col];
+        if (out == in && writeEnd + value.length() > readEnd)
+        {
+          rewritten.resize(column.bytesM.length() + numTitles * MAX_TITLE_GROWTH);
+          std::memcpy(rewritten.data(), in, writeEnd);
+          out = rewritten.data();
+        }
+        if (value.data() != out + writeEnd) std::memmove(out + writeEnd, value.data(), value.length());
+        writeEnd += value.length();
+        column.offsetsM[row + 1] = writeEnd;
+        readStart = readEnd;
+      }
+      if (out != in) column.bytesM.swap(rewritten);
+      column.bytesM.resize(writeEnd);
+    }
+  });
+  std::size_t numChanged(0);
+  for (const std::size_t colChanged : changed) numChanged += colChanged;
+  timer.Count(0, numRows, numChanged);
+}
+
+void ColTableS::WikiTitleSort()
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_SORT);
+  // clean titles so that we can make assumptions
+  WikiTitleClean();
+  const std::size_t numRows(NumRows());
+  if (columnsM.empty())
+  {
+    timer.Count(0, numRows, 0);
+    return;
+  }
+  // derive the sort key of each row's title, once, reading only the title column
+  // each thread writes the keys for a range of rows into its own arena, reserved up front so that it never
+  //  reallocates and key views stay valid
+  const ColumnS& titles(columnsM.front());
+  std::vector<SortEntryS> entries(numRows);
+  const std::size_t threads(ParallelS::NumThreads(tableM.threadsM, numRows, MIN_SORT_ROWS));
+  std::vector<std::string> keyArenas(threads);
+  ParallelS::Run(threads, [this, threads, numRows, &titles, &entries, &keyArenas](const std::size_t part)
+  {
+    const std::size_t rowStart(numRows * part / threads);
+    const std::size_t rowEnd(numRows * (part + 1) / threads);
+    std::string& keyArena(keyArenas[part]);
+    std::size_t arenaSize(0);
+    for (std::size_t rowNum(rowStart); rowNum < rowEnd; ++rowNum)
+    {
+      arenaSize += TitleKeyS::MaxLength(titles.Value(orderM[rowNum]).length());
+    }
+    keyArena.reserve(arenaSize);
+    for (std::size_t rowNum(rowStart); rowNum < rowEnd; ++rowNum)
+    {
+      const std::size_t keyStart(keyArena.length());
+      TitleKeyS::Append(titles.Value(orderM[rowNum]), keyArena, tableM.foldM);
+      entries[rowNum].keyM = CellT(keyArena.data() + keyStart, keyArena.length() - keyStart);
+      entries[rowNum].rowM = orderM[rowNum];
+    }
+  });
+  // stable sort, so that rows with duplicate keys keep their relative order; only row numbers move
+  ParallelS::StableSort(entries, threads);
+  for (std::size_t rowNum(0); rowNum < numRows; ++rowNum) orderM[rowNum] = entries[rowNum].rowM;
+  timer.Count(0, numRows, 0);
+}
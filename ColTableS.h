@@ -0,0 +1,87 @@
+#ifndef COLTABLES_H
+#define COLTABLES_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "TableS.h"
+
+struct OutputS;
+
+// column-major table, as an alternative layout for tables that are only loaded, cleaned, sorted and printed
+// each column keeps its values back to back in a byte buffer of its own, with an offset per row marking where each
+//  one starts, so that a pass over one column (such as deriving sort keys from the titles, or cleaning a checkbox
+//  column) reads only that column's bytes, in order, rather than every row's cell list
+// rows are never moved: the table's row order is a list of 32-bit row numbers into the columns, so sorting shuffles
+//  one index per row, and printing gathers each row's cells through it
+// columns own their values, so the input file is released once it's loaded
+// output is identical to that of the same operations on a TableS
+struct ColTableS
+{
+  typedef TableS::CellT CellT;
+  typedef std::uint32_t RowT;
+
+  // one column
+  struct ColumnS
+  {
+    // values of all rows, back to back in the order they were loaded
+    std::string              bytesM;
+    // where each row's value starts in bytesM, plus a final entry for where the last one ends
+    std::vector<std::size_t> offsetsM;
+
+    ColumnS() : offsetsM(1, 0) {}
+
+    // value of row loaded as number row
+    CellT Value(const std::size_t row) const
+    {
+      return CellT(bytesM.data() + offsetsM[row], offsetsM[row + 1] - offsetsM[row]);
+    }
+
+    // add a row's value
+    void Append(const CellT value)
+    {
+      bytesM.append(value);
+      offsetsM.push_back(bytesM.length());
+    }
+  };
+
+  // holds the header and provides threadsM and statsM; has no data rows
+  TableS tableM;
+  // columns, as many as the header has
+  std::vector<ColumnS> columnsM;
+  // row order of the table, as row numbers into the columns
+  std::vector<RowT>    orderM;
+
+  // construct an empty table
+  ColTableS();
+
+  ColTableS(ColTableS&&) = default;
+  ColTableS& operator=(ColTableS&&) = default;
+  ColTableS(const ColTableS&) = delete;
+  ColTableS& operator=(const ColTableS&) = delete;
+
+  std::size_t NumRows() const { return orderM.size(); }
+
+  CellT Cell(const std::size_t row, const std::size_t col) const { return columnsM[col].Value(orderM[row]); }
+
+  // as the TableS methods of the same names
+  // LoadTSV() appends rows to columns as they're tokenized, without storing them as rows first; large files are
+  //  split into chunks that are loaded into columns of their own in parallel, and then joined, one column per thread
+  // a table snapshot is loaded from its rows as they are, split into ranges of rows rather than chunks of text
+  // throws std::runtime_error if the file cannot be opened, is an invalid snapshot, or has more rows than a row
+  //  number can hold
+  // WikiTitleClean() rewrites each column in a single pass over its bytes, with columns cleaned in parallel
+  // WikiTitleSort() stable-sorts row numbers by the keys of their titles, leaving the columns as they are
+  void LoadTSV(const std::string& filename);
+  void PrintSnapshot() const;
+  void PrintSnapshot(OutputS& out) const;
+  void PrintTSV() const;
+  void PrintTSV(OutputS& out) const;
+  void PrintWiki() const;
+  void PrintWiki(OutputS& out) const;
+  void WikiTitleClean();
+  void WikiTitleSort();
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "DelimScanS.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DELIMSCANS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(DELIMSCANS_X86) && (defined(__GNUC__) || defined(__clang__))
+// compile the AVX2 path for AVX2 only, so the rest of the program keeps the baseline instruction set
+#define DELIMSCANS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define DELIMSCANS_TARGET_AVX2
+#endif
+
+namespace
+{
+  void ScanScalar(const char* p, std::size_t blocks, DelimScanS::MasksS* masks)
+  {
+    for (; blocks; --blocks, p += 64, ++masks)
+    {
+      std::uint64_t tabs(0);
+      std::uint64_t newlines(0);
+      std::uint64_t crs(0);
+      for (unsigned i(0); i < 64; ++i)
+      {
+        const std::uint64_t bit(std::uint64_t(1) << i);
+        switch (p[i])
+        {
+          case '\t': tabs     |= bit; break;
+          case '\n': newlines |= bit; break;
+          case '\r': crs      |= bit; break;
+        }
+      }
+      masks->tabM = tabs;
+      masks->newlineM = newlines;
+      masks->crM = crs;
+    }
+  }
+
+#ifdef DELIMSCANS_X86
+  void ScanSSE2(const char* p, std::size_t blocks, DelimScanS::MasksS* masks)
+  {
+    const __m128i tab(_mm_set1_epi8('\t'));
+    const __m128i newline(_mm_set1_epi8('\n'));
+    const __m128i cr(_mm_set1_epi8('\r'));
+    for (; blocks; --blocks, p += 64, ++masks)
+    {
+      std::uint64_t tabs(0);
+      std::uint64_t newlines(0);
+      std::uint64_t crs(0);
+      for (unsigned i(0); i < 4; ++i)
+      {
+        const __m128i v(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i)));
+        const unsigned shift(16 * i);
+        tabs     |= std::uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, tab))))     << shift;
+        newlines |= std::uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)))) << shift;
+        crs      |= std::uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, cr))))      << shift;
+      }
+      masks->tabM = tabs;
+      masks->newlineM = newlines;
+      masks->crM = crs;
+    }
+  }
+
+  DELIMSCANS_TARGET_AVX2
+  void ScanAVX2(const char* p, std::size_t blocks, DelimScanS::MasksS* masks)
+  {
+    const __m256i tab(_mm256_set1_epi8('\t'));
+    const __m256i newline(_mm256_set1_epi8('\n'));
+    const __m256i cr(_mm256_set1_epi8('\r'));
+    for (; blocks; --blocks, p += 64, ++masks)
+    {
+      const __m256i lo(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+      const __m256i hi(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32)));
+      masks->tabM =
+        std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, tab)))) |
+        std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, tab)))) << 32;
+      masks->newlineM =
+        std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, newline)))) |
+        std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, newline)))) << 32;
+      masks->crM =
+        std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, cr)))) |
+        std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, cr)))) << 32;
+    }
+  }
+
+  bool HaveAVX2()
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    // check CPUID leaf 7 AVX2 bit, and that the OS saves YMM state
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    const bool osxsave((info[2] & (1 << 27)) != 0);
+    if (!osxsave || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+  }
+#endif
+}
+
+DelimScanS::ImplE DelimScanS::Best()
+{
+#ifdef DELIMSCANS_X86
+  static const ImplE best(HaveAVX2() ? IMPL_AVX2 : IMPL_SSE2);
+  return best;
+#else
+  return IMPL_SCALAR;
+#endif
+}
+
+DelimScanS::ScanFuncT DelimScanS::Get(const ImplE impl)
+{
+  switch (impl)
+  {
+    case IMPL_SCALAR: return ScanScalar;
+#ifdef DELIMSCANS_X86
+    // SSE2 is part of the x86-64 baseline
+    case IMPL_SSE2: return ScanSSE2;
+    case IMPL_AVX2: return Best() == IMPL_AVX2 ? ScanAVX2 : nullptr;
+#else
+    default: break;
+#endif
+  }
+  return nullptr;
+}
+
+const char* DelimScanS::Name(const ImplE impl)
+{
+  switch (impl)
+  {
+    case IMPL_SCALAR: return "scalar";
+    case IMPL_SSE2:   return "sse2";
+    case IMPL_AVX2:   return "avx2";
+  }
+  return "unknown";
+}
@@ -0,0 +1,134 @@
+#ifndef DELIMSCANS_H
+#define DELIMSCANS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// vectorized scanner for TSV structural characters
+// classifies a buffer in 64-byte blocks, producing one bitmask per character class per block (bit N set means byte N
+//  of the block is that character), so that tokenizers can walk delimiter positions with bit operations instead of
+//  testing every byte
+// SSE2 and AVX2 implementations are used on x86 CPUs that support them, with a portable scalar fallback; the best
+//  one is picked at runtime
+struct DelimScanS
+{
+  // bitmasks for one 64-byte block
+  struct MasksS
+  {
+    std::uint64_t tabM;
+    std::uint64_t newlineM;
+    std::uint64_t crM;
+  };
+
+  // fill masks[i] for each of the 'blocks' 64-byte blocks starting at p
+  typedef void (*ScanFuncT)(const char* p, std::size_t blocks, MasksS* masks);
+
+  enum ImplE
+  {
+    IMPL_SCALAR,
+    IMPL_SSE2,
+    IMPL_AVX2
+  };
+
+  // fastest implementation supported by the running CPU (detected once)
+  static ImplE Best();
+
+  // scan function for the given implementation, or nullptr if it isn't available on this build/CPU
+  static ScanFuncT Get(ImplE impl);
+
+  // scan function for Best()
+  static ScanFuncT Get() { return Get(Best()); }
+
+  // printable implementation name
+  static const char* Name(ImplE impl);
+
+  // number of 64-byte blocks classified per scan function call by ForEachDelim()
+  static constexpr std::size_t BATCH_BLOCKS = 64;
+
+  // walk the tabs and line ends of text in order, calling tabFunc(pos) for each tab and lineEndFunc(pos, cr) for
+  //  each newline, and for the end of text if it doesn't end with one; pos is the offset of the delimiter (or the
+  //  text's length), and cr is true if the byte before it is a CR
+  // text is classified with the scan function for Best() in batches of blocks, and a final partial block from a
+  //  zero-padded copy, so each byte is classified once; delimiters are then found with bit operations
+  template <typename TabFuncT, typename LineEndFuncT>
+  static void ForEachDelim(std::string_view text, TabFuncT&& tabFunc, LineEndFuncT&& lineEndFunc);
+
+  // index of lowest set bit in a non-zero mask
+  static unsigned LowestBit(const std::uint64_t mask)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long bit;
+    _BitScanForward64(&bit, mask);
+    return static_cast<unsigned>(bit);
+#else
+    unsigned bit(0);
+    while (!((mask >> bit) & 1)) ++bit;
+    return bit;
+#endif
+  }
+};
+
+template <typename TabFuncT, typename LineEndFuncT>
+void DelimScanS::ForEachDelim(const std::string_view text, TabFuncT&& tabFunc, LineEndFuncT&& lineEndFunc)
+{
+  static const ScanFuncT scan(Get());
+  const char* const base(text.data());
+  const std::size_t length(text.length());
+  MasksS masks[BATCH_BLOCKS];
+  std::size_t lineStart(0);
+  // whether the last byte of the previous block was a CR
+  bool prevCr(false);
+  std::size_t batchStart(0);
+  while (batchStart < length)
+  {
+    std::size_t blocks(std::min((length - batchStart) / 64, BATCH_BLOCKS));
+    if (blocks)
+    {
+      scan(base + batchStart, blocks, masks);
+    }
+    else
+    {
+      // final partial block; scan a zero-padded copy
+      char tail[64] = {};
+      std::memcpy(tail, base + batchStart, length - batchStart);
+      scan(tail, 1, masks);
+      blocks = 1;
+    }
+    for (std::size_t blockNum(0); blockNum < blocks; ++blockNum)
+    {
+      const MasksS& m(masks[blockNum]);
+      const std::size_t blockStart(batchStart + 64 * blockNum);
+      std::uint64_t delims(m.tabM | m.newlineM);
+      while (delims)
+      {
+        const unsigned bit(LowestBit(delims));
+        delims &= delims - 1;
+        const std::size_t pos(blockStart + bit);
+        if ((m.newlineM >> bit) & 1)
+        {
+          lineEndFunc(pos, bit ? ((m.crM >> (bit - 1)) & 1) != 0 : prevCr);
+          lineStart = pos + 1;
+        }
+        else
+        {
+          tabFunc(pos);
+        }
+      }
+      prevCr = (m.crM >> 63) != 0;
+    }
+    batchStart += 64 * blocks;
+  }
+  // last line may not be newline-terminated
+  if (lineStart < length) lineEndFunc(length, base[length - 1] == '\r');
+}
+
+#endif
@@ -0,0 +1,541 @@
+#include "DictTableS.h"
+
+#include "MappedFileS.h"
+#include "OutputS.h"
+#include "ParallelS.h"
+#include "SnapshotS.h"
+#include "StatsS.h"
+#include "TitleKeyS.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+  // minimum input bytes per LoadTSV() worker thread
+  const std::size_t MIN_LOAD_CHUNK(1 << 20);
+  // minimum cells per dictionary merging worker thread
+  const std::size_t MIN_MERGE_CELLS(1 << 18);
+  // minimum distinct titles per sort worker thread
+  const std::size_t MIN_SORT_VALUES(1 << 15);
+  // minimum cells per reordering worker thread
+  const std::size_t MIN_REORDER_CELLS(1 << 18);
+  // a column is kept plain once it has more distinct values than half its rows so far, plus this many
+  const std::size_t MIN_DICT_VALUES(256);
+
+  // code of an empty map slot
+  const DictTableS::CodeT NO_CODE(static_cast<DictTableS::CodeT>(-1));
+
+  // sort key of a distinct title value, and the value's index
+  struct KeyEntryS
+  {
+    DictTableS::CellT keyM;
+    std::size_t       indexM;
+
+    bool operator<(const KeyEntryS& other) const { return keyM < other.keyM; }
+  };
+
+  // open-addressing hash map from the distinct values of a column to their codes, for encoding
+  // slots hold part of each value's hash alongside its code, so that most mismatches are rejected without comparing
+  //  values; there are always at least twice as many slots as values
+  struct CodeMapS
+  {
+    struct SlotS
+    {
+      std::uint32_t     hashM;
+      DictTableS::CodeT codeM;
+    };
+
+    std::vector<SlotS> slotsM;
+    std::size_t        sizeM;
+
+    CodeMapS() : slotsM(16, SlotS{0, NO_CODE}), sizeM(0) {}
+
+    // code of cell, which is appended to values (taking the next code) if not already there
+    DictTableS::CodeT Find(const DictTableS::CellT cell, std::vector<DictTableS::CellT>& values)
+    {
+      const std::uint32_t hash(static_cast<std::uint32_t>(std::hash<DictTableS::CellT>()(cell)));
+      const std::size_t mask(slotsM.size() - 1);
+      for (std::size_t slotNum(hash & mask);; slotNum = (slotNum + 1) & mask)
+      {
+        SlotS& slot(slotsM[slotNum]);
+        if (slot.codeM == NO_CODE)
+        {
+          const DictTableS::CodeT code(static_cast<DictTableS::CodeT>(values.size()));
+          slot = SlotS{hash, code};
+          values.push_back(cell);
+          if (++sizeM * 2 > slotsM.size()) Grow();
+          return code;
+        }
+        if (slot.hashM == hash && values[slot.codeM] == cell) return slot.codeM;
+      }
+    }
+
+    // double the slot count
+    void Grow()
+    {
+      std::vector<SlotS> old(slotsM.size() * 2, SlotS{0, NO_CODE});
+      old.swap(slotsM);
+      const std::size_t mask(slotsM.size() - 1);
+      for (const SlotS& slot : old)
+      {
+        if (slot.codeM == NO_CODE) continue;
+        std::size_t slotNum(slot.hashM & mask);
+        while (slotsM[slotNum].codeM != NO_CODE) slotNum = (slotNum + 1) & mask;
+        slotsM[slotNum] = slot;
+      }
+    }
+
+    // release all slots; the map can't be used afterwards
+    void Release()
+    {
+      std::vector<SlotS>().swap(slotsM);
+    }
+  };
+
+  // switch column to plain storage
+  void MakePlain(DictTableS::ColumnS& column)
+  {
+    std::vector<DictTableS::CellT> values;
+    values.reserve(column.codesM.capacity());
+    for (const DictTableS::CodeT code : column.codesM) values.push_back(column.valuesM[code]);
+    column.valuesM.swap(values);
+    std::vector<DictTableS::CodeT>().swap(column.codesM);
+    column.plainM = true;
+  }
+
+  // encoder of a contiguous range of rows into columns of its own, which are later merged into the table's
+  struct PartS
+  {
+    std::vector<DictTableS::ColumnS> columnsM;
+    // value lookup of each column (unused once the column is plain)
+    std::vector<CodeMapS>            codeMapsM;
+    std::size_t                      numRowsM;
+    std::size_t                      numCellsM;
+
+    PartS() : numRowsM(0), numCellsM(0) {}
+
+    void AddRow(const TableS::ColListT& row)
+    {
+      // a column first seen in this row reads as empty in earlier ones
+      while (columnsM.size() < row.size())
+      {
+        columnsM.emplace_back();
+        codeMapsM.emplace_back();
+        DictTableS::ColumnS& column(columnsM.back());
+        if (numRowsM) column.codesM.assign(numRowsM, codeMapsM.back().Find(DictTableS::CellT(), column.valuesM));
+      }
+      // likewise, columns this row doesn't reach are padded with empty values
+      for (std::size_t col(0); col < columnsM.size(); ++col)
+      {
+        DictTableS::ColumnS& column(columnsM[col]);
+        const DictTableS::CellT cell(col < row.size() ? row[col] : DictTableS::CellT());
+        if (column.plainM)
+        {
+          column.valuesM.push_back(cell);
+          continue;
+        }
+        column.codesM.push_back(codeMapsM[col].Find(cell, column.valuesM));
+        if (column.valuesM.size() > MIN_DICT_VALUES + numRowsM / 2)
+        {
+          MakePlain(column);
+          codeMapsM[col].Release();
+        }
+      }
+      ++numRowsM;
+      numCellsM += row.size();
+    }
+  };
+
+  // number of threads to split work over the given number of columns, at most one per column
+  std::size_t ColumnThreads(const unsigned requested, const std::size_t numCols, const std::size_t numRows,
+                            const std::size_t minCells)
+  {
+    return std::max<std::size_t>(1, std::min(numCols, ParallelS::NumThreads(requested, numCols * numRows, minCells)));
+  }
+}
+
+DictTableS::DictTableS()
+  : numRowsM(0)
+{
+}
+
+void DictTableS::LoadTSV(const std::string& filename)
+{
+  // open first, so that a failure leaves the current contents intact
+  MappedFileS inFile;
+  {
+    StatsS::TimerS timer(tableM.statsM, StatsS::PH_READ);
+    inFile.Open(filename);
+    timer.Count(inFile.View().length(), 0, 0);
+  }
+  tableM.Clear();
+  columnsM.clear();
+  numRowsM = 0;
+  tableM.inputM = std::move(inFile);
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_TOKENIZE);
+  const CellT text(tableM.inputM.View());
+  std::vector<PartS> parts;
+  if (SnapshotS::Detect(text))
+  {
+    // a snapshot's rows are already split, so parts are ranges of rows rather than of text
+    const SnapshotS snapshot(text);
+    for (std::size_t col(0); col < snapshot.NumCols(); ++col) tableM.headerM.push_back(snapshot.Cell(col));
+    const std::size_t numRows(snapshot.NumRows() - 1);
+    const std::size_t threads(ParallelS::NumThreads(tableM.threadsM, text.length(), MIN_LOAD_CHUNK));
+    parts.resize(threads);
+    ParallelS::Run(threads, [&snapshot, numRows, threads, &parts](const std::size_t part)
+    {
+      PartS& encoder(parts[part]);
+      TableS::ColListT row;
+      // (data row n is snapshot row n + 1)
+      for (std::size_t rowNum(numRows * part / threads + 1); rowNum <= numRows * (part + 1) / threads; ++rowNum)
+      {
+        row.clear();
+        for (std::size_t cell(snapshot.RowBegin(rowNum)); cell < snapshot.RowEnd(rowNum); ++cell)
+        {
+          row.push_back(snapshot.Cell(cell));
+        }
+        encoder.AddRow(row);
+      }
+      std::vector<CodeMapS>().swap(encoder.codeMapsM);
+    });
+  }
+  else
+  {
+    // header line first, so that parts only see data rows
+    std::size_t bodyStart(text.find('\n'));
+    bodyStart = (bodyStart == CellT::npos ? text.length() : bodyStart + 1);
+    TableS::ForEachTSVRow(text.substr(0, bodyStart), [this](const TableS::ColListT& row)
+    {
+      tableM.headerM.assign(row.begin(), row.end());
+    });
+    // split body into one chunk per thread, moving each boundary to just past the next newline, and encode each
+    const CellT body(text.substr(bodyStart));
+    const std::size_t threads(ParallelS::NumThreads(tableM.threadsM, body.length(), MIN_LOAD_CHUNK));
+    std::vector<std::size_t> bounds(threads + 1, body.length());
+    bounds[0] = 0;
+    for (std::size_t part(1); part < threads; ++part)
+    {
+      const std::size_t newline(body.find('\n', std::max(bounds[part - 1], body.length() * part / threads)));
+      bounds[part] = (newline == CellT::npos ? body.length() : newline + 1);
+    }
+    parts.resize(threads);
+    ParallelS::Run(threads, [&body, &bounds, &parts](const std::size_t part)
+    {
+      PartS& encoder(parts[part]);
+      TableS::ForEachTSVRow(body.substr(bounds[part], bounds[part + 1] - bounds[part]),
+                            [&encoder](const TableS::ColListT& row) { encoder.AddRow(row); });
+      std::vector<CodeMapS>().swap(encoder.codeMapsM);
+    });
+  }
+  // all columns have the width of the header or the widest row, whichever is greater
+  std::size_t numCells(tableM.headerM.size());
+  for (const PartS& part : parts)
+  {
+    numRowsM += part.numRowsM;
+    numCells += part.numCellsM;
+    if (part.columnsM.size() > tableM.headerM.size()) tableM.headerM.resize(part.columnsM.size());
+  }
+  const std::size_t numCols(tableM.headerM.size());
+  columnsM.resize(numCols);
+  // merge the parts' columns, remapping their codes to those of a dictionary for the whole column; a column that
+  //  any part has kept plain is plain throughout
+  const std::size_t mergeThreads(ColumnThreads(tableM.threadsM, numCols, numRowsM, MIN_MERGE_CELLS));
+  ParallelS::Run(mergeThreads, [this, mergeThreads, numCols, &parts](const std::size_t thread)
+  {
+    for (std::size_t col(thread); col < numCols; col += mergeThreads)
+    {
+      ColumnS& column(columnsM[col]);
+      // a single part's column already is the whole column
+      if (parts.size() == 1 && col < parts.front().columnsM.size())
+      {
+        column = std::move(parts.front().columnsM[col]);
+        continue;
+      }
+      for (const PartS& part : parts) column.plainM |= (col < part.columnsM.size() && part.columnsM[col].plainM);
+      CodeMapS codeMap;
+      std::vector<CodeT> remap;
+      if (column.plainM) column.valuesM.reserve(numRowsM);
+      else               column.codesM.reserve(numRowsM);
+      for (PartS& part : parts)
+      {
+        if (col >= part.columnsM.size())
+        {
+          // column not reached by any of the part's rows
+          if (column.plainM) column.valuesM.resize(column.valuesM.size() + part.numRowsM);
+          else column.codesM.resize(column.codesM.size() + part.numRowsM, codeMap.Find(CellT(), column.valuesM));
+          continue;
+        }
+        ColumnS& partColumn(part.columnsM[col]);
+        if (column.plainM)
+        {
+          for (std::size_t rowNum(0); rowNum < part.numRowsM; ++rowNum)
+          {
+            column.valuesM.push_back(partColumn.valuesM[partColumn.Index(rowNum)]);
+          }
+        }
+        else
+        {
+          remap.resize(partColumn.valuesM.size());
+          for (std::size_t code(0); code < remap.size(); ++code)
+          {
+            remap[code] = codeMap.Find(partColumn.valuesM[code], column.valuesM);
+          }
+          for (const CodeT code : partColumn.codesM) column.codesM.push_back(remap[code]);
+        }
+        partColumn = ColumnS();
+      }
+    }
+  });
+  timer.Count(text.length(), numRowsM, numCells);
+}
+
+void DictTableS::PrintSnapshot() const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintSnapshot(out);
+  out.Flush();
+}
+
+void DictTableS::PrintSnapshot(OutputS& out) const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  const std::size_t numCols(columnsM.size());
+  const std::size_t numRows(NumRows());
+  // row 0 is the header; rows are all full width, as the columns are
+  SnapshotS::Write(numCols, numRows + 1, [numCols](const std::size_t) { return numCols; },
+                   [this](const std::size_t row, const std::size_t col)
+                   {
+                     return row ? Cell(row - 1, col) : tableM.headerM[col];
+                   },
+                   out);
+  timer.Count(out.BytesWritten() - startBytes, numRows, (numRows + 1) * numCols);
+}
+
+void DictTableS::PrintTSV() const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintTSV(out);
+  out.Flush();
+}
+
+void DictTableS::PrintTSV(OutputS& out) const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  const std::size_t numCols(columnsM.size());
+  // now print the header row (if non-empty)
+  if (numCols)
+  {
+    for (std::size_t col(0); col < numCols; ++col)
+    {
+      if (col) out << '\t';
+      out << tableM.headerM[col];
+    }
+    out << '\n';
+  }
+  // now print the data rows
+  const std::size_t numRows(NumRows());
+  for (std::size_t rowNum(0); rowNum < numRows; ++rowNum)
+  {
+    for (std::size_t col(0); col < numCols; ++col)
+    {
+      if (col) out << '\t';
+      out << Cell(rowNum, col);
+    }
+    out << '\n';
+  }
+  timer.Count(out.BytesWritten() - startBytes, numRows, (numRows + 1) * numCols);
+}
+
+void DictTableS::PrintWiki() const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintWiki(out);
+  out.Flush();
+}
+
+void DictTableS::PrintWiki(OutputS& out) const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  const std::size_t numCols(columnsM.size());
+  const std::size_t numRows(NumRows());
+  TableS::PrintWikiStart(tableM.headerM, numCols, out);
+  // decode each row into a scratch row for printing
+  TableS::ColListT row(numCols);
+  for (std::size_t rowNum(0); rowNum < numRows; ++rowNum)
+  {
+    for (std::size_t col(0); col < numCols; ++col) row[col] = Cell(rowNum, col);
+    TableS::PrintWikiRow(row, numCols, out);
+  }
+  TableS::PrintWikiEnd(out);
+  timer.Count(out.BytesWritten() - startBytes, numRows, (numRows + 1) * numCols);
+}
+
+void DictTableS::WikiTitleClean()
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_CLEAN);
+  const std::size_t numRows(NumRows());
+  if (columnsM.empty())
+  {
+    timer.Count(0, numRows, 0);
+    return;
+  }
+  // number of distinct values (plus cells of untitled rows, see below) rewritten, for stats
+  std::size_t changed(0);
+  // clean each distinct title once
+  ColumnS& titles(columnsM.front());
+  bool anyUntitled(false);
+  for (CellT& value : titles.valuesM)
+  {
+    if (tableM.CleanTitleCell(value)) ++changed;
+    if (value.empty()) anyUntitled = true;
+  }
+  // a row with an empty title has its first non-empty cell cleaned as the title instead; unless the column is plain,
+  //  that cell gets a value of its own, added the first time it's needed, since other rows may share the original
+  // this is done before the non-title columns are cleaned below, which leaves title-cleaned values as they are
+  if (anyUntitled)
+  {
+    std::vector<std::unordered_map<CodeT, CodeT>> titleCodes(columnsM.size());
+    for (std::size_t rowNum(0); rowNum < numRows; ++rowNum)
+    {
+      if (!titles.valuesM[titles.Index(rowNum)].empty()) continue;
+      for (std::size_t col(1); col < columnsM.size(); ++col)
+      {
+        ColumnS& column(columnsM[col]);
+        CellT value(column.valuesM[column.Index(rowNum)]);
+        const bool rewritten(tableM.CleanTitleCell(value));
+        if (value.empty()) continue;
+        if (rewritten)
+        {
+          ++changed;
+          if (column.plainM)
+          {
+            column.valuesM[rowNum] = value;
+            break;
+          }
+          CodeT& code(column.codesM[rowNum]);
+          const auto inserted(titleCodes[col].emplace(code, static_cast<CodeT>(column.valuesM.size())));
+          if (inserted.second) column.valuesM.push_back(value);
+          code = inserted.first->second;
+        }
+        break;
+      }
+    }
+  }
+  // clean each distinct non-title value once; plain columns are cleaned together, row by row, as their values are
+  //  scattered over the input in that order
+  std::vector<ColumnS*> plainColumns;
+  for (std::size_t col(1); col < columnsM.size(); ++col)
+  {
+    ColumnS& column(columnsM[col]);
+    if (column.plainM)
+    {
+      plainColumns.push_back(&column);
+      continue;
+    }
+    for (CellT& value : column.valuesM)
+    {
+      if (TableS::CleanCheckCell(value)) ++changed;
+    }
+  }
+  for (std::size_t rowNum(0); !plainColumns.empty() && rowNum < numRows; ++rowNum)
+  {
+    for (ColumnS* const column : plainColumns)
+    {
+      if (TableS::CleanCheckCell(column->valuesM[rowNum])) ++changed;
+    }
+  }
+  timer.Count(0, numRows, changed);
+}
+
+void DictTableS::WikiTitleSort()
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_SORT);
+  // clean titles so that we can make assumptions
+  WikiTitleClean();
+  const std::size_t numRows(NumRows());
+  if (columnsM.empty())
+  {
+    timer.Count(0, numRows, 0);
+    return;
+  }
+  // derive sort key of each distinct title (or each row's, if plain), once
+  // each thread writes the keys for a range of values into its own arena, reserved up front so that it never
+  //  reallocates and key views stay valid
+  const ColumnS& titles(columnsM.front());
+  const std::size_t numValues(titles.valuesM.size());
+  std::vector<KeyEntryS> entries(numValues);
+  const std::size_t keyThreads(ParallelS::NumThreads(tableM.threadsM, numValues, MIN_SORT_VALUES));
+  std::vector<std::string> keyArenas(keyThreads);
+  ParallelS::Run(keyThreads, [this, keyThreads, numValues, &titles, &entries, &keyArenas](const std::size_t part)
+  {
+    const std::size_t valueStart(numValues * part / keyThreads);
+    const std::size_t valueEnd(numValues * (part + 1) / keyThreads);
+    std::string& keyArena(keyArenas[part]);
+    std::size_t arenaSize(0);
+    for (std::size_t valueNum(valueStart); valueNum < valueEnd; ++valueNum)
+    {
+      arenaSize += TitleKeyS::MaxLength(titles.valuesM[valueNum].length());
+    }
+    keyArena.reserve(arenaSize);
+    for (std::size_t valueNum(valueStart); valueNum < valueEnd; ++valueNum)
+    {
+      const std::size_t keyStart(keyArena.length());
+      TitleKeyS::Append(titles.valuesM[valueNum], keyArena, tableM.foldM);
+      entries[valueNum].keyM = CellT(keyArena.data() + keyStart, keyArena.length() - keyStart);
+      entries[valueNum].indexM = valueNum;
+    }
+  });
+  ParallelS::StableSort(entries, keyThreads);
+  // rank each title by key, with equal keys sharing a rank
+  std::vector<std::size_t> ranks(numValues);
+  std::size_t numRanks(0);
+  for (std::size_t entryNum(0); entryNum < numValues; ++entryNum)
+  {
+    if (entryNum && entries[entryNum].keyM != entries[entryNum - 1].keyM) ++numRanks;
+    ranks[entries[entryNum].indexM] = numRanks;
+  }
+  if (numValues) ++numRanks;
+  std::vector<KeyEntryS>().swap(entries);
+  std::vector<std::string>().swap(keyArenas);
+  // counting sort of rows by title rank, so that rows with equal keys keep their relative order
+  std::vector<std::size_t> rankStarts(numRanks + 1, 0);
+  for (std::size_t rowNum(0); rowNum < numRows; ++rowNum) ++rankStarts[ranks[titles.Index(rowNum)] + 1];
+  for (std::size_t rank(0); rank < numRanks; ++rank) rankStarts[rank + 1] += rankStarts[rank];
+  std::vector<std::size_t> order(numRows);
+  for (std::size_t rowNum(0); rowNum < numRows; ++rowNum) order[rankStarts[ranks[titles.Index(rowNum)]]++] = rowNum;
+  // put every column into sorted order, with each thread taking every threads'th column
+  const std::size_t numCols(columnsM.size());
+  const std::size_t threads(ColumnThreads(tableM.threadsM, numCols, numRows, MIN_REORDER_CELLS));
+  ParallelS::Run(threads, [this, threads, numCols, numRows, &order](const std::size_t part)
+  {
+    std::vector<CodeT> sortedCodes;
+    std::vector<CellT> sortedValues;
+    for (std::size_t col(part); col < numCols; col += threads)
+    {
+      ColumnS& column(columnsM[col]);
+      if (column.plainM)
+      {
+        sortedValues.resize(numRows);
+        for (std::size_t rowNum(0); rowNum < numRows; ++rowNum) sortedValues[rowNum] = column.valuesM[order[rowNum]];
+        column.valuesM.swap(sortedValues);
+        continue;
+      }
+      sortedCodes.resize(numRows);
+      for (std::size_t rowNum(0); rowNum < numRows; ++rowNum) sortedCodes[rowNum] = column.codesM[order[rowNum]];
+      column.codesM.swap(sortedCodes);
+    }
+  });
+  timer.Count(0, numRows, 0);
+}
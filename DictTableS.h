@@ -0,0 +1,76 @@
+#ifndef DICTTABLES_H
+#define DICTTABLES_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "TableS.h"
+
+struct OutputS;
+
+// dictionary-encoded table, as an alternative layout for tables that are only loaded, cleaned, sorted and printed
+// each column keeps a list of its distinct values plus a 32-bit code per row, so that a cell costs 4 bytes rather
+//  than a 16-byte view (and its share of a row vector), and the per-value work of WikiTitleClean() and
+//  WikiTitleSort() is done once per distinct value rather than once per cell
+// this suits the usual wide table of a title column plus many low-cardinality checkbox columns; a column that turns
+//  out to have new values in more than about half of its rows is instead kept plain, as one value per row
+// output is identical to that of the same operations on a TableS
+struct DictTableS
+{
+  typedef TableS::CellT CellT;
+  typedef std::uint32_t CodeT;
+
+  // one encoded column
+  struct ColumnS
+  {
+    // distinct values indexed by code, or if plain, each row's value
+    std::vector<CellT> valuesM;
+    // value code of each row; empty if plain
+    std::vector<CodeT> codesM;
+    bool               plainM;
+
+    ColumnS() : plainM(false) {}
+
+    // index of a row's value in valuesM
+    std::size_t Index(const std::size_t row) const { return plainM ? row : codesM[row]; }
+  };
+
+  // holds the header and the storage that all values refer to, and provides threadsM and statsM; has no data rows
+  TableS tableM;
+  // encoded columns, as many as the header has
+  std::vector<ColumnS> columnsM;
+  std::size_t          numRowsM;
+
+  // construct an empty table
+  DictTableS();
+
+  DictTableS(DictTableS&&) = default;
+  DictTableS& operator=(DictTableS&&) = default;
+  DictTableS(const DictTableS&) = delete;
+  DictTableS& operator=(const DictTableS&) = delete;
+
+  std::size_t NumRows() const { return numRowsM; }
+
+  CellT Cell(const std::size_t row, const std::size_t col) const
+  {
+    const ColumnS& column(columnsM[col]);
+    return column.valuesM[column.Index(row)];
+  }
+
+  // as the TableS methods of the same names
+  // LoadTSV() encodes rows as they're tokenized, without storing them as rows first; large files are split into
+  //  chunks that are encoded in parallel, and the chunks' dictionaries then merged, one column per thread
+  // a table snapshot is encoded from its rows as they are, split into ranges of rows rather than chunks of text
+  void LoadTSV(const std::string& filename);
+  void PrintSnapshot() const;
+  void PrintSnapshot(OutputS& out) const;
+  void PrintTSV() const;
+  void PrintTSV(OutputS& out) const;
+  void PrintWiki() const;
+  void PrintWiki(OutputS& out) const;
+  void WikiTitleClean();
+  void WikiTitleSort();
+};
+
+#endif
@@ -0,0 +1,312 @@
+#include "DumpReaderS.h"
+
+#include "BlockReaderS.h"
+#include "ChannelS.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+  // blocks of input being read, scanned or (briefly) carried over into the next one
+  const std::size_t READ_BLOCKS(3);
+  // tables that may be waiting to be processed before the reader thread waits
+  const std::size_t CHANNEL_TABLES(64);
+  // longest entity decoded, including "&" and ";" (e.g. "&#x10FFFF;")
+  const std::size_t MAX_ENTITY(12);
+
+  // thrown through the reader thread's scan when the consumer has stopped taking tables
+  struct StoppedS {};
+
+  // append the UTF-8 encoding of code point c to out
+  void AppendUtf8(const unsigned long c, std::string& out)
+  {
+    if (c < 0x80)
+    {
+      out += static_cast<char>(c);
+    }
+    else if (c < 0x800)
+    {
+      out += static_cast<char>(0xc0 | (c >> 6));
+      out += static_cast<char>(0x80 | (c & 0x3f));
+    }
+    else if (c < 0x10000)
+    {
+      out += static_cast<char>(0xe0 | (c >> 12));
+      out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (c & 0x3f));
+    }
+    else
+    {
+      out += static_cast<char>(0xf0 | (c >> 18));
+      out += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+      out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (c & 0x3f));
+    }
+  }
+
+  // decode the entity with the given name (the part between "&" and ";") into out
+  // returns false if it isn't one of XML's predefined entities or a valid character reference
+  bool DecodeEntity(const DumpReaderS::CellT name, std::string& out)
+  {
+    if (name == "lt")   { out = "<";  return true; }
+    if (name == "gt")   { out = ">";  return true; }
+    if (name == "amp")  { out = "&";  return true; }
+    if (name == "quot") { out = "\""; return true; }
+    if (name == "apos") { out = "'";  return true; }
+    if (name.length() < 2 || name[0] != '#') return false;
+    const bool hex(name[1] == 'x' || name[1] == 'X');
+    const DumpReaderS::CellT digits(name.substr(hex ? 2 : 1));
+    if (digits.empty()) return false;
+    unsigned long c(0);
+    for (const char digit : digits)
+    {
+      unsigned value;
+      if      (digit >= '0' && digit <= '9')        value = static_cast<unsigned>(digit - '0');
+      else if (hex && digit >= 'a' && digit <= 'f') value = static_cast<unsigned>(digit - 'a' + 10);
+      else if (hex && digit >= 'A' && digit <= 'F') value = static_cast<unsigned>(digit - 'A' + 10);
+      else                                          return false;
+      c = c * (hex ? 16 : 10) + value;
+      if (c > 0x10ffff) return false;
+    }
+    out.clear();
+    AppendUtf8(c, out);
+    return true;
+  }
+
+  // true if line starts with prefix
+  bool StartsWith(const DumpReaderS::CellT line, const DumpReaderS::CellT prefix)
+  {
+    return line.substr(0, prefix.length()) == prefix;
+  }
+}
+
+DumpReaderS::DumpReaderS(TableFuncT tableFunc, const bool xml)
+  : tableFuncM(std::move(tableFunc))
+  , xmlM(xml)
+  , stateM(xml ? ST_MARKUP : ST_TEXT)
+  , numPagesM(0)
+  , indexM(0)
+  , skipLineM(false)
+  , depthM(0)
+  , tableIndexM(0)
+{
+}
+
+std::size_t DumpReaderS::Scan(const CellT data, const bool final)
+{
+  if (!xmlM)
+  {
+    Put(data);
+    if (final) EndText();
+    return data.length();
+  }
+  std::size_t pos(0);
+  while (pos < data.length())
+  {
+    const std::size_t tagStart(data.find('<', pos));
+    if (stateM == ST_MARKUP)
+    {
+      // anything between elements is whitespace, or content we don't want
+      if (tagStart == CellT::npos) return data.length();
+      const std::size_t tagEnd(data.find('>', tagStart));
+      if (tagEnd == CellT::npos) return final ? data.length() : tagStart;
+      Tag(data.substr(tagStart + 1, tagEnd - tagStart - 1));
+      pos = tagEnd + 1;
+      continue;
+    }
+    // title or text content runs up to the next tag, as "<" within it is always escaped
+    const std::size_t contentEnd(tagStart == CellT::npos ? data.length() : tagStart);
+    pos = Content(data, pos, contentEnd, final || tagStart != CellT::npos);
+    // a dump cut off in the middle of a page's text still yields the tables in it
+    if (tagStart == CellT::npos && !final) return pos;
+    if (stateM == ST_TEXT) EndText();
+    stateM = ST_MARKUP;
+  }
+  // the final part may be empty, in which case the text of a dump cut off in the middle of a page ends here
+  if (final && stateM != ST_MARKUP)
+  {
+    if (stateM == ST_TEXT) EndText();
+    stateM = ST_MARKUP;
+  }
+  return pos;
+}
+
+std::size_t DumpReaderS::ForEachTable(const std::string& filename, const TableFuncT& tableFunc, const bool xml)
+{
+  // blocks end at line ends, so that a tag or entity is rarely cut off by one
+  BlockReaderS blocks(filename, true, READ_BLOCKS);
+  ChannelS<TableTextS> channel(CHANNEL_TABLES);
+  std::size_t numPages(0);
+  std::exception_ptr scanError;
+  std::thread scanThread([&blocks, &channel, &numPages, &scanError, xml]()
+  {
+    try
+    {
+      DumpReaderS reader([&channel](TableTextS&& table)
+      {
+        if (!channel.Push(std::move(table))) throw StoppedS();
+      }, xml);
+      // unscanned end of the last block, to scan along with the next one
+      std::string carry;
+      for (;;)
+      {
+        BlockReaderS::BlockS* const block(blocks.Next());
+        const CellT data(block ? block->View() : CellT());
+        if (carry.empty())
+        {
+          carry.assign(data.substr(reader.Scan(data, !block)));
+        }
+        else
+        {
+          carry.append(data);
+          carry.erase(0, reader.Scan(carry, !block));
+        }
+        if (!block) break;
+        blocks.Release(block);
+      }
+      numPages = reader.NumPages();
+    }
+    catch (const StoppedS&)
+    {
+    }
+    catch (...)
+    {
+      scanError = std::current_exception();
+    }
+    channel.Close();
+  });
+  try
+  {
+    TableTextS table;
+    while (channel.Pop(table)) tableFunc(std::move(table));
+  }
+  catch (...)
+  {
+    blocks.Stop();
+    channel.Close();
+    scanThread.join();
+    throw;
+  }
+  scanThread.join();
+  if (scanError) std::rethrow_exception(scanError);
+  return numPages;
+}
+
+void DumpReaderS::Tag(const CellT tag)
+{
+  const bool closing(StartsWith(tag, "/"));
+  const bool empty(!tag.empty() && tag.back() == '/');
+  const CellT name(tag.substr(closing, tag.find_first_of(" \t\r\n/", closing) - closing));
+  if (closing || empty) return;
+  if (name == "page")
+  {
+    ++numPagesM;
+    titleM.clear();
+  }
+  else if (name == "title")
+  {
+    titleM.clear();
+    stateM = ST_TITLE;
+  }
+  else if (name == "text")
+  {
+    indexM = 0;
+    stateM = ST_TEXT;
+  }
+}
+
+std::size_t DumpReaderS::Content(const CellT data, std::size_t pos, const std::size_t end, const bool complete)
+{
+  std::string decoded;
+  while (pos < end)
+  {
+    const char* const amp(static_cast<const char*>(std::memchr(data.data() + pos, '&', end - pos)));
+    if (!amp)
+    {
+      Put(data.substr(pos, end - pos));
+      return end;
+    }
+    const std::size_t entityStart(static_cast<std::size_t>(amp - data.data()));
+    Put(data.substr(pos, entityStart - pos));
+    const CellT entity(data.substr(entityStart, std::min(end - entityStart, MAX_ENTITY)));
+    const std::size_t semicolon(entity.find(';'));
+    if (semicolon == CellT::npos && !complete && entity.length() < MAX_ENTITY) return entityStart;
+    if (semicolon != CellT::npos && DecodeEntity(entity.substr(1, semicolon - 1), decoded))
+    {
+      Put(decoded);
+      pos = entityStart + semicolon + 1;
+    }
+    else
+    {
+      // not an entity after all; keep the ampersand as it is
+      Put("&");
+      pos = entityStart + 1;
+    }
+  }
+  return end;
+}
+
+void DumpReaderS::Put(CellT decoded)
+{
+  if (stateM == ST_TITLE)
+  {
+    titleM.append(decoded);
+    return;
+  }
+  while (!decoded.empty())
+  {
+    const std::size_t newline(decoded.find('\n'));
+    if (!skipLineM)
+    {
+      lineM.append(decoded.substr(0, newline));
+      // outside tables, only the start of a line matters
+      if (!depthM && lineM.length() >= 2 && !StartsWith(lineM, "{|"))
+      {
+        lineM.clear();
+        skipLineM = true;
+      }
+    }
+    if (newline == CellT::npos) return;
+    EndLine();
+    decoded.remove_prefix(newline + 1);
+  }
+}
+
+void DumpReaderS::EndLine()
+{
+  if (!skipLineM)
+  {
+    if (StartsWith(lineM, "{|"))
+    {
+      ++indexM;
+      if (!depthM++) tableIndexM = indexM;
+    }
+    if (depthM)
+    {
+      tableM.append(lineM);
+      tableM += '\n';
+      if (StartsWith(lineM, "|}") && !--depthM)
+      {
+        tableFuncM(TableTextS{titleM, tableIndexM, std::move(tableM)});
+        tableM.clear();
+      }
+    }
+  }
+  lineM.clear();
+  skipLineM = false;
+}
+
+void DumpReaderS::EndText()
+{
+  EndLine();
+  if (depthM)
+  {
+    tableFuncM(TableTextS{titleM, tableIndexM, std::move(tableM)});
+    tableM.clear();
+    depthM = 0;
+  }
+}
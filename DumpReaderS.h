@@ -0,0 +1,97 @@
+#ifndef DUMPREADERS_H
+#define DUMPREADERS_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// streaming reader of MediaWiki XML dumps (such as pages-articles.xml), which picks out the wiki tables in the text
+//  of each page in a single pass
+// the dump is scanned part by part for the few elements of interest (page, title, text), without building a document
+//  tree; page text is entity-decoded as it's scanned, and only the lines of tables are kept
+// a table runs from a line starting with "{|" to the line starting with "|}" that closes it, including any tables
+//  nested in it; one left open at the end of a page's text runs to there
+// plain wiki text (such as a single article) can be scanned the same way, as the text of one untitled page
+struct DumpReaderS
+{
+  typedef std::string_view CellT;
+
+  // a table found in a dump
+  struct TableTextS
+  {
+    // title of the page it's on
+    std::string pageM;
+    // its number among the tables of the page's text, from 1; nested tables are counted too, so the tables nested
+    //  in it are numbered from indexM + 1 in order of their "{|" lines
+    std::size_t indexM;
+    // its wiki markup, one line per line of the page
+    std::string textM;
+  };
+
+  typedef std::function<void(TableTextS&&)> TableFuncT;
+
+  // construct a scanner, which hands each table it finds to tableFunc, of an XML dump, or (if xml is false) of plain
+  //  wiki text
+  explicit DumpReaderS(TableFuncT tableFunc, bool xml = true);
+
+  // scan the next part of the input, and return how many bytes of it were used; the rest (an incomplete tag or
+  //  entity) must be passed again at the start of the next part
+  // if final is set, this is the last part, and all of it is used
+  std::size_t Scan(CellT data, bool final);
+
+  // number of pages scanned so far
+  std::size_t NumPages() const { return numPagesM; }
+
+  // scan dump file (or stdin, if it's MappedFileS::STDIN_NAME), or plain wiki text if xml is false, and call
+  //  tableFunc with each table found
+  // this runs as a pipeline of three threads, with bounded queues between them: one reads the file in blocks (see
+  //  BlockReaderS), one scans them, and the calling thread runs tableFunc, so that reading, scanning and processing
+  //  tables all overlap
+  // returns the number of pages scanned
+  // throws std::runtime_error if file cannot be opened or read; an exception thrown by tableFunc stops the scan, and
+  //  is passed on
+  static std::size_t ForEachTable(const std::string& filename, const TableFuncT& tableFunc, bool xml = true);
+
+private:
+  enum StateE
+  {
+    // between elements, looking for the next tag
+    ST_MARKUP,
+    // in a page title
+    ST_TITLE,
+    // in page text
+    ST_TEXT
+  };
+
+  // handle a tag (the part between "<" and ">")
+  void Tag(CellT tag);
+  // decode content in data[pos, end), and return the position decoded up to; if complete is false, the content may
+  //  continue in the next part, so an entity cut off by end is left undecoded
+  std::size_t Content(CellT data, std::size_t pos, std::size_t end, bool complete);
+  // add decoded content to the current title or text
+  void Put(CellT decoded);
+  // end the current line of page text
+  void EndLine();
+  // end the current page text
+  void EndText();
+
+  TableFuncT  tableFuncM;
+  bool        xmlM;
+  StateE      stateM;
+  std::size_t numPagesM;
+  // title of the current page
+  std::string titleM;
+  // number of tables (nested ones included) started in the current text so far
+  std::size_t indexM;
+  // the current line of text, while it might belong to a table; once a line is known not to (it doesn't start a
+  //  table, and none is open), the rest of it is skipped
+  std::string lineM;
+  bool        skipLineM;
+  // nesting depth of the open table, if any, its number, and its lines so far
+  std::size_t depthM;
+  std::size_t tableIndexM;
+  std::string tableM;
+};
+
+#endif
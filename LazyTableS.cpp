@@ -0,0 +1,382 @@
+#include "LazyTableS.h"
+
+#include "DelimScanS.h"
+#include "MappedFileS.h"
+#include "OutputS.h"
+#include "ParallelS.h"
+#include "SnapshotS.h"
+#include "StatsS.h"
+#include "TitleKeyS.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace
+{
+  // minimum input bytes per LoadTSV() worker thread
+  const std::size_t MIN_LOAD_CHUNK(1 << 20);
+  // minimum rows per sort worker thread
+  const std::size_t MIN_SORT_ROWS(1 << 15);
+  // initial size of the arena that split rows are allocated from
+  const std::size_t SPLIT_ARENA_SIZE(1 << 16);
+  // checkbox markup that cleaning lowercases (see TableS::CleanCheckCell())
+  const LazyTableS::CellT MARKUP_CHECK_MIXED[] = {"{{Ya}}", "{{yA}}", "{{YA}}"};
+
+  // true for the whitespace characters that stripping removes, other than the tab delimiter (and newline, which
+  //  never appears within a line)
+  inline bool IsCellSpace(const char c)
+  {
+    return c == ' ' || c == '\v' || c == '\f' || c == '\r';
+  }
+
+  // sort key of a row's title, and the row's original position
+  struct SortEntryS
+  {
+    LazyTableS::CellT keyM;
+    std::size_t       rowM;
+
+    bool operator<(const SortEntryS& other) const { return keyM < other.keyM; }
+  };
+
+  // rows found in a newline-aligned chunk of TSV text
+  struct PartS
+  {
+    std::vector<LazyTableS::RowS> rowsM;
+    std::size_t                   maxCellsM;
+    std::size_t                   numCellsM;
+
+    PartS() : maxCellsM(0), numCellsM(0) {}
+  };
+
+  // true if a cell starting at cell (with length bytes of text from there) starts with checkbox markup that cleaning
+  //  would lowercase
+  // a longer cell merely starting with it makes its row split needlessly, but that's harmless
+  inline bool IsMixedCheck(const char* const cell, const std::size_t length)
+  {
+    if (cell[0] != '{' || length < MARKUP_CHECK_MIXED[0].length()) return false;
+    const LazyTableS::CellT markup(cell, MARKUP_CHECK_MIXED[0].length());
+    for (const LazyTableS::CellT mixed : MARKUP_CHECK_MIXED)
+    {
+      if (markup == mixed) return true;
+    }
+    return false;
+  }
+
+  // find the rows of TSV text, as TableS::LoadTSV() would split it, adding them to part
+  // only newlines and tabs are located, with DelimScanS::ForEachDelim(): the first tab of each line ends its title, and
+  //  the rest are counted; while the bytes are at hand, those on either side of each tab are checked for anything
+  //  WikiTitleClean() would change (whitespace to strip, or checkbox markup to lowercase), so that it knows which
+  //  rows need splitting without reading them again
+  void ScanRows(const LazyTableS::CellT text, PartS& part)
+  {
+    const char* const base(text.data());
+    const std::size_t length(text.length());
+    std::size_t lineStart(0);
+    std::size_t firstTab(LazyTableS::CellT::npos);
+    std::size_t numTabs(0);
+    bool restClean(true);
+    DelimScanS::ForEachDelim(text, [&](const std::size_t pos)
+    {
+      ++numTabs;
+      // (the byte before the first tab is the title's, which is stripped separately)
+      if (firstTab == LazyTableS::CellT::npos) firstTab = pos;
+      else if (restClean && IsCellSpace(base[pos - 1])) restClean = false;
+      if (restClean && pos + 1 < length &&
+          (IsCellSpace(base[pos + 1]) || IsMixedCheck(base + pos + 1, length - pos - 1)))
+      {
+        restClean = false;
+      }
+    },
+    [&](std::size_t lineEnd, const bool cr)
+    {
+      // drop CR of a CRLF line ending
+      const std::size_t nextLine(lineEnd + 1);
+      if (cr && lineEnd > lineStart) --lineEnd;
+      const bool hasTab(firstTab != LazyTableS::CellT::npos);
+      const std::size_t titleEnd(hasTab ? firstTab : lineEnd);
+      if (hasTab && IsCellSpace(base[lineEnd - 1])) restClean = false;
+      part.rowsM.push_back(LazyTableS::RowS{
+        TableS::StripCell(LazyTableS::CellT(base + lineStart, titleEnd - lineStart)),
+        hasTab ? LazyTableS::CellT(base + firstTab, lineEnd - firstTab) : LazyTableS::CellT(),
+        numTabs + 1, LazyTableS::NOT_SPLIT, restClean});
+      part.maxCellsM = std::max(part.maxCellsM, numTabs + 1);
+      part.numCellsM += numTabs + 1;
+      lineStart = nextLine;
+      firstTab = LazyTableS::CellT::npos;
+      numTabs = 0;
+      restClean = true;
+    });
+  }
+
+  // append the cells of a row that hasn't been split to cells, as TableS::LoadTSV() would have split it
+  void SplitRow(const LazyTableS::RowS& row, TableS::ColListT& cells)
+  {
+    cells.push_back(row.titleM);
+    if (row.restM.empty()) return;
+    for (std::size_t cellStart(1);;)
+    {
+      const std::size_t tab(row.restM.find('\t', cellStart));
+      cells.push_back(TableS::StripCell(row.restM.substr(cellStart, tab - cellStart)));
+      if (tab == LazyTableS::CellT::npos) break;
+      cellStart = tab + 1;
+    }
+  }
+}
+
+LazyTableS::LazyTableS()
+{
+}
+
+void LazyTableS::LoadTSV(const std::string& filename)
+{
+  // open first, so that a failure leaves the current contents intact
+  MappedFileS inFile;
+  {
+    StatsS::TimerS timer(tableM.statsM, StatsS::PH_READ);
+    inFile.Open(filename);
+    timer.Count(inFile.View().length(), 0, 0);
+  }
+  tableM.Clear();
+  rowsM.clear();
+  tableM.inputM = std::move(inFile);
+  const CellT text(tableM.inputM.View());
+  if (SnapshotS::Detect(text))
+  {
+    // a snapshot is split already
+    tableM.ParseSnapshot(text);
+    rowsM.reserve(tableM.dataM.size());
+    for (std::size_t rowNum(0); rowNum < tableM.dataM.size(); ++rowNum)
+    {
+      const TableS::ColListT& cells(tableM.dataM[rowNum]);
+      rowsM.push_back(RowS{TableS::Cell(cells, 0), CellT(), cells.size(), rowNum, false});
+    }
+    return;
+  }
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_TOKENIZE);
+  // header line first, so that parts only see data rows
+  std::size_t bodyStart(text.find('\n'));
+  bodyStart = (bodyStart == CellT::npos ? text.length() : bodyStart + 1);
+  TableS::ForEachTSVRow(text.substr(0, bodyStart), [this](const TableS::ColListT& row)
+  {
+    tableM.headerM.assign(row.begin(), row.end());
+  });
+  // split body into one chunk per thread, moving each boundary to just past the next newline, and scan each
+  const CellT body(text.substr(bodyStart));
+  const std::size_t threads(ParallelS::NumThreads(tableM.threadsM, body.length(), MIN_LOAD_CHUNK));
+  std::vector<std::size_t> bounds(threads + 1, body.length());
+  bounds[0] = 0;
+  for (std::size_t part(1); part < threads; ++part)
+  {
+    const std::size_t newline(body.find('\n', std::max(bounds[part - 1], body.length() * part / threads)));
+    bounds[part] = (newline == CellT::npos ? body.length() : newline + 1);
+  }
+  std::vector<PartS> parts(threads);
+  ParallelS::Run(threads, [&body, &bounds, &parts](const std::size_t part)
+  {
+    ScanRows(body.substr(bounds[part], bounds[part + 1] - bounds[part]), parts[part]);
+  });
+  // splice the parts' rows together in order; the header is as wide as the widest row, as after TableS::Normalize()
+  std::size_t numRows(0);
+  std::size_t numCells(tableM.headerM.size());
+  for (const PartS& part : parts) numRows += part.rowsM.size();
+  rowsM.reserve(numRows);
+  for (PartS& part : parts)
+  {
+    std::move(part.rowsM.begin(), part.rowsM.end(), std::back_inserter(rowsM));
+    std::vector<RowS>().swap(part.rowsM);
+    tableM.numColsM = std::max(tableM.numColsM, part.maxCellsM);
+    numCells += part.numCellsM;
+  }
+  tableM.numColsM = std::max(tableM.numColsM, tableM.headerM.size());
+  tableM.headerM.resize(tableM.numColsM);
+  timer.Count(text.length(), numRows, numCells);
+}
+
+void LazyTableS::PrintSnapshot() const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintSnapshot(out);
+  out.Flush();
+}
+
+void LazyTableS::PrintSnapshot(OutputS& out) const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  const std::size_t numCols(tableM.numColsM);
+  std::size_t numCells(numCols);
+  for (const RowS& row : rowsM) numCells += row.numCellsM;
+  // the snapshot is written row by row (in a few passes), so each row is split just once per pass
+  TableS::ColListT scratch;
+  const TableS::ColListT* cells(nullptr);
+  std::size_t cellsRow(0);
+  // row 0 is the header
+  SnapshotS::Write(numCols, rowsM.size() + 1,
+                   [this, numCols](const std::size_t row) { return row ? rowsM[row - 1].numCellsM : numCols; },
+                   [&](const std::size_t row, const std::size_t col)
+                   {
+                     if (!row) return tableM.headerM[col];
+                     if (!cells || cellsRow != row)
+                     {
+                       cells = &Cells(rowsM[row - 1], scratch);
+                       cellsRow = row;
+                     }
+                     return (*cells)[col];
+                   },
+                   out);
+  timer.Count(out.BytesWritten() - startBytes, rowsM.size(), numCells);
+}
+
+void LazyTableS::PrintTSV() const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintTSV(out);
+  out.Flush();
+}
+
+void LazyTableS::PrintTSV(OutputS& out) const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  const std::size_t numCols(tableM.numColsM);
+  // now print the header row (if non-empty)
+  if (!tableM.headerM.empty())
+  {
+    for (std::size_t col(0); col < tableM.headerM.size(); ++col)
+    {
+      if (col) out << '\t';
+      out << tableM.headerM[col];
+    }
+    out << '\n';
+  }
+  // now print the data rows: those that were split cell by cell, the rest as their title plus the rest of their line
+  for (const RowS& row : rowsM)
+  {
+    if (row.splitM != NOT_SPLIT)
+    {
+      const TableS::ColListT& cells(tableM.dataM[row.splitM]);
+      for (std::size_t col(0); col < cells.size(); ++col)
+      {
+        if (col) out << '\t';
+        out << cells[col];
+      }
+    }
+    else
+    {
+      out << row.titleM << row.restM;
+    }
+    // tabs before the missing trailing (empty) cells of a short row
+    for (std::size_t col(row.numCellsM); col < numCols; ++col) out << '\t';
+    out << '\n';
+  }
+  timer.Count(out.BytesWritten() - startBytes, rowsM.size(), (rowsM.size() + 1) * numCols);
+}
+
+void LazyTableS::PrintWiki() const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintWiki(out);
+  out.Flush();
+}
+
+void LazyTableS::PrintWiki(OutputS& out) const
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  const std::size_t numCols(tableM.numColsM);
+  TableS::PrintWikiStart(tableM.headerM, tableM.headerM.size(), out);
+  // wiki markup puts each cell on a line of its own, so every row is split, into a scratch row if not already
+  TableS::ColListT scratch;
+  for (const RowS& row : rowsM) TableS::PrintWikiRow(Cells(row, scratch), numCols, out);
+  TableS::PrintWikiEnd(out);
+  timer.Count(out.BytesWritten() - startBytes, rowsM.size(), (rowsM.size() + 1) * numCols);
+}
+
+void LazyTableS::WikiTitleClean()
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_CLEAN);
+  // number of cells rewritten, for stats
+  std::size_t changed(0);
+  // arena for rows split here, created once one is
+  std::pmr::memory_resource* splitArena(nullptr);
+  for (RowS& row : rowsM)
+  {
+    // a row needs splitting if its title is empty (so that another cell becomes the title), or if its other cells
+    //  need cleaning; otherwise only its title is cleaned, and the rest of its line is left as it is
+    if (row.splitM == NOT_SPLIT && !row.titleM.empty() && row.restCleanM)
+    {
+      if (tableM.CleanTitleCell(row.titleM)) ++changed;
+      continue;
+    }
+    if (!splitArena && row.splitM == NOT_SPLIT) splitArena = tableM.NewArena(SPLIT_ARENA_SIZE);
+    TableS::ColListT& cells(Split(row, splitArena));
+    changed += tableM.CleanRow(cells);
+    row.titleM = TableS::Cell(cells, 0);
+  }
+  timer.Count(0, rowsM.size(), changed);
+}
+
+void LazyTableS::WikiTitleSort()
+{
+  StatsS::TimerS timer(tableM.statsM, StatsS::PH_SORT);
+  // clean titles so that we can make assumptions
+  WikiTitleClean();
+  // derive the sort key of each row from its title, once
+  // each thread writes the keys for a range of rows into its own arena, reserved up front so that it never
+  //  reallocates and key views stay valid
+  const std::size_t numRows(rowsM.size());
+  const std::size_t threads(ParallelS::NumThreads(tableM.threadsM, numRows, MIN_SORT_ROWS));
+  std::vector<SortEntryS> entries(numRows);
+  std::vector<std::string> keyArenas(threads);
+  ParallelS::Run(threads, [this, threads, numRows, &entries, &keyArenas](const std::size_t part)
+  {
+    const std::size_t rowStart(numRows * part / threads);
+    const std::size_t rowEnd(numRows * (part + 1) / threads);
+    std::string& keyArena(keyArenas[part]);
+    std::size_t arenaSize(0);
+    for (std::size_t rowNum(rowStart); rowNum < rowEnd; ++rowNum)
+    {
+      arenaSize += TitleKeyS::MaxLength(rowsM[rowNum].titleM.length());
+    }
+    keyArena.reserve(arenaSize);
+    for (std::size_t rowNum(rowStart); rowNum < rowEnd; ++rowNum)
+    {
+      const std::size_t keyStart(keyArena.length());
+      TitleKeyS::Append(rowsM[rowNum].titleM, keyArena, tableM.foldM);
+      entries[rowNum].keyM = CellT(keyArena.data() + keyStart, keyArena.length() - keyStart);
+      entries[rowNum].rowM = rowNum;
+    }
+  });
+  // stable sort, so that rows with duplicate keys keep their relative order
+  ParallelS::StableSort(entries, threads);
+  // move row records into sorted order; split rows' cells stay where they are
+  std::vector<RowS> sorted;
+  sorted.reserve(numRows);
+  for (const SortEntryS& entry : entries) sorted.push_back(rowsM[entry.rowM]);
+  rowsM.swap(sorted);
+  timer.Count(0, numRows, 0);
+}
+
+TableS::ColListT& LazyTableS::Split(RowS& row, std::pmr::memory_resource* const resource)
+{
+  if (row.splitM == NOT_SPLIT)
+  {
+    tableM.dataM.emplace_back(resource);
+    tableM.dataM.back().reserve(row.numCellsM);
+    SplitRow(row, tableM.dataM.back());
+    row.splitM = tableM.dataM.size() - 1;
+  }
+  return tableM.dataM[row.splitM];
+}
+
+const TableS::ColListT& LazyTableS::Cells(const RowS& row, TableS::ColListT& scratch) const
+{
+  if (row.splitM != NOT_SPLIT) return tableM.dataM[row.splitM];
+  scratch.clear();
+  SplitRow(row, scratch);
+  return scratch;
+}
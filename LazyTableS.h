@@ -0,0 +1,81 @@
+#ifndef LAZYTABLES_H
+#define LAZYTABLES_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "TableS.h"
+
+struct OutputS;
+
+// lazily split table, as an alternative layout for tables that are only loaded, cleaned, sorted and printed
+// loading only finds each row's line in the input, its title (first cell) and its cell count; the rest of the line,
+//  from the tab that ends the title, is kept as it is, and printed by copying it
+// a row is only split into cells if a pass needs them: WikiTitleClean() splits just the rows with a cell to strip or
+//  checkbox markup to lowercase, as loading notes from the bytes around each tab (and untitled rows, whose title
+//  moves to another cell); a title that only needs italicizing is rewritten on its own
+// sorting derives keys from the titles alone and moves fixed-size row records, so its cost doesn't grow with the
+//  width of the table
+// output is identical to that of the same operations on a TableS
+struct LazyTableS
+{
+  typedef TableS::CellT CellT;
+
+  // row number in tableM.dataM of a row that hasn't been split
+  static constexpr std::size_t NOT_SPLIT = static_cast<std::size_t>(-1);
+
+  // one data row
+  struct RowS
+  {
+    // its first cell, stripped (and cleaned, once the table is)
+    CellT       titleM;
+    // the rest of its line, from the tab ending the first cell up to (not including) its line ending; empty if the
+    //  row has only one cell
+    CellT       restM;
+    std::size_t numCellsM;
+    // its cells in tableM.dataM once split, or NOT_SPLIT; a split row's titleM is kept as its first cell
+    std::size_t splitM;
+    // whether cleaning would leave restM as it is, as found when the row was loaded
+    bool        restCleanM;
+  };
+
+  // holds the header, the input and any rows that have been split into cells, and provides threadsM and statsM
+  TableS            tableM;
+  std::vector<RowS> rowsM;
+
+  // construct an empty table
+  LazyTableS();
+
+  LazyTableS(LazyTableS&&) = default;
+  LazyTableS& operator=(LazyTableS&&) = default;
+  LazyTableS(const LazyTableS&) = delete;
+  LazyTableS& operator=(const LazyTableS&) = delete;
+
+  std::size_t NumRows() const { return rowsM.size(); }
+
+  // as the TableS methods of the same names
+  // LoadTSV() finds rows with the same vectorized delimiter scan as TableS::LoadTSV(), but without splitting them;
+  //  large files are split into newline-aligned chunks that are scanned in parallel, according to tableM.threadsM
+  // a table snapshot is already split, so its rows are loaded as split rows that view its cells
+  // throws std::runtime_error if file cannot be opened, or is an invalid snapshot
+  void LoadTSV(const std::string& filename);
+  void PrintSnapshot() const;
+  void PrintSnapshot(OutputS& out) const;
+  void PrintTSV() const;
+  void PrintTSV(OutputS& out) const;
+  void PrintWiki() const;
+  void PrintWiki(OutputS& out) const;
+  void WikiTitleClean();
+  void WikiTitleSort();
+
+private:
+  // split row into cells in tableM.dataM, allocated from resource, if not done yet, and return them
+  TableS::ColListT& Split(RowS& row, std::pmr::memory_resource* resource);
+
+  // cells of row, split into scratch if the row hasn't been split; returns the cells
+  const TableS::ColListT& Cells(const RowS& row, TableS::ColListT& scratch) const;
+};
+
+#endif
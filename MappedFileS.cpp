@@ -0,0 +1,158 @@
+#include "MappedFileS.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPEDFILES_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  std::runtime_error OpenError(const std::string& filename)
+  {
+    return std::runtime_error(std::string("Failed to open input file: '") + filename + "' for read");
+  }
+}
+
+MappedFileS::MappedFileS()
+  : dataM(nullptr)
+  , sizeM(0)
+  , mappedM(false)
+{
+}
+
+MappedFileS::~MappedFileS()
+{
+  Close();
+}
+
+MappedFileS::MappedFileS(MappedFileS&& other) noexcept
+  : dataM(other.dataM)
+  , sizeM(other.sizeM)
+  , mappedM(other.mappedM)
+  , bufferM(std::move(other.bufferM))
+{
+  other.dataM = nullptr;
+  other.sizeM = 0;
+  other.mappedM = false;
+}
+
+MappedFileS& MappedFileS::operator=(MappedFileS&& other) noexcept
+{
+  if (this != &other)
+  {
+    Close();
+    dataM = other.dataM;
+    sizeM = other.sizeM;
+    mappedM = other.mappedM;
+    bufferM = std::move(other.bufferM);
+    other.dataM = nullptr;
+    other.sizeM = 0;
+    other.mappedM = false;
+  }
+  return *this;
+}
+
+void MappedFileS::Open(const std::string& filename)
+{
+  Close();
+  const bool isStdin(filename == STDIN_NAME);
+#ifdef MAPPEDFILES_POSIX
+  // stdin is read (or mapped, if redirected from a file) like any other file, but left open
+  const int fd(isStdin ? STDIN_FILENO : ::open(filename.c_str(), O_RDONLY));
+  if (fd < 0) throw OpenError(filename);
+  auto closeFd([fd, isStdin]() { if (!isStdin) ::close(fd); });
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+  {
+    // regular file; map it if non-empty
+    if (st.st_size == 0)
+    {
+      closeFd();
+      return;
+    }
+    void* p(::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0));
+    if (p != MAP_FAILED)
+    {
+      closeFd();
+#ifdef MADV_SEQUENTIAL
+      ::madvise(p, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+#endif
+      dataM = static_cast<const char*>(p);
+      sizeM = static_cast<std::size_t>(st.st_size);
+      mappedM = true;
+      return;
+    }
+  }
+  // not mappable (pipe, device, or mmap failure); read it all into the buffer instead
+  std::size_t used(0);
+  bufferM.resize(1 << 16);
+  for (;;)
+  {
+    if (used == bufferM.size()) bufferM.resize(bufferM.size() * 2);
+    const ssize_t n(::read(fd, bufferM.data() + used, bufferM.size() - used));
+    if (n < 0)
+    {
+      closeFd();
+      bufferM.clear();
+      throw OpenError(filename);
+    }
+    if (n == 0) break;
+    used += static_cast<std::size_t>(n);
+  }
+  closeFd();
+  bufferM.resize(used);
+#else
+  if (isStdin)
+  {
+    // can't seek stdin for its size, so read it in growing steps
+    std::size_t used(0);
+    bufferM.resize(1 << 16);
+    while (std::cin.read(bufferM.data() + used, static_cast<std::streamsize>(bufferM.size() - used)))
+    {
+      used = bufferM.size();
+      bufferM.resize(bufferM.size() * 2);
+    }
+    if (std::cin.bad())
+    {
+      bufferM.clear();
+      throw OpenError(filename);
+    }
+    bufferM.resize(used + static_cast<std::size_t>(std::cin.gcount()));
+  }
+  else
+  {
+    std::ifstream inFile(filename, std::ios::binary);
+    if (!inFile.is_open()) throw OpenError(filename);
+    inFile.seekg(0, std::ios::end);
+    const std::streamoff length(inFile.tellg());
+    inFile.seekg(0, std::ios::beg);
+    if (length > 0)
+    {
+      bufferM.resize(static_cast<std::size_t>(length));
+      inFile.read(bufferM.data(), length);
+      bufferM.resize(static_cast<std::size_t>(inFile.gcount()));
+    }
+  }
+#endif
+  dataM = bufferM.data();
+  sizeM = bufferM.size();
+}
+
+void MappedFileS::Close()
+{
+#ifdef MAPPEDFILES_POSIX
+  if (mappedM) ::munmap(const_cast<char*>(dataM), sizeM);
+#endif
+  std::vector<char>().swap(bufferM);
+  dataM = nullptr;
+  sizeM = 0;
+  mappedM = false;
+}
@@ -0,0 +1,48 @@
+#ifndef MAPPEDFILES_H
+#define MAPPEDFILES_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// read-only view of a whole input file
+// memory-maps the file where the platform supports it, otherwise (or if mapping fails, e.g. for a pipe) reads the
+//  file into a single heap buffer
+// contents stay valid and at a fixed address until the instance is closed or destroyed, so callers may hold
+//  std::string_view references into them
+struct MappedFileS
+{
+  MappedFileS();
+  ~MappedFileS();
+
+  MappedFileS(MappedFileS&& other) noexcept;
+  MappedFileS& operator=(MappedFileS&& other) noexcept;
+
+  MappedFileS(const MappedFileS&) = delete;
+  MappedFileS& operator=(const MappedFileS&) = delete;
+
+  // input name that stands for stdin
+  static constexpr const char* STDIN_NAME = "-";
+
+  // release any current contents, then map or read the given file (or stdin, if it's STDIN_NAME)
+  // throws std::runtime_error if file cannot be opened
+  void Open(const std::string& filename);
+
+  // release contents
+  void Close();
+
+  // view of file contents (empty if nothing is open)
+  std::string_view View() const { return std::string_view(dataM, sizeM); }
+
+  // true if contents are memory-mapped (as opposed to read into a buffer)
+  bool IsMapped() const { return mappedM; }
+
+private:
+  const char*       dataM;
+  std::size_t       sizeM;
+  bool              mappedM;
+  std::vector<char> bufferM;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "OutputS.h"
+
+#include <cerrno>
+#include <ostream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define OUTPUTS_POSIX 1
+#include <sys/uio.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+namespace
+{
+  std::runtime_error WriteError()
+  {
+    return std::runtime_error("Failed to write output");
+  }
+}
+
+OutputS::OutputS(const int fd)
+  : fdM(fd)
+  , streamM(nullptr)
+  , bufferM(new char[BUFFER_SIZE])
+  , usedM(0)
+  , flushedM(0)
+{
+}
+
+OutputS::OutputS(std::ostream& stream)
+  : fdM(-1)
+  , streamM(&stream)
+  , bufferM(new char[BUFFER_SIZE])
+  , usedM(0)
+  , flushedM(0)
+{
+}
+
+OutputS::~OutputS()
+{
+  try
+  {
+    Flush();
+  }
+  catch (const std::runtime_error&)
+  {
+  }
+}
+
+void OutputS::Flush()
+{
+  if (!usedM) return;
+  // mark buffer empty first, so that a failed write isn't retried from the destructor
+  const std::size_t used(usedM);
+  usedM = 0;
+  WriteOut(bufferM.get(), used);
+}
+
+void OutputS::WriteLarge(const std::string_view s)
+{
+  // medium writes: top off the buffer, flush, and carry on buffering
+  if (s.length() < BUFFER_SIZE / 2)
+  {
+    const std::size_t head(BUFFER_SIZE - usedM);
+    std::memcpy(bufferM.get() + usedM, s.data(), head);
+    usedM = BUFFER_SIZE;
+    Flush();
+    std::memcpy(bufferM.get(), s.data() + head, s.length() - head);
+    usedM = s.length() - head;
+    return;
+  }
+  // large writes: send buffer and data together, without copying the data
+#ifdef OUTPUTS_POSIX
+  if (!streamM)
+  {
+    const char* bufferData(bufferM.get());
+    std::size_t bufferLeft(usedM);
+    const char* data(s.data());
+    std::size_t dataLeft(s.length());
+    usedM = 0;
+    // gather both until the buffered part is out, then finish the rest with plain writes
+    while (bufferLeft)
+    {
+      struct iovec iov[2];
+      iov[0].iov_base = const_cast<char*>(bufferData);
+      iov[0].iov_len = bufferLeft;
+      iov[1].iov_base = const_cast<char*>(data);
+      iov[1].iov_len = dataLeft;
+      const ssize_t n(::writev(fdM, iov, 2));
+      if (n < 0)
+      {
+        if (errno == EINTR) continue;
+        throw WriteError();
+      }
+      std::size_t written(static_cast<std::size_t>(n));
+      flushedM += written;
+      if (written < bufferLeft)
+      {
+        bufferData += written;
+        bufferLeft -= written;
+        continue;
+      }
+      written -= bufferLeft;
+      bufferLeft = 0;
+      data += written;
+      dataLeft -= written;
+    }
+    WriteOut(data, dataLeft);
+    return;
+  }
+#endif
+  Flush();
+  WriteOut(s.data(), s.length());
+}
+
+void OutputS::WriteOut(const char* data, std::size_t length)
+{
+  flushedM += length;
+  if (streamM)
+  {
+    if (!streamM->write(data, static_cast<std::streamsize>(length))) throw WriteError();
+    return;
+  }
+  while (length)
+  {
+#ifdef OUTPUTS_POSIX
+    const ssize_t n(::write(fdM, data, length));
+#else
+    const int n(::_write(fdM, data, static_cast<unsigned>(length < (1u << 30) ? length : (1u << 30))));
+#endif
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      throw WriteError();
+    }
+    data += n;
+    length -= static_cast<std::size_t>(n);
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef OUTPUTS_H
+#define OUTPUTS_H
+
+#include <cstddef>
+#include <cstring>
+#include <iosfwd>
+#include <memory>
+#include <string_view>
+
+// buffered output writer
+// formats into a large reusable buffer, and hands it to the destination (a file descriptor, or any std::ostream) in
+//  big blocks; writes too large to be worth copying go straight out alongside the buffered data, with a single
+//  scatter/gather write where the platform supports it
+struct OutputS
+{
+  // file descriptor for stdout
+  static const int FD_STDOUT = 1;
+  // buffer size
+  static const std::size_t BUFFER_SIZE = 1 << 20;
+
+  // write to an open file descriptor, which is not closed by OutputS
+  explicit OutputS(int fd);
+
+  // write to stream
+  explicit OutputS(std::ostream& stream);
+
+  // flushes any buffered data, ignoring errors (call Flush() first to detect them)
+  ~OutputS();
+
+  OutputS(const OutputS&) = delete;
+  OutputS& operator=(const OutputS&) = delete;
+
+  // append s to output
+  void Write(const std::string_view s)
+  {
+    if (s.length() <= BUFFER_SIZE - usedM)
+    {
+      // empty views may have a null data pointer, which memcpy() mustn't be given even for zero bytes
+      if (s.empty()) return;
+      std::memcpy(bufferM.get() + usedM, s.data(), s.length());
+      usedM += s.length();
+      return;
+    }
+    WriteLarge(s);
+  }
+
+  // append c to output
+  void Put(const char c)
+  {
+    if (usedM == BUFFER_SIZE) Flush();
+    bufferM[usedM++] = c;
+  }
+
+  // append count copies of c to output
+  void Fill(const char c, std::size_t count)
+  {
+    while (count)
+    {
+      if (usedM == BUFFER_SIZE) Flush();
+      const std::size_t n(count < BUFFER_SIZE - usedM ? count : BUFFER_SIZE - usedM);
+      std::memset(bufferM.get() + usedM, c, n);
+      usedM += n;
+      count -= n;
+    }
+  }
+
+  OutputS& operator<<(const std::string_view s) { Write(s); return *this; }
+  OutputS& operator<<(const char c)             { Put(c);   return *this; }
+
+  // write all buffered data to the destination
+  // throws std::runtime_error on write failure
+  void Flush();
+
+  // total number of bytes appended so far, including any still in the buffer
+  std::size_t BytesWritten() const { return flushedM + usedM; }
+
+private:
+  // Write() for data that doesn't fit in the remaining buffer space
+  void WriteLarge(std::string_view s);
+  // write data directly to destination, bypassing the buffer
+  void WriteOut(const char* data, std::size_t length);
+
+  int                     fdM;
+  std::ostream*           streamM;
+  std::unique_ptr<char[]> bufferM;
+  std::size_t             usedM;
+  // bytes handed to the destination so far
+  std::size_t             flushedM;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef PARALLELS_H
+#define PARALLELS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+// helpers for splitting table operations across threads
+struct ParallelS
+{
+  // number of threads to actually use for a job of the given size, given a requested count (0 meaning one per
+  //  hardware thread) and a minimum job size per thread
+  static std::size_t NumThreads(const unsigned requested, const std::size_t jobSize, const std::size_t minPerThread)
+  {
+    std::size_t threads(requested ? requested : std::thread::hardware_concurrency());
+    threads = std::min(threads, jobSize / minPerThread);
+    return threads ? threads : 1;
+  }
+
+  // call func(part) for each part in [0, parts), each on its own thread (the last one on the calling thread), and
+  //  wait for all of them to finish
+  template <typename FuncT>
+  static void Run(const std::size_t parts, FuncT func)
+  {
+    std::vector<std::thread> threads;
+    threads.reserve(parts - 1);
+    for (std::size_t part(0); part + 1 < parts; ++part) threads.emplace_back(func, part);
+    func(parts - 1);
+    for (std::thread& t : threads) t.join();
+  }
+
+  // stable-sort v using up to the given number of threads
+  // v is split into equal parts that are sorted concurrently, then merged pairwise in rounds; each merge is itself
+  //  split into independent pieces at points found by binary search, so that all threads stay busy to the end
+  template <typename T>
+  static void StableSort(std::vector<T>& v, const std::size_t threads)
+  {
+    if (threads <= 1)
+    {
+      std::stable_sort(v.begin(), v.end());
+      return;
+    }
+    // use a power-of-two number of parts, so that they pair up evenly
+    std::size_t parts(1);
+    while (parts * 2 <= threads) parts *= 2;
+    std::vector<std::size_t> bounds(parts + 1);
+    for (std::size_t part(0); part <= parts; ++part) bounds[part] = v.size() * part / parts;
+    Run(parts, [&v, &bounds](const std::size_t part)
+    {
+      std::stable_sort(v.begin() + bounds[part], v.begin() + bounds[part + 1]);
+    });
+    // merge runs of width parts into runs of twice that, alternating between v and a buffer
+    std::vector<T> buffer(v.size());
+    for (std::size_t width(1); width < parts; width *= 2)
+    {
+      // split each merge of [lo, mid) and [mid, hi) into pieces: piece boundaries are evenly spaced in the left
+      //  run, and the matching right run position is the first element not less than the left one, which keeps
+      //  the merge stable
+      struct PieceS { std::size_t leftM, leftEndM, rightM, rightEndM, outM; };
+      std::vector<PieceS> pieces;
+      const std::size_t merges(parts / (2 * width));
+      const std::size_t piecesPerMerge(std::max<std::size_t>(1, threads / merges));
+      for (std::size_t merge(0); merge < merges; ++merge)
+      {
+        const std::size_t lo(bounds[2 * width * merge]);
+        const std::size_t mid(bounds[2 * width * merge + width]);
+        const std::size_t hi(bounds[2 * width * (merge + 1)]);
+        std::size_t left(lo);
+        std::size_t right(mid);
+        for (std::size_t piece(1); piece <= piecesPerMerge; ++piece)
+        {
+          std::size_t leftEnd(mid);
+          std::size_t rightEnd(hi);
+          if (piece < piecesPerMerge)
+          {
+            leftEnd = std::max(left, lo + (mid - lo) * piece / piecesPerMerge);
+            rightEnd = (leftEnd == mid) ? hi : static_cast<std::size_t>(
+              std::lower_bound(v.begin() + right, v.begin() + hi, v[leftEnd]) - v.begin());
+          }
+          pieces.push_back(PieceS{left, leftEnd, right, rightEnd, left + right - mid});
+          left = leftEnd;
+          right = rightEnd;
+        }
+      }
+      Run(pieces.size(), [&v, &buffer, &pieces](const std::size_t pieceNum)
+      {
+        const PieceS& p(pieces[pieceNum]);
+        std::merge(std::make_move_iterator(v.begin() + p.leftM), std::make_move_iterator(v.begin() + p.leftEndM),
+                   std::make_move_iterator(v.begin() + p.rightM), std::make_move_iterator(v.begin() + p.rightEndM),
+                   buffer.begin() + p.outM);
+      });
+      v.swap(buffer);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "SnapshotS.h"
+
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+  const std::string_view MAGIC("WTSVSNAP", 8);
+  // written as a native integer, so that it reads back differently in the other byte order
+  const std::uint64_t BYTE_ORDER_MARK(0x0102030405060708);
+  // magic, then version, byte order mark, column count, row count, cell count and blob size
+  const std::size_t HEADER_SIZE(8 + 6 * 8);
+
+  // size in bytes of an index of count + 1 offsets, or 0 if that overflows
+  std::size_t IndexSize(const std::uint64_t count)
+  {
+    const std::uint64_t max(std::numeric_limits<std::size_t>::max() / 8 - 1);
+    return count > max ? 0 : static_cast<std::size_t>(count + 1) * 8;
+  }
+
+  [[noreturn]] void Invalid(const std::string& what)
+  {
+    throw std::runtime_error("Invalid table snapshot: " + what);
+  }
+}
+
+SnapshotS::SnapshotS(const std::string_view data)
+  : numColsM(0)
+  , numRowsM(0)
+  , numCellsM(0)
+  , rowIndexM(nullptr)
+  , cellIndexM(nullptr)
+  , blobM(nullptr)
+{
+  if (!Detect(data) || data.length() < HEADER_SIZE) Invalid("bad header");
+  std::uint64_t fields[6];
+  std::memcpy(fields, data.data() + MAGIC.length(), sizeof(fields));
+  if (fields[1] != BYTE_ORDER_MARK) Invalid("written on a machine of different byte order");
+  if (fields[0] != VERSION) Invalid("unsupported version " + std::to_string(fields[0]));
+  // check section sizes add up to the data size without overflowing
+  const std::size_t rowIndexSize(IndexSize(fields[3]));
+  const std::size_t cellIndexSize(IndexSize(fields[4]));
+  const std::size_t remaining(data.length() - HEADER_SIZE);
+  if (!rowIndexSize || !cellIndexSize || rowIndexSize > remaining || cellIndexSize > remaining - rowIndexSize ||
+      fields[5] != remaining - rowIndexSize - cellIndexSize)
+  {
+    Invalid("section sizes don't match file size");
+  }
+  numColsM   = static_cast<std::size_t>(fields[2]);
+  numRowsM   = static_cast<std::size_t>(fields[3]);
+  numCellsM  = static_cast<std::size_t>(fields[4]);
+  rowIndexM  = data.data() + HEADER_SIZE;
+  cellIndexM = rowIndexM + rowIndexSize;
+  blobM      = cellIndexM + cellIndexSize;
+  // check indexes run in order from start to end of what they index, so that every row and cell is in bounds
+  if (!numRowsM || RowBegin(0) || RowEnd(numRowsM - 1) != numCellsM) Invalid("bad row index");
+  if (RowEnd(0) != numColsM) Invalid("header row width doesn't match column count");
+  for (std::size_t row(0); row < numRowsM; ++row)
+  {
+    const std::size_t begin(RowBegin(row));
+    const std::size_t end(RowEnd(row));
+    if (end < begin || end - begin > numColsM) Invalid("bad row index");
+    // data rows always have at least a title cell, as loading TSV never yields an empty row
+    if (row && end == begin) Invalid("empty data row");
+  }
+  const std::size_t blobSize(static_cast<std::size_t>(fields[5]));
+  if (Read(cellIndexM, 0) || Read(cellIndexM, numCellsM) != blobSize) Invalid("bad cell index");
+  std::size_t prev(0);
+  for (std::size_t cell(1); cell <= numCellsM; ++cell)
+  {
+    const std::size_t offset(Read(cellIndexM, cell));
+    if (offset < prev) Invalid("bad cell index");
+    prev = offset;
+  }
+}
+
+bool SnapshotS::Detect(const std::string_view data)
+{
+  return data.substr(0, MAGIC.length()) == MAGIC;
+}
+
+bool SnapshotS::DetectFile(const std::string& filename)
+{
+  std::ifstream inFile(filename, std::ios::binary);
+  char start[8];
+  if (!inFile.read(start, sizeof(start))) return false;
+  return Detect(std::string_view(start, sizeof(start)));
+}
+
+void SnapshotS::WriteHeader(const std::size_t numCols, const std::size_t numRows, const std::size_t numCells,
+                            const std::size_t blobSize, OutputS& out)
+{
+  out.Write(MAGIC);
+  WriteValue(VERSION, out);
+  WriteValue(BYTE_ORDER_MARK, out);
+  WriteValue(numCols, out);
+  WriteValue(numRows, out);
+  WriteValue(numCells, out);
+  WriteValue(blobSize, out);
+}
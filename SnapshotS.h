@@ -0,0 +1,123 @@
+#ifndef SNAPSHOTS_H
+#define SNAPSHOTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "OutputS.h"
+
+// binary snapshot of a table, which can be loaded by memory-mapping it and checking its indexes, with no tokenizing
+// layout, all integers being 64-bit and in the byte order of the machine that wrote it:
+// - header: magic "WTSVSNAP", format version, byte order mark, column count, row count (including the header row),
+//    cell count, blob size
+// - row index: row count + 1 offsets into the cell index; row r is cells [row[r], row[r + 1])
+// - cell index: cell count + 1 offsets into the blob; cell c is bytes [cell[c], cell[c + 1])
+// - blob: the values of all cells, back to back
+// row 0 is the table header, which is as wide as the table; data rows have at least one cell, and may be shorter,
+//  in which case their missing trailing cells read as empty
+struct SnapshotS
+{
+  typedef std::string_view CellT;
+
+  // current (and only readable) format version
+  static const std::uint64_t VERSION = 1;
+
+  // view and validate snapshot data, which must stay valid and unchanged for the lifetime of the instance
+  // throws std::runtime_error if data isn't a well-formed snapshot of this version and byte order
+  explicit SnapshotS(std::string_view data);
+
+  // true if data starts like a snapshot (whether or not it's a valid one)
+  static bool Detect(std::string_view data);
+
+  // true if the named file starts like a snapshot; false if it doesn't, or can't be read
+  static bool DetectFile(const std::string& filename);
+
+  std::size_t NumCols() const { return numColsM; }
+  // number of rows, including the header row
+  std::size_t NumRows() const { return numRowsM; }
+  std::size_t NumCells() const { return numCellsM; }
+
+  // cell numbers of the first cell of a row, and of the first cell past its end
+  std::size_t RowBegin(const std::size_t row) const { return Read(rowIndexM, row); }
+  std::size_t RowEnd(const std::size_t row) const { return Read(rowIndexM, row + 1); }
+
+  // value of a cell, by cell number
+  CellT Cell(const std::size_t cell) const
+  {
+    const std::size_t begin(Read(cellIndexM, cell));
+    return CellT(blobM + begin, Read(cellIndexM, cell + 1) - begin);
+  }
+
+  // write a snapshot of a table of numRows rows (including the header row) and numCols columns to out
+  // rowSize(row) gives the number of cells in a row, and cell(row, col) the value of one of them
+  template <typename RowSizeFuncT, typename CellFuncT>
+  static void Write(std::size_t numCols, std::size_t numRows, RowSizeFuncT rowSize, CellFuncT cell, OutputS& out);
+
+private:
+  static std::size_t Read(const char* const index, const std::size_t pos)
+  {
+    std::uint64_t value;
+    std::memcpy(&value, index + pos * sizeof(value), sizeof(value));
+    return static_cast<std::size_t>(value);
+  }
+
+  static void WriteValue(const std::uint64_t value, OutputS& out)
+  {
+    out.Write(std::string_view(reinterpret_cast<const char*>(&value), sizeof(value)));
+  }
+
+  // write the fixed-size header
+  static void WriteHeader(std::size_t numCols, std::size_t numRows, std::size_t numCells, std::size_t blobSize,
+                          OutputS& out);
+
+  std::size_t numColsM;
+  std::size_t numRowsM;
+  std::size_t numCellsM;
+  const char* rowIndexM;
+  const char* cellIndexM;
+  const char* blobM;
+};
+
+template <typename RowSizeFuncT, typename CellFuncT>
+void SnapshotS::Write(const std::size_t numCols, const std::size_t numRows, RowSizeFuncT rowSize, CellFuncT cell,
+                      OutputS& out)
+{
+  // count cells and blob bytes first, as the header needs them
+  std::size_t numCells(0);
+  std::size_t blobSize(0);
+  for (std::size_t row(0); row < numRows; ++row)
+  {
+    const std::size_t size(rowSize(row));
+    numCells += size;
+    for (std::size_t col(0); col < size; ++col) blobSize += cell(row, col).length();
+  }
+  WriteHeader(numCols, numRows, numCells, blobSize, out);
+  std::size_t offset(0);
+  for (std::size_t row(0); row < numRows; ++row)
+  {
+    WriteValue(offset, out);
+    offset += rowSize(row);
+  }
+  WriteValue(offset, out);
+  offset = 0;
+  for (std::size_t row(0); row < numRows; ++row)
+  {
+    const std::size_t size(rowSize(row));
+    for (std::size_t col(0); col < size; ++col)
+    {
+      WriteValue(offset, out);
+      offset += cell(row, col).length();
+    }
+  }
+  WriteValue(offset, out);
+  for (std::size_t row(0); row < numRows; ++row)
+  {
+    const std::size_t size(rowSize(row));
+    for (std::size_t col(0); col < size; ++col) out.Write(cell(row, col));
+  }
+}
+
+#endif
@@ -0,0 +1,213 @@
+#include "SortIndexS.h"
+
+#include "OutputS.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+  const std::string_view MAGIC("WTSVSKIX", 8);
+  const std::uint64_t VERSION(1);
+  // written as a native integer, so that it reads back differently in the other byte order
+  const std::uint64_t BYTE_ORDER_MARK(0x0102030405060708);
+  // version of the keys made by TitleKeyS; bump whenever it changes how keys are derived, so that older indexes are
+  //  discarded rather than trusted
+  const std::uint64_t KEY_VERSION(2);
+  // magic, then version, byte order mark, key version, entry count, rank count, key blob size and checksum
+  const std::size_t HEADER_SIZE(8 + 7 * 8);
+
+  const std::uint64_t FNV_OFFSET(0xcbf29ce484222325);
+  const std::uint64_t FNV_PRIME(0x100000001b3);
+
+  // FNV-1a style hash of data, taken 8 bytes at a time (then a byte at a time for any remainder), for checksums
+  std::uint64_t Checksum(const std::string_view data)
+  {
+    std::uint64_t hash(FNV_OFFSET);
+    std::size_t pos(0);
+    for (; pos + 8 <= data.length(); pos += 8)
+    {
+      std::uint64_t word;
+      std::memcpy(&word, data.data() + pos, sizeof(word));
+      hash = (hash ^ word) * FNV_PRIME;
+    }
+    for (; pos < data.length(); ++pos) hash = (hash ^ static_cast<unsigned char>(data[pos])) * FNV_PRIME;
+    return hash;
+  }
+
+  // key version field of an index of keys folded according to fold, so that an index is only used with keys folded
+  //  the same way
+  std::uint64_t KeyVersion(const TitleKeyS::FoldE fold)
+  {
+    return KEY_VERSION * TitleKeyS::FO_COUNT + fold;
+  }
+
+  void AppendValue(const std::uint64_t value, std::string& out)
+  {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+}
+
+SortIndexS::SortIndexS()
+  : numEntriesM(0)
+  , numRanksM(0)
+  , entriesM(nullptr)
+  , offsetsM(nullptr)
+  , blobM(nullptr)
+{
+}
+
+std::uint64_t SortIndexS::Hash(const CellT title)
+{
+  std::uint64_t hash(FNV_OFFSET);
+  for (const char c : title) hash = (hash ^ static_cast<unsigned char>(c)) * FNV_PRIME;
+  return hash;
+}
+
+void SortIndexS::SortByHash(std::vector<EntryS>& entries)
+{
+  // least significant digit first radix sort on the top 32 bits of the hash, 16 bits at a time; hashes are evenly
+  //  spread, so entries that agree on those are rare, and an insertion sort then finishes the job in a single pass
+  std::vector<EntryS> buffer(entries.size());
+  std::vector<std::size_t> counts(1 << 16);
+  for (unsigned shift(32); shift < 64; shift += 16)
+  {
+    counts.assign(counts.size(), 0);
+    for (const EntryS& entry : entries) ++counts[(entry.hashM >> shift) & 0xffff];
+    std::size_t start(0);
+    for (std::size_t& count : counts)
+    {
+      const std::size_t next(start + count);
+      count = start;
+      start = next;
+    }
+    for (const EntryS& entry : entries) buffer[counts[(entry.hashM >> shift) & 0xffff]++] = entry;
+    entries.swap(buffer);
+  }
+  for (std::size_t pos(1); pos < entries.size(); ++pos)
+  {
+    const EntryS entry(entries[pos]);
+    std::size_t dest(pos);
+    for (; dest && entries[dest - 1].hashM > entry.hashM; --dest) entries[dest] = entries[dest - 1];
+    entries[dest] = entry;
+  }
+}
+
+void SortIndexS::Clear()
+{
+  fileM.Close();
+  numEntriesM = 0;
+  numRanksM = 0;
+  entriesM = nullptr;
+  offsetsM = nullptr;
+  blobM = nullptr;
+}
+
+bool SortIndexS::Load(const std::string& filename, const TitleKeyS::FoldE fold)
+{
+  Clear();
+  try
+  {
+    fileM.Open(filename);
+  }
+  catch (const std::runtime_error&)
+  {
+    return false;
+  }
+  const std::string_view data(fileM.View());
+  // check header, section sizes and checksum
+  std::uint64_t fields[7] = {};
+  bool valid(data.length() >= HEADER_SIZE && data.substr(0, MAGIC.length()) == MAGIC);
+  if (valid) std::memcpy(fields, data.data() + MAGIC.length(), sizeof(fields));
+  valid = valid && fields[0] == VERSION && fields[1] == BYTE_ORDER_MARK && fields[2] == KeyVersion(fold);
+  const std::uint64_t numEntries(fields[3]);
+  const std::uint64_t numRanks(fields[4]);
+  const std::uint64_t blobSize(fields[5]);
+  std::uint64_t remaining(valid ? data.length() - HEADER_SIZE : 0);
+  valid = valid && numEntries <= remaining / sizeof(EntryS);
+  remaining -= valid ? numEntries * sizeof(EntryS) : 0;
+  valid = valid && numRanks < remaining / 8 && blobSize == remaining - (numRanks + 1) * 8;
+  valid = valid && Checksum(data.substr(HEADER_SIZE)) == fields[6];
+  if (!valid)
+  {
+    Clear();
+    return false;
+  }
+  numEntriesM = static_cast<std::size_t>(numEntries);
+  numRanksM = static_cast<std::size_t>(numRanks);
+  entriesM = data.data() + HEADER_SIZE;
+  offsetsM = entriesM + numEntriesM * sizeof(EntryS);
+  blobM = offsetsM + (numRanksM + 1) * 8;
+  // check entries are in hash order with valid ranks, and keys in bounds and in order
+  for (std::size_t entry(0); valid && entry < numEntriesM; ++entry)
+  {
+    const EntryS current(Entry(entry));
+    valid = current.valueM < numRanks && (!entry || Entry(entry - 1).hashM < current.hashM);
+  }
+  std::uint64_t offset(0);
+  std::memcpy(&offset, offsetsM, sizeof(offset));
+  valid = valid && !offset;
+  for (std::size_t rank(0); valid && rank < numRanksM; ++rank)
+  {
+    std::uint64_t next;
+    std::memcpy(&next, offsetsM + (rank + 1) * 8, sizeof(next));
+    valid = next >= offset && next <= blobSize && (!rank || RankKey(rank - 1) < RankKey(rank));
+    offset = next;
+  }
+  if (!valid || offset != blobSize)
+  {
+    Clear();
+    return false;
+  }
+  return true;
+}
+
+void SortIndexS::Save(const std::string& filename, const TitleKeyS::FoldE fold, const std::vector<EntryS>& entries,
+                      const std::vector<CellT>& keys)
+{
+  // everything after the header is built in memory first, as the header holds its checksum
+  std::string body;
+  std::size_t blobSize(0);
+  for (const CellT key : keys) blobSize += key.length();
+  body.reserve(entries.size() * sizeof(EntryS) + (keys.size() + 1) * 8 + blobSize);
+  for (const EntryS& entry : entries)
+  {
+    AppendValue(entry.hashM, body);
+    AppendValue(entry.valueM, body);
+  }
+  std::uint64_t offset(0);
+  AppendValue(offset, body);
+  for (const CellT key : keys) AppendValue(offset += key.length(), body);
+  for (const CellT key : keys) body.append(key);
+  std::string header(MAGIC);
+  AppendValue(VERSION, header);
+  AppendValue(BYTE_ORDER_MARK, header);
+  AppendValue(KeyVersion(fold), header);
+  AppendValue(entries.size(), header);
+  AppendValue(keys.size(), header);
+  AppendValue(blobSize, header);
+  AppendValue(Checksum(body), header);
+  const std::string tempFilename(filename + ".tmp");
+  std::ofstream stream(tempFilename, std::ios::binary | std::ios::trunc);
+  if (!stream.is_open())
+  {
+    throw std::runtime_error("Failed to open sort index file: '" + tempFilename + "' for write");
+  }
+  try
+  {
+    OutputS out(stream);
+    out << header << body;
+    out.Flush();
+    stream.close();
+    if (!stream || std::rename(tempFilename.c_str(), filename.c_str()))
+    {
+      throw std::runtime_error("Failed to write sort index file: '" + filename + "'");
+    }
+  }
+  catch (const std::runtime_error&)
+  {
+    std::remove(tempFilename.c_str());
+    throw;
+  }
+}
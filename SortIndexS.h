@@ -0,0 +1,88 @@
+#ifndef SORTINDEXS_H
+#define SORTINDEXS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFileS.h"
+#include "TitleKeyS.h"
+
+// persisted title sort keys of a table, kept alongside it between sorts, so that re-sorting an edited copy of the
+//  table only has to derive keys for titles that have changed, and can place all other rows by rank, without
+//  comparing keys
+// holds the distinct keys in order (each key's position being its rank), and the hash and key rank of each distinct
+//  (cleaned) title, in hash order, so that a table's titles can be matched against it by a sequential merge
+// file layout, all integers being 64-bit and in the byte order of the machine that wrote it: magic "WTSVSKIX", format
+//  version, byte order mark, key version, entry count, rank count, key blob size, checksum of the rest of the file;
+//  then each entry's title hash and rank; then rank count + 1 offsets into the key blob; then the key blob
+struct SortIndexS
+{
+  typedef std::string_view CellT;
+
+  // a title hash, and a number that goes with it: a rank in index entries, or a row number when matching rows
+  struct EntryS
+  {
+    std::uint64_t hashM;
+    std::uint64_t valueM;
+  };
+
+  // construct an empty index
+  SortIndexS();
+
+  // hash of a title, as stored in an index
+  static std::uint64_t Hash(CellT title);
+
+  // sort entries by hash, in linear time
+  // entries with equal hashes are left in no particular order
+  static void SortByHash(std::vector<EntryS>& entries);
+
+  // release contents, leaving the index empty
+  void Clear();
+
+  // clear index, then load it from the given file, for keys folded according to fold
+  // returns false, leaving the index empty, if the file doesn't exist, is corrupt, or was written by a different
+  //  format or key version, or for keys folded differently
+  bool Load(const std::string& filename, TitleKeyS::FoldE fold);
+
+  std::size_t NumEntries() const { return numEntriesM; }
+  std::size_t NumRanks() const { return numRanksM; }
+
+  // entry by number, in hash order
+  EntryS Entry(const std::size_t entry) const
+  {
+    EntryS result;
+    std::memcpy(&result, entriesM + entry * sizeof(EntryS), sizeof(EntryS));
+    return result;
+  }
+
+  // key of a rank
+  CellT RankKey(const std::size_t rank) const
+  {
+    std::uint64_t offsets[2];
+    std::memcpy(offsets, offsetsM + rank * sizeof(std::uint64_t), sizeof(offsets));
+    return CellT(blobM + offsets[0], static_cast<std::size_t>(offsets[1] - offsets[0]));
+  }
+
+  // write an index of the given entries, which must be in hash order with no hash repeated, and rank keys, which
+  //  must be in order with no key repeated, and folded according to fold
+  // the file is written under a temporary name and then renamed over filename, so that an interrupted write never
+  //  leaves a truncated index behind
+  // throws std::runtime_error on write failure
+  static void Save(const std::string& filename, TitleKeyS::FoldE fold, const std::vector<EntryS>& entries,
+                   const std::vector<CellT>& keys);
+
+private:
+  // loaded file, which all of the below point into
+  MappedFileS fileM;
+  std::size_t numEntriesM;
+  std::size_t numRanksM;
+  const char* entriesM;
+  const char* offsetsM;
+  const char* blobM;
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "StatsS.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <ostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STATSS_POSIX 1
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  // process-wide allocation counters, maintained by the operator new replacements below once counting is enabled
+  std::atomic<bool>          countAllocs(false);
+  std::atomic<std::uint64_t> allocCount(0);
+  std::atomic<std::uint64_t> allocBytes(0);
+
+  void* Allocate(const std::size_t size)
+  {
+    if (countAllocs.load(std::memory_order_relaxed))
+    {
+      allocCount.fetch_add(1, std::memory_order_relaxed);
+      allocBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    for (;;)
+    {
+      void* const p(std::malloc(size ? size : 1));
+      if (p) return p;
+      const std::new_handler handler(std::get_new_handler());
+      if (!handler) throw std::bad_alloc();
+      handler();
+    }
+  }
+
+  void* AllocateNoThrow(const std::size_t size) noexcept
+  {
+    try
+    {
+      return Allocate(size);
+    }
+    catch (const std::bad_alloc&)
+    {
+      return nullptr;
+    }
+  }
+
+  const char* const PHASE_NAMES[StatsS::PH_COUNT] = { "read", "tokenize", "normalize", "clean", "sort", "emit" };
+}
+
+// replacements for the global allocation functions, so that all heap allocations can be counted
+// (over-aligned allocations keep the library's own implementations, and aren't counted)
+void* operator new(const std::size_t size)                                { return Allocate(size); }
+void* operator new[](const std::size_t size)                              { return Allocate(size); }
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept   { return AllocateNoThrow(size); }
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept { return AllocateNoThrow(size); }
+void operator delete(void* p) noexcept                                    { std::free(p); }
+void operator delete[](void* p) noexcept                                  { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept                       { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept                     { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept             { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept           { std::free(p); }
+
+StatsS::TimerS::TimerS(StatsS* const stats, const PhaseE phase)
+  : statsM(stats)
+  , phaseM(phase)
+  , outerM(nullptr)
+{
+  if (!statsM) return;
+  statsM->Charge();
+  outerM = statsM->currentM;
+  statsM->currentM = this;
+}
+
+StatsS::TimerS::~TimerS()
+{
+  if (!statsM) return;
+  statsM->Charge();
+  statsM->currentM = outerM;
+  PhaseS& phase(statsM->phasesM[phaseM]);
+  phase.peakRssKbM = std::max(phase.peakRssKbM, PeakRssKb());
+}
+
+void StatsS::TimerS::Count(const std::uint64_t bytes, const std::uint64_t rows, const std::uint64_t cells)
+{
+  if (!statsM) return;
+  PhaseS& phase(statsM->phasesM[phaseM]);
+  phase.bytesM += bytes;
+  phase.rowsM += rows;
+  phase.cellsM += cells;
+}
+
+StatsS::StatsS()
+  : phasesM()
+  , currentM(nullptr)
+  , markTimeM(std::chrono::steady_clock::now())
+  , markAllocsM(0)
+  , markAllocBytesM(0)
+{
+  countAllocs.store(true, std::memory_order_relaxed);
+}
+
+const char* StatsS::Name(const PhaseE phase)
+{
+  return phase < PH_COUNT ? PHASE_NAMES[phase] : "unknown";
+}
+
+long StatsS::PeakRssKb()
+{
+#ifdef STATSS_POSIX
+  struct rusage usage;
+  if (::getrusage(RUSAGE_SELF, &usage)) return 0;
+#ifdef __APPLE__
+  // reported in bytes rather than KiB
+  return static_cast<long>(usage.ru_maxrss / 1024);
+#else
+  return static_cast<long>(usage.ru_maxrss);
+#endif
+#else
+  return 0;
+#endif
+}
+
+long StatsS::CurrentRssKb()
+{
+#ifdef __linux__
+  // second field is resident pages
+  std::ifstream statm("/proc/self/statm");
+  long pages(0);
+  long residentPages(0);
+  if (!(statm >> pages >> residentPages)) return 0;
+  return residentPages * (::sysconf(_SC_PAGESIZE) / 1024);
+#else
+  return 0;
+#endif
+}
+
+void StatsS::Charge()
+{
+  const std::chrono::steady_clock::time_point now(std::chrono::steady_clock::now());
+  const std::uint64_t allocs(allocCount.load(std::memory_order_relaxed));
+  const std::uint64_t bytes(allocBytes.load(std::memory_order_relaxed));
+  if (currentM)
+  {
+    PhaseS& phase(phasesM[currentM->phaseM]);
+    phase.secondsM += std::chrono::duration<double>(now - markTimeM).count();
+    phase.allocsM += allocs - markAllocsM;
+    phase.allocBytesM += bytes - markAllocBytesM;
+  }
+  markTimeM = now;
+  markAllocsM = allocs;
+  markAllocBytesM = bytes;
+}
+
+void StatsS::Print(std::ostream& out, const bool json) const
+{
+  PhaseS total = PhaseS();
+  for (const PhaseS& phase : phasesM)
+  {
+    total.secondsM += phase.secondsM;
+    total.allocsM += phase.allocsM;
+    total.allocBytesM += phase.allocBytesM;
+    total.peakRssKbM = std::max(total.peakRssKbM, phase.peakRssKbM);
+  }
+  total.peakRssKbM = std::max(total.peakRssKbM, PeakRssKb());
+  char line[512];
+  if (json)
+  {
+    out << "{\"phases\":[";
+    for (unsigned phaseNum(0); phaseNum < PH_COUNT; ++phaseNum)
+    {
+      const PhaseS& phase(phasesM[phaseNum]);
+      std::snprintf(line, sizeof(line),
+        "%s{\"phase\":\"%s\",\"seconds\":%.6f,\"bytes\":%llu,\"rows\":%llu,\"cells\":%llu,\"allocs\":%llu,"
+        "\"alloc_bytes\":%llu,\"peak_rss_kb\":%ld}",
+        phaseNum ? "," : "", Name(static_cast<PhaseE>(phaseNum)), phase.secondsM,
+        static_cast<unsigned long long>(phase.bytesM), static_cast<unsigned long long>(phase.rowsM),
+        static_cast<unsigned long long>(phase.cellsM), static_cast<unsigned long long>(phase.allocsM),
+        static_cast<unsigned long long>(phase.allocBytesM), phase.peakRssKbM);
+      out << line;
+    }
+    std::snprintf(line, sizeof(line), "],\"total\":{\"seconds\":%.6f,\"allocs\":%llu,\"alloc_bytes\":%llu,"
+      "\"peak_rss_kb\":%ld}}\n",
+      total.secondsM, static_cast<unsigned long long>(total.allocsM),
+      static_cast<unsigned long long>(total.allocBytesM), total.peakRssKbM);
+    out << line;
+    return;
+  }
+  out << "phase          seconds           bytes        rows       cells      allocs   alloc MiB  peak RSS MiB\n";
+  for (unsigned phaseNum(0); phaseNum < PH_COUNT; ++phaseNum)
+  {
+    const PhaseS& phase(phasesM[phaseNum]);
+    std::snprintf(line, sizeof(line), "%-10s %11.6f %15llu %11llu %11llu %11llu %11.1f %13.1f\n",
+      Name(static_cast<PhaseE>(phaseNum)), phase.secondsM,
+      static_cast<unsigned long long>(phase.bytesM), static_cast<unsigned long long>(phase.rowsM),
+      static_cast<unsigned long long>(phase.cellsM), static_cast<unsigned long long>(phase.allocsM),
+      phase.allocBytesM / 1048576.0, phase.peakRssKbM / 1024.0);
+    out << line;
+  }
+  std::snprintf(line, sizeof(line), "%-10s %11.6f %15s %11s %11s %11llu %11.1f %13.1f\n",
+    "total", total.secondsM, "", "", "", static_cast<unsigned long long>(total.allocsM),
+    total.allocBytesM / 1048576.0, total.peakRssKbM / 1024.0);
+  out << line;
+}
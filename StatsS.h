@@ -0,0 +1,96 @@
+#ifndef STATSS_H
+#define STATSS_H
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+// per-phase runtime statistics, as reported by the tools' --stats option
+// each phase records wall time, heap allocations (by all threads) and the process peak RSS at its end, plus counters
+//  filled in by the code being timed:
+// - bytes: input bytes read/tokenized, or output bytes written
+// - rows:  rows processed
+// - cells: cells produced (tokenize), added (normalize), rewritten (clean) or written (emit)
+// phases are timed by TimerS objects on the thread driving the table operations; worker threads only contribute to
+//  the allocation counts
+struct StatsS
+{
+  enum PhaseE
+  {
+    PH_READ,
+    PH_TOKENIZE,
+    PH_NORMALIZE,
+    PH_CLEAN,
+    PH_SORT,
+    PH_EMIT,
+    PH_COUNT
+  };
+
+  struct PhaseS
+  {
+    double        secondsM;
+    std::uint64_t bytesM;
+    std::uint64_t rowsM;
+    std::uint64_t cellsM;
+    std::uint64_t allocsM;
+    std::uint64_t allocBytesM;
+    long          peakRssKbM;
+  };
+
+  // charges wall time and allocations to a phase for its lifetime
+  // a timer created while another is active pauses it, so that each phase's figures exclude any other phases it
+  //  calls into; timers must therefore be destroyed in reverse order of creation
+  // a null stats pointer makes the timer (and Count()) a no-op
+  struct TimerS
+  {
+    TimerS(StatsS* stats, PhaseE phase);
+    ~TimerS();
+
+    TimerS(const TimerS&) = delete;
+    TimerS& operator=(const TimerS&) = delete;
+
+    // add to the phase's counters
+    void Count(std::uint64_t bytes, std::uint64_t rows, std::uint64_t cells);
+
+  private:
+    friend struct StatsS;
+
+    StatsS* statsM;
+    PhaseE  phaseM;
+    // timer paused by this one, if any
+    TimerS* outerM;
+  };
+
+  PhaseS phasesM[PH_COUNT];
+
+  // construct with all phases zeroed
+  // also turns on process-wide allocation counting, which is otherwise off to keep allocation cheap
+  StatsS();
+
+  StatsS(const StatsS&) = delete;
+  StatsS& operator=(const StatsS&) = delete;
+
+  // printable phase name
+  static const char* Name(PhaseE phase);
+
+  // peak resident set size of this process so far in KiB, or 0 if unknown on this platform
+  static long PeakRssKb();
+
+  // current resident set size of this process in KiB, or 0 if unknown on this platform
+  static long CurrentRssKb();
+
+  // print all phases plus totals, as an aligned human-readable table, or as a single-line JSON object
+  void Print(std::ostream& out, bool json) const;
+
+private:
+  // charge time and allocations since the last mark to the active timer's phase, and move the mark to now
+  void Charge();
+
+  // innermost active timer
+  TimerS*                               currentM;
+  std::chrono::steady_clock::time_point markTimeM;
+  std::uint64_t                         markAllocsM;
+  std::uint64_t                         markAllocBytesM;
+};
+
+#endif
@@ -0,0 +1,539 @@
+#include "TableDiffS.h"
+
+#include "OutputS.h"
+#include "ParallelS.h"
+#include "SortIndexS.h"
+#include "StatsS.h"
+#include "TableS.h"
+#include "TitleKeyS.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <utility>
+
+namespace
+{
+  // minimum rows per row hashing worker thread
+  const std::size_t MIN_HASH_ROWS(1 << 15);
+
+  const std::uint64_t MIX(0x9e3779b97f4a7c15);
+  const std::uint64_t MIX_WORD(0xff51afd7ed558ccd);
+
+  inline std::uint64_t RotL(const std::uint64_t value, const unsigned bits)
+  {
+    return (value << bits) | (value >> (64 - bits));
+  }
+
+  // hash of data, taken 8 bytes at a time (row and key hashes never leave the process, so unlike SortIndexS::Hash()
+  //  this is free to favour speed over a fixed definition)
+  std::uint64_t HashBytes(const TableS::CellT data)
+  {
+    std::uint64_t hash(data.length() * MIX);
+    std::size_t pos(0);
+    for (; pos + 8 <= data.length(); pos += 8)
+    {
+      std::uint64_t word;
+      std::memcpy(&word, data.data() + pos, sizeof(word));
+      hash = RotL(hash ^ (word * MIX_WORD), 29) * MIX;
+    }
+    if (pos < data.length())
+    {
+      std::uint64_t word(0);
+      std::memcpy(&word, data.data() + pos, data.length() - pos);
+      hash = RotL(hash ^ (word * MIX_WORD), 29) * MIX;
+    }
+    return hash ^ (hash >> 32);
+  }
+
+  // hash of a row's cells, ignoring any trailing empty ones, so that a row hashes the same however far it's padded
+  std::uint64_t RowHash(const TableS::ColListT& row)
+  {
+    std::size_t end(row.size());
+    while (end && row[end - 1].empty()) --end;
+    std::uint64_t hash(0);
+    for (std::size_t col(0); col < end; ++col)
+    {
+      hash = RotL(hash ^ HashBytes(row[col]), 27) * MIX;
+    }
+    return hash;
+  }
+
+  // hash the title sort key and the cells of each data row of table, using the given number of threads
+  // leaves the key hashes (with row numbers) in keys, in hash order, with rows of the same hash in row order
+  void HashRows(const TableS& table, const std::size_t threads, std::vector<SortIndexS::EntryS>& keys,
+                std::vector<std::uint64_t>& rowHashes)
+  {
+    const TableS::RowListT& rows(table.dataM);
+    keys.resize(rows.size());
+    rowHashes.resize(rows.size());
+    ParallelS::Run(threads, [threads, &rows, &keys, &rowHashes](const std::size_t part)
+    {
+      const std::size_t rowStart(rows.size() * part / threads);
+      const std::size_t rowEnd(rows.size() * (part + 1) / threads);
+      std::string key;
+      for (std::size_t rowNum(rowStart); rowNum < rowEnd; ++rowNum)
+      {
+        key.clear();
+        TitleKeyS::Append(TableS::Cell(rows[rowNum], 0), key);
+        keys[rowNum].hashM = HashBytes(key);
+        keys[rowNum].valueM = rowNum;
+        rowHashes[rowNum] = RowHash(rows[rowNum]);
+      }
+    });
+    SortIndexS::SortByHash(keys);
+    // runs of equal hashes are short (bar many rows with the same title), so sorting each one is cheap
+    for (std::size_t start(0), end(0); start < keys.size(); start = end)
+    {
+      for (end = start + 1; end < keys.size() && keys[end].hashM == keys[start].hashM; ++end) {}
+      if (end - start > 1)
+      {
+        std::sort(keys.begin() + start, keys.begin() + end,
+                  [](const SortIndexS::EntryS& a, const SortIndexS::EntryS& b) { return a.valueM < b.valueM; });
+      }
+    }
+  }
+
+  // number of lines in text
+  std::size_t CountLines(const TableS::CellT text)
+  {
+    return static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+  }
+
+  // lines of unchanged text around each change in a hunk, as diff -u gives
+  const std::size_t CONTEXT_LINES(3);
+
+  // unified diff writer, which gathers edits to nearby old lines into hunks with context lines around them, so that
+  //  patch can find each hunk even where the text it's applied to has more or fewer lines before it
+  struct PatchS
+  {
+    // function that sets text to the given old line (numbered from 1, and ending in a newline)
+    typedef std::function<void(std::size_t, std::string&)> OldLineFuncT;
+
+    OutputS&       outM;
+    std::size_t    numOldLinesM;
+    OldLineFuncT   oldLineFuncM;
+    // pending hunk: it starts at old line startM, spans oldCountM old and newCountM new lines, and has bodyM written
+    //  so far; old lines from nextOldM on aren't in it yet
+    std::size_t    startM;
+    std::size_t    oldCountM;
+    std::size_t    newCountM;
+    std::size_t    nextOldM;
+    std::string    bodyM;
+    // lines of the change in progress, which go into the body once a context line (or the hunk's end) follows
+    std::string    removedLinesM;
+    std::string    addedLinesM;
+    // difference between new and old line numbers after the hunks written so far
+    std::ptrdiff_t offsetM;
+    std::string    lineM;
+
+    // write a patch to out for old text of numOldLines lines, whose lines can be had from oldLineFunc
+    PatchS(OutputS& out, const std::size_t numOldLines, OldLineFuncT oldLineFunc)
+      : outM(out)
+      , numOldLinesM(numOldLines)
+      , oldLineFuncM(std::move(oldLineFunc))
+      , startM(0)
+      , oldCountM(0)
+      , newCountM(0)
+      , nextOldM(0)
+      , offsetM(0)
+    {
+    }
+
+    // replace the old lines from oldLine (numbered from 1) on with the given ones (each ending in a newline)
+    // edits must come in order of old lines, without overlapping
+    void Edit(const std::size_t oldLine, const TableS::CellT removedLines, const TableS::CellT addedLines)
+    {
+      // a gap too wide to be covered by the context lines of both changes ends the hunk
+      if (oldCountM || newCountM)
+      {
+        if (oldLine > nextOldM + 2 * CONTEXT_LINES) Flush();
+        else                                         AppendContext(oldLine);
+      }
+      if (!oldCountM && !newCountM)
+      {
+        startM = nextOldM = (oldLine > CONTEXT_LINES ? oldLine - CONTEXT_LINES : 1);
+        AppendContext(oldLine);
+      }
+      const std::size_t removed(AppendLines('-', removedLines, removedLinesM));
+      oldCountM += removed;
+      newCountM += AppendLines('+', addedLines, addedLinesM);
+      nextOldM = oldLine + removed;
+    }
+
+    // Edit() only the lines that differ, if oldText and newText have as many; otherwise replace all of them
+    void EditLines(const std::size_t oldLine, const TableS::CellT oldText, const TableS::CellT newText)
+    {
+      if (oldText == newText) return;
+      if (CountLines(oldText) != CountLines(newText))
+      {
+        Edit(oldLine, oldText, newText);
+        return;
+      }
+      for (std::size_t lineNum(0), oldPos(0), newPos(0); oldPos < oldText.length(); ++lineNum)
+      {
+        const std::size_t oldEnd(oldText.find('\n', oldPos) + 1);
+        const std::size_t newEnd(newText.find('\n', newPos) + 1);
+        const TableS::CellT oldLineText(oldText.substr(oldPos, oldEnd - oldPos));
+        const TableS::CellT newLineText(newText.substr(newPos, newEnd - newPos));
+        if (oldLineText != newLineText) Edit(oldLine + lineNum, oldLineText, newLineText);
+        oldPos = oldEnd;
+        newPos = newEnd;
+      }
+    }
+
+    // write out the pending hunk, if any, with the context lines after its last change
+    void Flush()
+    {
+      if (!oldCountM && !newCountM) return;
+      AppendContext(std::min(nextOldM + CONTEXT_LINES, numOldLinesM + 1));
+      EndChange();
+      // an empty side of a hunk is numbered by the line before it
+      const std::size_t newStart(static_cast<std::size_t>(static_cast<std::ptrdiff_t>(startM) + offsetM));
+      outM << "@@ -" << std::to_string(oldCountM ? startM : startM - 1) << ',' << std::to_string(oldCountM)
+           << " +" << std::to_string(newCountM ? newStart : newStart - 1) << ',' << std::to_string(newCountM)
+           << " @@\n";
+      outM << bodyM;
+      offsetM += static_cast<std::ptrdiff_t>(newCountM) - static_cast<std::ptrdiff_t>(oldCountM);
+      oldCountM = newCountM = 0;
+      bodyM.clear();
+    }
+
+  private:
+    // move the lines of the change in progress into the hunk, removed ones first, as diff -u orders them
+    void EndChange()
+    {
+      bodyM += removedLinesM;
+      bodyM += addedLinesM;
+      removedLinesM.clear();
+      addedLinesM.clear();
+    }
+
+    // add old lines up to (but not including) oldEnd to the hunk as context, ending any change in progress first
+    void AppendContext(const std::size_t oldEnd)
+    {
+      if (nextOldM < oldEnd) EndChange();
+      for (; nextOldM < oldEnd; ++nextOldM)
+      {
+        oldLineFuncM(nextOldM, lineM);
+        bodyM += ' ';
+        bodyM += lineM;
+        ++oldCountM;
+        ++newCountM;
+      }
+    }
+
+    // append each line of text to out, prefixed with prefix; returns the number of lines
+    static std::size_t AppendLines(const char prefix, const TableS::CellT text, std::string& out)
+    {
+      std::size_t lines(0);
+      for (std::size_t pos(0); pos < text.length(); ++lines)
+      {
+        const std::size_t end(text.find('\n', pos) + 1);
+        out += prefix;
+        out.append(text.substr(pos, end - pos));
+        pos = end;
+      }
+      return lines;
+    }
+  };
+
+  // print a record of PrintList()
+  void PrintRecord(const char* const change, const std::size_t oldRow, const std::size_t newRow,
+                   const std::size_t col, const TableS::CellT oldValue, const TableS::CellT newValue, OutputS& out)
+  {
+    out << change << '\t';
+    if (oldRow != TableDiffS::NO_ROW) out << std::to_string(oldRow + 1);
+    out << '\t';
+    if (newRow != TableDiffS::NO_ROW) out << std::to_string(newRow + 1);
+    out << '\t' << std::to_string(col + 1) << '\t' << oldValue << '\t' << newValue << '\n';
+  }
+}
+
+TableDiffS::TableDiffS(const TableS& oldTable, const TableS& newTable, const unsigned threads, StatsS* const stats)
+  : numInsertedM(0)
+  , numDeletedM(0)
+  , numMovedM(0)
+  , numChangedM(0)
+  , headerChangedM(oldTable.numColsM != newTable.numColsM || oldTable.headerM != newTable.headerM)
+  , oldM(oldTable)
+  , newM(newTable)
+{
+  StatsS::TimerS timer(stats, StatsS::PH_SORT);
+  const std::size_t numOld(oldM.dataM.size());
+  const std::size_t numNew(newM.dataM.size());
+  std::vector<SortIndexS::EntryS> oldKeys;
+  std::vector<SortIndexS::EntryS> newKeys;
+  HashRows(oldM, ParallelS::NumThreads(threads, numOld, MIN_HASH_ROWS), oldKeys, oldHashesM);
+  HashRows(newM, ParallelS::NumThreads(threads, numNew, MIN_HASH_ROWS), newKeys, newHashesM);
+  // match rows by merging the key hash lists; the nth old row of a key goes with the nth new row of it
+  std::vector<std::size_t> oldMatch(numOld, NO_ROW);
+  std::vector<std::size_t> newMatch(numNew, NO_ROW);
+  for (std::size_t oldNum(0), newNum(0); oldNum < numOld && newNum < numNew;)
+  {
+    if (oldKeys[oldNum].hashM < newKeys[newNum].hashM)
+    {
+      ++oldNum;
+    }
+    else if (newKeys[newNum].hashM < oldKeys[oldNum].hashM)
+    {
+      ++newNum;
+    }
+    else
+    {
+      oldMatch[oldKeys[oldNum].valueM] = newKeys[newNum].valueM;
+      newMatch[newKeys[newNum].valueM] = oldKeys[oldNum].valueM;
+      ++oldNum;
+      ++newNum;
+    }
+  }
+  // keep the longest run of matched rows whose new positions increase in old order (found by patience sorting:
+  //  tails[n] is the old row ending the best run of length n + 1 found so far); rows mostly stay in order, so the
+  //  run nearly always just grows at its end, without searching
+  std::vector<std::size_t> tails;
+  std::vector<std::size_t> prev(numOld, NO_ROW);
+  for (std::size_t oldRow(0); oldRow < numOld; ++oldRow)
+  {
+    const std::size_t newRow(oldMatch[oldRow]);
+    if (newRow == NO_ROW) continue;
+    std::size_t length(tails.size());
+    if (length && oldMatch[tails.back()] > newRow)
+    {
+      length = static_cast<std::size_t>(std::lower_bound(tails.begin(), tails.end(), newRow,
+        [&oldMatch](const std::size_t row, const std::size_t value) { return oldMatch[row] < value; }) -
+        tails.begin());
+    }
+    if (length) prev[oldRow] = tails[length - 1];
+    if (length == tails.size()) tails.push_back(oldRow);
+    else                        tails[length] = oldRow;
+  }
+  std::vector<bool> oldKept(numOld, false);
+  std::vector<bool> newKept(numNew, false);
+  for (std::size_t oldRow(tails.empty() ? NO_ROW : tails.back()); oldRow != NO_ROW; oldRow = prev[oldRow])
+  {
+    oldKept[oldRow] = true;
+    newKept[oldMatch[oldRow]] = true;
+  }
+  // walk both tables in step: rows that aren't kept are removed or added, and kept rows pair up in order
+  for (std::size_t oldRow(0), newRow(0); oldRow < numOld || newRow < numNew;)
+  {
+    if (oldRow < numOld && !oldKept[oldRow])
+    {
+      editsM.push_back(EditS{ED_REMOVE, oldRow, oldMatch[oldRow]});
+      if (oldMatch[oldRow] == NO_ROW) ++numDeletedM;
+      ++oldRow;
+    }
+    else if (newRow < numNew && !newKept[newRow])
+    {
+      editsM.push_back(EditS{ED_ADD, newMatch[newRow], newRow});
+      if (newMatch[newRow] == NO_ROW)
+      {
+        ++numInsertedM;
+      }
+      else
+      {
+        ++numMovedM;
+        if (oldHashesM[newMatch[newRow]] != newHashesM[newRow]) ++numChangedM;
+      }
+      ++newRow;
+    }
+    else
+    {
+      if (oldHashesM[oldRow] != newHashesM[newRow])
+      {
+        editsM.push_back(EditS{ED_UPDATE, oldRow, newRow});
+        ++numChangedM;
+      }
+      ++oldRow;
+      ++newRow;
+    }
+  }
+  timer.Count(0, numOld + numNew, editsM.size());
+}
+
+void TableDiffS::PrintList(OutputS& out) const
+{
+  const std::size_t numCols(std::max(oldM.numColsM, newM.numColsM));
+  // cell records for a matched pair of rows
+  auto printCells([this, numCols, &out](const std::size_t oldRow, const std::size_t newRow)
+  {
+    if (oldHashesM[oldRow] == newHashesM[newRow]) return;
+    const TableS::ColListT& oldCells(oldM.dataM[oldRow]);
+    const TableS::ColListT& newCells(newM.dataM[newRow]);
+    for (std::size_t col(0); col < numCols; ++col)
+    {
+      const TableS::CellT oldValue(TableS::Cell(oldCells, col));
+      const TableS::CellT newValue(TableS::Cell(newCells, col));
+      if (oldValue != newValue) PrintRecord("cell", oldRow, newRow, col, oldValue, newValue, out);
+    }
+  });
+  out << "change\told row\tnew row\tcolumn\told value\tnew value\n";
+  for (std::size_t col(0); headerChangedM && col < numCols; ++col)
+  {
+    const TableS::CellT oldValue(TableS::Cell(oldM.headerM, col));
+    const TableS::CellT newValue(TableS::Cell(newM.headerM, col));
+    if (oldValue != newValue || col >= oldM.numColsM || col >= newM.numColsM)
+    {
+      PrintRecord("header", NO_ROW, NO_ROW, col, oldValue, newValue, out);
+    }
+  }
+  for (const EditS& edit : editsM)
+  {
+    switch (edit.typeM)
+    {
+      case ED_REMOVE:
+      {
+        // moves are listed where the row ends up
+        if (edit.newRowM != NO_ROW) break;
+        PrintRecord("delete", edit.oldRowM, NO_ROW, 0, TableS::Cell(oldM.dataM[edit.oldRowM], 0), TableS::CellT(),
+                    out);
+      }
+      break;
+
+      case ED_ADD:
+      {
+        const TableS::CellT newTitle(TableS::Cell(newM.dataM[edit.newRowM], 0));
+        if (edit.oldRowM == NO_ROW)
+        {
+          PrintRecord("insert", NO_ROW, edit.newRowM, 0, TableS::CellT(), newTitle, out);
+          break;
+        }
+        PrintRecord("move", edit.oldRowM, edit.newRowM, 0, TableS::Cell(oldM.dataM[edit.oldRowM], 0), newTitle,
+                    out);
+        printCells(edit.oldRowM, edit.newRowM);
+      }
+      break;
+
+      case ED_UPDATE: printCells(edit.oldRowM, edit.newRowM); break;
+    }
+  }
+}
+
+void TableDiffS::PrintWikiPatch(const TableS::RowListT& oldRows, const std::string& oldName,
+                                const std::string& newName, OutputS& out) const
+{
+  if (Empty()) return;
+  // wiki markup of parts of either table is rendered into a reusable buffer
+  std::ostringstream renderStream;
+  OutputS render(renderStream);
+  std::string oldText;
+  std::string newText;
+  auto take([&render, &renderStream](std::string& text)
+  {
+    render.Flush();
+    text = renderStream.str();
+    renderStream.str(std::string());
+  });
+  TableS::PrintWikiStart(oldM.headerM, oldM.headerM.size(), render);
+  take(oldText);
+  const std::size_t oldHeaderLines(CountLines(oldText));
+  TableS::PrintWikiStart(newM.headerM, newM.headerM.size(), render);
+  take(newText);
+  // every row of a table renders to the same number of lines, as none is wider than the table
+  TableS::PrintWikiRow(TableS::ColListT(), oldM.numColsM, render);
+  std::string emptyRow;
+  take(emptyRow);
+  const std::size_t oldRowLines(CountLines(emptyRow));
+  TableS::PrintWikiEnd(render);
+  std::string endText;
+  take(endText);
+  const std::size_t oldBodyEnd(oldHeaderLines + oldRows.size() * oldRowLines);
+  // old lines for context, which may be anywhere in the old markup, so they're rendered one row at a time as needed
+  const std::string oldHeaderText(oldText);
+  std::string contextRow;
+  auto oldLineText([&](const std::size_t line, std::string& text)
+  {
+    TableS::CellT lines;
+    std::size_t lineNum;
+    if (line <= oldHeaderLines)
+    {
+      lines = oldHeaderText;
+      lineNum = line - 1;
+    }
+    else if (line <= oldBodyEnd)
+    {
+      const std::size_t bodyLine(line - oldHeaderLines - 1);
+      TableS::PrintWikiRow(oldRows[bodyLine / oldRowLines], oldM.numColsM, render);
+      take(contextRow);
+      lines = contextRow;
+      lineNum = bodyLine % oldRowLines;
+    }
+    else
+    {
+      lines = endText;
+      lineNum = line - oldBodyEnd - 1;
+    }
+    std::size_t pos(0);
+    for (; lineNum; --lineNum) pos = lines.find('\n', pos) + 1;
+    text.assign(lines.substr(pos, lines.find('\n', pos) + 1 - pos));
+  });
+  out << "--- " << oldName << "\n+++ " << newName << "\n";
+  PatchS patch(out, oldBodyEnd + CountLines(endText), oldLineText);
+  patch.EditLines(1, oldText, newText);
+  // when the table width changes, every row is padded differently, so kept rows must be compared too
+  const bool widthChanged(oldM.numColsM != newM.numColsM);
+  auto oldLine([oldHeaderLines, oldRowLines](const std::size_t oldRow)
+  {
+    return oldHeaderLines + oldRow * oldRowLines + 1;
+  });
+  auto renderRow([&render, &take](const TableS::ColListT& row, const std::size_t numCols, std::string& text)
+  {
+    TableS::PrintWikiRow(row, numCols, render);
+    take(text);
+  });
+  std::size_t oldRow(0);
+  std::size_t newRow(0);
+  // pass kept rows up to (but not including) old row oldEnd
+  auto keepTo([&](const std::size_t oldEnd)
+  {
+    if (!widthChanged)
+    {
+      newRow += oldEnd - oldRow;
+      oldRow = oldEnd;
+      return;
+    }
+    for (; oldRow < oldEnd; ++oldRow, ++newRow)
+    {
+      renderRow(oldRows[oldRow], oldM.numColsM, oldText);
+      renderRow(newM.dataM[newRow], newM.numColsM, newText);
+      patch.EditLines(oldLine(oldRow), oldText, newText);
+    }
+  });
+  for (const EditS& edit : editsM)
+  {
+    switch (edit.typeM)
+    {
+      case ED_REMOVE:
+      {
+        keepTo(edit.oldRowM);
+        renderRow(oldRows[oldRow], oldM.numColsM, oldText);
+        patch.Edit(oldLine(oldRow), oldText, TableS::CellT());
+        ++oldRow;
+      }
+      break;
+
+      case ED_ADD:
+      {
+        keepTo(oldRow + (edit.newRowM - newRow));
+        renderRow(newM.dataM[newRow], newM.numColsM, newText);
+        patch.Edit(oldLine(oldRow), TableS::CellT(), newText);
+        ++newRow;
+      }
+      break;
+
+      case ED_UPDATE:
+      {
+        keepTo(edit.oldRowM);
+        renderRow(oldRows[oldRow], oldM.numColsM, oldText);
+        renderRow(newM.dataM[newRow], newM.numColsM, newText);
+        patch.EditLines(oldLine(oldRow), oldText, newText);
+        ++oldRow;
+        ++newRow;
+      }
+      break;
+    }
+  }
+  keepTo(oldM.dataM.size());
+  patch.Flush();
+}
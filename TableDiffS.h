@@ -0,0 +1,92 @@
+#ifndef TABLEDIFFS_H
+#define TABLEDIFFS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "TableS.h"
+
+struct OutputS;
+struct StatsS;
+
+// row-level differences between an old and a new version of a (cleaned) table
+// rows are matched up by the hash of their title sort key (as derived by WikiTitleSort()), so a row keeps its identity
+//  through edits to its other cells and through being moved; rows with the same key are matched up in order
+// whether a matched row's cells changed is decided by comparing row hashes, so that unchanged rows (normally nearly
+//  all of them) are never compared cell by cell
+// matched rows that stay in the same relative order (the longest run of them that does) are kept in place; the rest
+//  are reported as moved
+// the result is an edit script that turns the old table into the new one: kept rows in order, with deleted (or
+//  moved away) old rows and inserted (or moved in) new rows between them
+struct TableDiffS
+{
+  // row number meaning "none"
+  static constexpr std::size_t NO_ROW = static_cast<std::size_t>(-1);
+
+  enum EditE
+  {
+    // old row removed: deleted if newRowM is NO_ROW, otherwise moved to newRowM
+    ED_REMOVE,
+    // new row added: inserted if oldRowM is NO_ROW, otherwise moved from oldRowM
+    ED_ADD,
+    // old row kept as new row, with changed cells
+    ED_UPDATE
+  };
+
+  // a step of the edit script; rows are data row numbers (from 0)
+  struct EditS
+  {
+    EditE       typeM;
+    std::size_t oldRowM;
+    std::size_t newRowM;
+  };
+
+  // edits in script order; kept rows that are unchanged aren't listed
+  std::vector<EditS> editsM;
+  std::size_t numInsertedM;
+  std::size_t numDeletedM;
+  std::size_t numMovedM;
+  // matched rows (kept or moved) whose cells changed
+  std::size_t numChangedM;
+  // whether the headers differ (in values or width)
+  bool headerChangedM;
+
+  // compare oldTable to newTable, using up to the given number of threads to hash their rows
+  // both tables should have been cleaned with WikiTitleClean(), and must outlive this instance
+  // matching and scripting are recorded in stats (if any) as the sort phase
+  TableDiffS(const TableS& oldTable, const TableS& newTable, unsigned threads = 1, StatsS* stats = nullptr);
+
+  // true if the tables are the same
+  bool Empty() const { return editsM.empty() && !headerChangedM; }
+
+  // print the changes as a TSV table with the columns: change, old row, new row, column, old value, new value
+  // rows and columns are numbered from 1; a change is one of:
+  // - header: a header cell changed (column, old and new header)
+  // - delete: an old row was removed (title)
+  // - insert: a new row was added (title)
+  // - move:   a row moved (title in old and new rows)
+  // - cell:   a cell of a kept or moved row changed (column, old and new value)
+  // throws std::runtime_error on write failure
+  void PrintList(OutputS& out) const;
+
+  // print the changes as a unified diff from the wiki markup that PrintWiki() makes of the old table as loaded to
+  //  that of the new one, labelled with the given names
+  // oldRows are the old table's data rows before cleaning, which the old side is rendered from; rows whose cleaned
+  //  cells are unchanged are left as they were
+  // only the lines that differ are changed: a changed cell replaces the one line it's on, and a moved row is
+  //  removed in one place and added in another; each hunk has up to three lines of context around its changes, as
+  //  diff -u gives, so that patch can find it in text that has the markup at another line
+  // throws std::runtime_error on write failure
+  void PrintWikiPatch(const TableS::RowListT& oldRows, const std::string& oldName, const std::string& newName,
+                      OutputS& out) const;
+
+private:
+  const TableS& oldM;
+  const TableS& newM;
+  // hash of each row's cells, per table
+  std::vector<std::uint64_t> oldHashesM;
+  std::vector<std::uint64_t> newHashesM;
+};
+
+#endif
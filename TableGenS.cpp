@@ -0,0 +1,117 @@
+#include "TableGenS.h"
+
+#include <string_view>
+
+#include "OutputS.h"
+
+namespace
+{
+  const char* const WORDS[] =
+  {
+    "Doom", "Quest", "King's", "Space", "Ultima", "Wing", "Commander", "Monkey", "Island", "Hero", "Legend",
+    "Kyrandia", "Zork", "Dune", "Castle", "Secret", "Gold", "Rush", "Police", "Indiana"
+  };
+  const unsigned NUM_WORDS(sizeof(WORDS) / sizeof(WORDS[0]));
+
+  const char* const ARTICLES[] = { "", "", "", "The ", "A ", "An " };
+  const unsigned NUM_ARTICLES(sizeof(ARTICLES) / sizeof(ARTICLES[0]));
+
+  const char* const DEVELOPERS[] =
+  {
+    "Sierra On-Line", "LucasArts", "Origin Systems", "Westwood Studios", "id Software", "Accolade", "MicroProse"
+  };
+  const unsigned NUM_DEVELOPERS(sizeof(DEVELOPERS) / sizeof(DEVELOPERS[0]));
+
+  // checkbox values, weighted towards the common ones
+  const char* const CHECKS[] = { "{{ya}}", "{{ya}}", "{{ya}}", "{{no}}", "{{no}}", "", "", "{{Ya}}", "{{YA}}" };
+  const unsigned NUM_CHECKS(sizeof(CHECKS) / sizeof(CHECKS[0]));
+
+  const char* const NOTES[] = { "", "", "", "Requires patch", "Intro only", "Some [[Sound effect|SFX]] only" };
+  const unsigned NUM_NOTES(sizeof(NOTES) / sizeof(NOTES[0]));
+
+  const char* const HEADER[] =
+  {
+    "Title", "Year", "Developer", "MT-32", "CM-32L", "SC-55", "General MIDI", "AdLib", "Sound Blaster", "Notes"
+  };
+  const unsigned NUM_COLS(sizeof(HEADER) / sizeof(HEADER[0]));
+}
+
+TableGenS::TableGenS(const unsigned seed)
+  : rngM(seed)
+{
+}
+
+void TableGenS::AppendName(std::string& out)
+{
+  out.append(ARTICLES[rngM() % NUM_ARTICLES]);
+  const unsigned words(1 + rngM() % 4);
+  for (unsigned wordNum(0); wordNum < words; ++wordNum)
+  {
+    if (wordNum) out.push_back(' ');
+    out.append(WORDS[rngM() % NUM_WORDS]);
+  }
+}
+
+std::string TableGenS::Title(const unsigned form)
+{
+  std::string name;
+  AppendName(name);
+  switch (form % TITLE_FORMS)
+  {
+    case 0: return "''[[" + name + " (video game)|" + name + "]]''";
+    case 1: return "''[[" + name + "]]''";
+    case 2: return "''{{ill|" + name + " (game)|de|lt=" + name + "|" + name + "}}''";
+    case 3: return "''{{ill|" + name + "|ja}}''";
+    default: return "''" + name + "''";
+  }
+}
+
+void TableGenS::WriteTSV(const std::size_t rows, OutputS& out)
+{
+  for (unsigned colNum(0); colNum < NUM_COLS; ++colNum)
+  {
+    if (colNum) out.Put('\t');
+    out.Write(HEADER[colNum]);
+  }
+  out.Put('\n');
+
+  std::string title;
+  for (std::size_t rowNum(0); rowNum < rows; ++rowNum)
+  {
+    // about one row in eight is cut short
+    const unsigned numCols(rngM() % 8 ? NUM_COLS : 1 + rngM() % (NUM_COLS - 1));
+    // title, sometimes without italic markup or with stray whitespace for WikiTitleClean() to fix
+    title = Title(rngM() % TITLE_FORMS);
+    std::string_view titleView(title);
+    switch (rngM() % 16)
+    {
+      case 0: titleView = titleView.substr(2, titleView.length() - 4); break;
+      case 1: titleView.remove_suffix(2); break;
+      case 2: out.Write("  "); break;
+      default: break;
+    }
+    out.Write(titleView);
+    for (unsigned colNum(1); colNum < numCols; ++colNum)
+    {
+      out.Put('\t');
+      if (colNum == 1)
+      {
+        out.Write(std::to_string(1980 + rngM() % 20));
+      }
+      else if (colNum == 2)
+      {
+        out.Write(DEVELOPERS[rngM() % NUM_DEVELOPERS]);
+      }
+      else if (colNum == NUM_COLS - 1)
+      {
+        out.Write(NOTES[rngM() % NUM_NOTES]);
+      }
+      else
+      {
+        // checkbox columns
+        out.Write(CHECKS[rngM() % NUM_CHECKS]);
+      }
+    }
+    out.Put('\n');
+  }
+}
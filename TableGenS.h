@@ -0,0 +1,39 @@
+#ifndef TABLEGENS_H
+#define TABLEGENS_H
+
+#include <cstddef>
+#include <random>
+#include <string>
+
+struct OutputS;
+
+// seeded generator of synthetic game compatibility tables, for benchmarking
+// tables have a title column followed by a few text columns and a run of checkbox columns, and mimic the untidy
+//  input the tools see in practice:
+// - titles use all five forms understood by TitleKeyS, some with leading articles, and some are missing their
+//  italic markup or have stray surrounding whitespace
+// - checkbox cells hold {{ya}}/{{no}} markup in assorted capitalizations, or nothing
+// - some rows are ragged, stopping short of the last column
+// the same seed always produces the same table
+struct TableGenS
+{
+  // number of title forms supported by Title()
+  static const unsigned TITLE_FORMS = 5;
+
+  explicit TableGenS(unsigned seed);
+
+  // generate an italicized title in the given form (modulo TITLE_FORMS)
+  std::string Title(unsigned form);
+
+  // write a TSV table with a header row and the given number of data rows to out
+  // throws std::runtime_error on write failure
+  void WriteTSV(std::size_t rows, OutputS& out);
+
+private:
+  // append a random name of a few words, possibly with a leading article
+  void AppendName(std::string& out);
+
+  std::mt19937 rngM;
+};
+
+#endif
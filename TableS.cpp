@@ -1,66 +1,492 @@
 #include "TableS.h"
 
+#include "BlockReaderS.h"
+#include "ChannelS.h"
+#include "DelimScanS.h"
+#include "OutputS.h"
+#include "ParallelS.h"
+#include "SnapshotS.h"
+#include "SortIndexS.h"
+#include "StatsS.h"
+#include "TitleKeyS.h"
+
 #include <algorithm>
-#include <iostream>
-#include <fstream>
-#include <map>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <queue>
 #include <stdexcept>
+#include <thread>
 
 namespace
 {
   const std::string MARKUP_ITALIC("''");
+  const TableS::CellT MARKUP_CHECK_YES("{{ya}}");
+  // amount of TSV text gathered before each write to a sort run file
+  const std::size_t STREAM_BUFFER_SIZE(1 << 20);
+  // input blocks of a streaming pipeline: one being read, one tokenized and one printed
+  const std::size_t PIPELINE_BLOCKS(3);
+  // row batches passed between the tokenizing and printing stages of a streaming pipeline
+  const std::size_t PIPELINE_BATCHES(2);
+  // values up to this long are copied into the cell arena by StoreCell(); longer ones are kept in their own strings
+  const std::size_t MAX_ARENA_CELL(4096);
+
+  // true for the characters std::isspace() accepts in the "C" locale
+  inline bool IsSpace(const char c)
+  {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+  }
 
-  // return a copy of s with all leading and trailing whitespace removed
-  std::string Strip(const std::string& s)
+  // return a view of s with all leading and trailing whitespace removed
+  TableS::CellT Strip(TableS::CellT s)
   {
-      std::string::const_iterator sIter(s.begin());
-      std::string::const_reverse_iterator sRiter(s.rbegin());
-      while (std::isspace(*sIter))  ++sIter;
-      // special case: return empty string if s is empty or all whitespace
-      if (sIter == s.end()) return std::string();
+    std::size_t start(0);
+    std::size_t end(s.length());
+    while (start < end && IsSpace(s[start])) ++start;
+    // special case: return empty view if s is empty or all whitespace
+    if (start == end) return TableS::CellT();
 
-      while (std::isspace(*sRiter)) ++sRiter;
-      return std::string(sIter, sRiter.base());
+    while (IsSpace(s[end - 1])) --end;
+    return s.substr(start, end - start);
   }
 
-  typedef std::vector<std::string> TokenListT;
-  // split string 's' into a vector of tokens, by delimiter string 'delim'
+  // tokenize TSV text into cells, passing each to sink.Cell(), and calling sink.RowEnd() after the last cell of each
+  //  line
+  // a line is terminated by a newline or by the end of text; an empty line yields a single empty cell
+  // tab at line start will be interpreted as being preceded by an empty cell
+  // tab at line end will be interpreted as being followed by an empty cell
+  // all cells will be stripped of leading/trailing whitespace
+  // delimiters are located with DelimScanS bitmasks, so each byte of text is classified once, in bulk
+  template <typename SinkT>
+  void TokenizeTSV(const TableS::CellT text, SinkT& sink)
+  {
+    const char* const base(text.data());
+    std::size_t cellStart(0);
+    DelimScanS::ForEachDelim(text, [base, &sink, &cellStart](const std::size_t pos)
+    {
+      sink.Cell(Strip(TableS::CellT(base + cellStart, pos - cellStart)));
+      cellStart = pos + 1;
+    },
+    [base, &sink, &cellStart](const std::size_t pos, const bool cr)
+    {
+      // drop CR of a CRLF line ending up front; Strip() would catch it anyway, but this spares it a byte test
+      const std::size_t cellEnd(cr && pos > cellStart ? pos - 1 : pos);
+      sink.Cell(Strip(TableS::CellT(base + cellStart, cellEnd - cellStart)));
+      sink.RowEnd();
+      cellStart = pos + 1;
+    });
+  }
+
+  // TokenizeTSV() sink that appends the first row to a header (if one is given), and the rest to a row list
+  // cells are collected in a reused scratch row, and each row is then copied out at its exact size, allocated from
+  //  the given memory resource; the widest row's width is tracked along the way
+  struct TableSinkS
+  {
+    TableS::RowListT& rowsM;
+    TableS::ColListT* headerM;
+    std::pmr::memory_resource* resourceM;
+    TableS::ColListT scratchM;
+    std::size_t maxColsM;
+
+    TableSinkS(TableS::RowListT& rows, TableS::ColListT* header, std::pmr::memory_resource* resource)
+      : rowsM(rows), headerM(header), resourceM(resource), maxColsM(0) {}
+
+    void Cell(const TableS::CellT cell) { scratchM.push_back(cell); }
+
+    void RowEnd()
+    {
+      if (headerM)
+      {
+        headerM->assign(scratchM.begin(), scratchM.end());
+        headerM = nullptr;
+      }
+      else
+      {
+        rowsM.emplace_back(scratchM.begin(), scratchM.end(), resourceM);
+        maxColsM = std::max(maxColsM, scratchM.size());
+      }
+      scratchM.clear();
+    }
+  };
+
+  // TokenizeTSV() sink that collects one row at a time, and hands it to a function at row end
+  template <typename RowFuncT>
+  struct RowSinkS
+  {
+    TableS::ColListT rowM;
+    RowFuncT rowFuncM;
+
+    explicit RowSinkS(RowFuncT rowFunc) : rowFuncM(rowFunc) {}
+
+    void Cell(const TableS::CellT cell) { rowM.push_back(cell); }
+
+    void RowEnd()
+    {
+      rowFuncM(rowM);
+      rowM.clear();
+    }
+  };
+
+  // TokenizeTSV() sink that collects the rows of a block of input, for handing from the tokenizing to the printing
+  //  stage of a pipeline
+  // cells are kept in one flat list, which is reused from one block to the next
+  struct RowBatchS
+  {
+    BlockReaderS::BlockS* blockM;
+    std::vector<TableS::CellT> cellsM;
+    // end of each row's cells in cellsM
+    std::vector<std::size_t> rowEndsM;
+
+    RowBatchS() : blockM(nullptr) {}
+
+    // start collecting the rows of block
+    void Reset(BlockReaderS::BlockS* const block)
+    {
+      blockM = block;
+      cellsM.clear();
+      rowEndsM.clear();
+    }
+
+    void Cell(const TableS::CellT cell) { cellsM.push_back(cell); }
+
+    void RowEnd() { rowEndsM.push_back(cellsM.size()); }
+  };
+
+  // TokenizeTSV() sink that only tracks the maximum column count
+  struct WidthSinkS
+  {
+    std::size_t colsM;
+    std::size_t maxColsM;
+
+    WidthSinkS() : colsM(0), maxColsM(0) {}
+
+    void Cell(const TableS::CellT) { ++colsM; }
+
+    void RowEnd()
+    {
+      if (colsM > maxColsM) maxColsM = colsM;
+      colsM = 0;
+    }
+  };
+
+  // split view 's' into cells by delimiter string 'delim', appending them to 'tList'
   // delimiter at string start will be interpreted as being preceded by an empty token
   // delimiter at string end will be interpreted as being followed by an empty token
   // all tokens will be stripped of leading/trailing whitepsace
   // empty string will result in a single empty token
-  TokenListT Split(const std::string& s, const std::string& delim)
+  void Split(TableS::CellT s, const TableS::CellT delim, TableS::ColListT& tList)
   {
-    TokenListT tList;
-    std::size_t delimStart(0);
     std::size_t tokenStart(0);
-    while (delimStart != std::string::npos)
+    for (;;)
     {
-      // find next delimiter start
-      delimStart = s.find(delim, tokenStart);
-      // if not found, snap off the rest of the string as the last token
-      if (delimStart == std::string::npos)
+      const std::size_t delimStart(s.find(delim, tokenStart));
+      if (delimStart == TableS::CellT::npos)
       {
         tList.push_back(Strip(s.substr(tokenStart)));
         break;
       }
-      // found a delimiter; push everything since the last one
       tList.push_back(Strip(s.substr(tokenStart, delimStart - tokenStart)));
-      // advance token start marker past end of delimiter
       tokenStart = delimStart + delim.length();
-      // if we go off the edge, the delimiter was at the end
-      if (tokenStart >= s.length())
+    }
+  }
+
+  // wiki table parser state
+  enum ReadStateE
+  {
+    // find table start
+    RS_TABLE,
+    // find and read column headers until row end
+    RS_HEADER,
+    // find and read column data until row end
+    RS_DATA,
+    // found table or file end
+    RS_DONE
+  };
+
+  // wiki markup line types, as determined by their leading characters
+  enum WikiLineE
+  {
+    // "{|"
+    WL_TABLE_START,
+    // "|+"
+    WL_CAPTION,
+    // "|-"
+    WL_ROW_SEP,
+    // "|}"
+    WL_TABLE_END,
+    // "|" followed by anything else
+    WL_DATA,
+    // "!"
+    WL_HEADER,
+    // anything else
+    WL_OTHER
+  };
+
+  // classify a wiki markup line by switching on its first (and if needed, second) byte
+  WikiLineE ClassifyWikiLine(const TableS::CellT line)
+  {
+    if (line.empty()) return WL_OTHER;
+    switch (line[0])
+    {
+      case '!': return WL_HEADER;
+      case '{': return (line.length() > 1 && line[1] == '|') ? WL_TABLE_START : WL_OTHER;
+      case '|':
       {
-        // push an empty token as the last one
-        tList.push_back(std::string());
-        break;
+        if (line.length() > 1)
+        {
+          switch (line[1])
+          {
+            case '+': return WL_CAPTION;
+            case '-': return WL_ROW_SEP;
+            case '}': return WL_TABLE_END;
+          }
+        }
+        return WL_DATA;
+      }
+    }
+    return WL_OTHER;
+  }
+
+  // minimum input bytes per LoadTSV() worker thread
+  const std::size_t MIN_LOAD_CHUNK(1 << 20);
+
+  // minimum cells per ParseSnapshot() worker thread
+  const std::size_t MIN_SNAPSHOT_CELLS(1 << 18);
+
+  // minimum rows per WikiTitleSort() worker thread
+  const std::size_t MIN_SORT_ROWS(1 << 15);
+
+  // sort key of a data row, and the row's original position
+  struct SortEntryS
+  {
+    TableS::CellT keyM;
+    std::size_t   rowM;
+
+    bool operator<(const SortEntryS& other) const { return keyM < other.keyM; }
+  };
+
+  // WikiTitleSort() on a row list: derive the sort key of each row from its (cleaned) title, once, folded according
+  //  to fold, and stable-sort the rows by them using the given number of threads
+  // leaves the sorted keys and original row numbers in entries, and the keys' storage in keyArenas
+  void SortRows(TableS::RowListT& rows, const std::size_t threads, const TitleKeyS::FoldE fold,
+                std::vector<SortEntryS>& entries, std::vector<std::string>& keyArenas)
+  {
+    // each thread writes the keys for a range of rows into its own arena, reserved up front so that it never
+    //  reallocates and key views stay valid
+    entries.resize(rows.size());
+    keyArenas.assign(threads, std::string());
+    ParallelS::Run(threads, [threads, fold, &rows, &entries, &keyArenas](const std::size_t part)
+    {
+      const std::size_t rowStart(rows.size() * part / threads);
+      const std::size_t rowEnd(rows.size() * (part + 1) / threads);
+      std::string& keyArena(keyArenas[part]);
+      std::size_t arenaSize(0);
+      for (std::size_t rowNum(rowStart); rowNum < rowEnd; ++rowNum)
+      {
+        arenaSize += TitleKeyS::MaxLength(TableS::Cell(rows[rowNum], 0).length());
+      }
+      keyArena.reserve(arenaSize);
+      for (std::size_t rowNum(rowStart); rowNum < rowEnd; ++rowNum)
+      {
+        const std::size_t keyStart(keyArena.length());
+        TitleKeyS::Append(TableS::Cell(rows[rowNum], 0), keyArena, fold);
+        entries[rowNum].keyM = TableS::CellT(keyArena.data() + keyStart, keyArena.length() - keyStart);
+        entries[rowNum].rowM = rowNum;
+      }
+    });
+    // stable sort, so that rows with duplicate keys keep their relative order
+    ParallelS::StableSort(entries, threads);
+    // move rows into sorted order
+    TableS::RowListT sorted;
+    sorted.reserve(rows.size());
+    for (const SortEntryS& entry : entries) sorted.push_back(std::move(rows[entry.rowM]));
+    rows.swap(sorted);
+  }
+
+  // an indexed WikiTitleSort() falls back on a full sort if more than this fraction (as 1/N) of rows have new titles
+  const std::size_t MAX_CHANGED_FRACTION(4);
+  // rank of a row whose title isn't in the sort index
+  const std::size_t NO_RANK(static_cast<std::size_t>(-1));
+
+  // append row to out as a TSV line
+  void AppendTSVLine(const TableS::ColListT& row, std::string& out)
+  {
+    bool prependTab(false);
+    for (const TableS::CellT cell : row)
+    {
+      if (prependTab) out += '\t';
+      else            prependTab = true;
+      out.append(cell);
+    }
+    out += '\n';
+  }
+
+  // closes a temporary file when it goes out of scope (which also deletes it)
+  struct FileCloserS
+  {
+    void operator()(std::FILE* file) const { std::fclose(file); }
+  };
+  typedef std::unique_ptr<std::FILE, FileCloserS> FilePtrT;
+
+  // write rows to a new temporary file as TSV lines, and return it rewound for reading
+  // throws std::runtime_error if the file cannot be created or written
+  FilePtrT WriteRunFile(const TableS::RowListT& rows)
+  {
+    FilePtrT runFile(std::tmpfile());
+    if (!runFile) throw std::runtime_error("Failed to create temporary file for sort run");
+    std::string out;
+    for (TableS::RowListT::const_iterator rlCiter(rows.begin()); rlCiter != rows.end(); ++rlCiter)
+    {
+      AppendTSVLine(*rlCiter, out);
+      if (out.length() >= STREAM_BUFFER_SIZE || rlCiter + 1 == rows.end())
+      {
+        if (std::fwrite(out.data(), 1, out.length(), runFile.get()) != out.length())
+        {
+          throw std::runtime_error("Failed to write temporary file for sort run");
+        }
+        out.clear();
       }
     }
-    return tList;
+    if (std::fflush(runFile.get())) throw std::runtime_error("Failed to write temporary file for sort run");
+    std::rewind(runFile.get());
+    return runFile;
+  }
+
+  // sequential reader for the lines of a sorted run file, which tracks the title sort key of the current line
+  struct RunReaderS
+  {
+    std::FILE*        fileM;
+    std::vector<char> bufferM;
+    // unconsumed bytes of bufferM are [startM, endM)
+    std::size_t       startM;
+    std::size_t       endM;
+    bool              eofM;
+    // current line (minus newline), and its sort key
+    TableS::CellT     lineM;
+    std::string       keyM;
+    TitleKeyS::FoldE  foldM;
+
+    RunReaderS(std::FILE* file, const std::size_t bufferSize, const TitleKeyS::FoldE fold)
+      : fileM(file), bufferM(bufferSize), startM(0), endM(0), eofM(false), foldM(fold) {}
+
+    // advance to next line; returns false at end of run
+    bool Next()
+    {
+      for (;;)
+      {
+        const TableS::CellT unread(bufferM.data() + startM, endM - startM);
+        const std::size_t newline(unread.find('\n'));
+        if (newline != TableS::CellT::npos)
+        {
+          lineM = unread.substr(0, newline);
+          startM += newline + 1;
+          break;
+        }
+        // run files always end with a newline, so anything left at end of file is garbage
+        if (eofM) return false;
+        // shift partial line to buffer start, growing the buffer if it alone fills it, then refill
+        std::memmove(bufferM.data(), bufferM.data() + startM, endM - startM);
+        endM -= startM;
+        startM = 0;
+        if (endM == bufferM.size()) bufferM.resize(bufferM.size() * 2);
+        endM += std::fread(bufferM.data() + endM, 1, bufferM.size() - endM, fileM);
+        eofM = std::feof(fileM) || std::ferror(fileM);
+      }
+      keyM.clear();
+      TitleKeyS::Append(lineM.substr(0, lineM.find('\t')), keyM, foldM);
+      return true;
+    }
+  };
+
+  // print line, followed by enough empty cells to make it numCols wide
+  void PrintPaddedLine(const TableS::CellT line, const std::size_t numCols, OutputS& out)
+  {
+    out << line;
+    const std::size_t lineCols(static_cast<std::size_t>(std::count(line.begin(), line.end(), '\t')) + 1);
+    if (lineCols < numCols) out.Fill('\t', numCols - lineCols);
+    out << '\n';
+  }
+
+  // read the input of a line-aligned reader, calling chunkFunc with views of whole lines at a time as they arrive,
+  //  so that reading the next chunk overlaps with processing this one
+  // each view ends just after a newline, except for the last one if the input doesn't end with a newline
+  // views are only valid for the duration of the call
+  // waits for reads are recorded in stats (if any) as the read phase
+  // throws std::runtime_error if input cannot be read
+  template <typename ChunkFuncT>
+  void ForEachChunk(BlockReaderS& reader, StatsS* const stats, ChunkFuncT chunkFunc)
+  {
+    for (;;)
+    {
+      BlockReaderS::BlockS* block;
+      {
+        StatsS::TimerS timer(stats, StatsS::PH_READ);
+        block = reader.Next();
+        if (block) timer.Count(block->usedM, 0, 0);
+      }
+      if (!block) break;
+      chunkFunc(block->View());
+      reader.Release(block);
+    }
+  }
+
+  // as above, reading file (or stdin, if it's MappedFileS::STDIN_NAME) on a reader of its own
+  // throws std::runtime_error if file cannot be opened or read
+  template <typename ChunkFuncT>
+  void ForEachChunk(const std::string& filename, StatsS* const stats, ChunkFuncT chunkFunc)
+  {
+    BlockReaderS reader(filename, true);
+    ForEachChunk(reader, stats, chunkFunc);
+  }
+
+  // true if the input is a table snapshot (see SnapshotS)
+  // stdin can't be read twice, so it's detected from a peek at the first block of the reader that would otherwise
+  //  stream it as TSV
+  bool IsSnapshot(const std::string& filename, BlockReaderS& reader)
+  {
+    if (filename != MappedFileS::STDIN_NAME) return SnapshotS::DetectFile(filename);
+    const BlockReaderS::BlockS* const block(reader.Peek());
+    return block && SnapshotS::Detect(block->View());
+  }
+
+  // read the rest of the input from reader into a single buffer, recording it in stats (if any) as the read phase
+  std::string ReadAll(BlockReaderS& reader, StatsS* const stats)
+  {
+    StatsS::TimerS timer(stats, StatsS::PH_READ);
+    std::string text;
+    for (;;)
+    {
+      BlockReaderS::BlockS* const block(reader.Next());
+      if (!block) break;
+      text.append(block->View());
+      reader.Release(block);
+    }
+    timer.Count(text.length(), 0, 0);
+    return text;
   }
 }
 
-TableS::TableS(const std::string& filename, const FileTypeE fileType)
+TableS::TableS()
+  : numColsM(0)
+  , cellArenaM(nullptr)
+  , useArenasM(true)
+  , threadsM(1)
+  , statsM(nullptr)
+  , foldM(TitleKeyS::FO_CASE)
+{
+}
+
+TableS::TableS(const std::string& filename, const FileTypeE fileType, const unsigned threads)
+  : numColsM(0)
+  , cellArenaM(nullptr)
+  , useArenasM(true)
+  , threadsM(threads)
+  , statsM(nullptr)
+  , foldM(TitleKeyS::FO_CASE)
 {
   switch (fileType)
   {
@@ -69,67 +495,360 @@ TableS::TableS(const std::string& filename, const FileTypeE fileType)
   }
 }
 
+TableS::~TableS()
+{
+  dataM.clear();
+}
+
 void TableS::Clear()
 {
   headerM.clear();
   dataM.clear();
+  numColsM = 0;
+  inputM.Close();
+  cellPoolM.clear();
+  arenasM.clear();
+  cellArenaM = nullptr;
 }
 
 void TableS::Normalize()
 {
-  // scan header and data for maximum column count
-  std::size_t numCols(headerM.size());
-  for (RowListT::const_iterator rlCiter(dataM.begin()); rlCiter != dataM.end(); ++rlCiter)
+  StatsS::TimerS timer(statsM, StatsS::PH_NORMALIZE);
+  // the widest data row is tracked as rows are added, so only the header needs looking at
+  numColsM = std::max(numColsM, headerM.size());
+  const std::size_t added(numColsM - headerM.size());
+  headerM.resize(numColsM);
+  timer.Count(0, dataM.size(), added);
+}
+
+void TableS::LoadTSV(const std::string& filename)
+{
+  // open first, so that a failure leaves the current contents intact
+  MappedFileS inFile;
   {
-    if (rlCiter->size() > numCols) numCols = rlCiter->size();
+    StatsS::TimerS timer(statsM, StatsS::PH_READ);
+    inFile.Open(filename);
+    timer.Count(inFile.View().length(), 0, 0);
   }
-  // now scan them again and adjust as needed
-  const std::string emptyString;
-  while (headerM.size() < numCols)
+  Clear();
+  inputM = std::move(inFile);
+  if (SnapshotS::Detect(inputM.View())) ParseSnapshot(inputM.View());
+  else                                  ParseTSV(inputM.View(), true);
+}
+
+void TableS::LoadTSVText(std::string&& text, const bool hasHeader)
+{
+  Clear();
+  ParseTSV(StoreCell(std::move(text)), hasHeader);
+}
+
+void TableS::ParseTSV(const CellT text, const bool hasHeader)
+{
+  StatsS::TimerS timer(statsM, StatsS::PH_TOKENIZE);
+  const std::size_t threads(ParallelS::NumThreads(threadsM, text.length(), MIN_LOAD_CHUNK));
+  if (threads == 1)
   {
-    headerM.push_back(emptyString);
+    TableSinkS sink(dataM, hasHeader ? &headerM : nullptr, NewArena(text.length()));
+    TokenizeTSV(text, sink);
+    numColsM = std::max(numColsM, sink.maxColsM);
+    if (statsM) timer.Count(text.length(), dataM.size(), CountCells());
+    Normalize();
+    return;
   }
-  for (RowListT::iterator rlIter(dataM.begin()); rlIter != dataM.end(); ++rlIter)
+  // tokenize header line up front, so that workers only see data rows
+  std::size_t bodyStart(0);
+  if (hasHeader)
   {
-    while (rlIter->size() < numCols) rlIter->push_back(emptyString);
+    bodyStart = text.find('\n');
+    bodyStart = (bodyStart == CellT::npos ? text.length() : bodyStart + 1);
+    TableSinkS sink(dataM, &headerM, std::pmr::get_default_resource());
+    TokenizeTSV(text.substr(0, bodyStart), sink);
   }
+  const CellT body(text.substr(bodyStart));
+  // split body into one chunk per thread, moving each boundary to just past the next newline
+  std::vector<std::size_t> bounds(threads + 1, body.length());
+  bounds[0] = 0;
+  for (std::size_t part(1); part < threads; ++part)
+  {
+    const std::size_t newline(body.find('\n', std::max(bounds[part - 1], body.length() * part / threads)));
+    bounds[part] = (newline == CellT::npos ? body.length() : newline + 1);
+  }
+  // tokenize each chunk into its own row list and arena, then splice the lists together in order
+  std::vector<RowListT> partRows(threads);
+  std::vector<std::pmr::memory_resource*> partArenas(threads);
+  std::vector<std::size_t> partCols(threads, 0);
+  for (std::size_t part(0); part < threads; ++part) partArenas[part] = NewArena(bounds[part + 1] - bounds[part]);
+  ParallelS::Run(threads, [&body, &bounds, &partRows, &partArenas, &partCols](const std::size_t part)
+  {
+    TableSinkS sink(partRows[part], nullptr, partArenas[part]);
+    TokenizeTSV(body.substr(bounds[part], bounds[part + 1] - bounds[part]), sink);
+    partCols[part] = sink.maxColsM;
+  });
+  numColsM = std::max(numColsM, *std::max_element(partCols.begin(), partCols.end()));
+  std::size_t numRows(0);
+  for (const RowListT& rows : partRows) numRows += rows.size();
+  dataM.reserve(numRows);
+  for (RowListT& rows : partRows)
+  {
+    std::move(rows.begin(), rows.end(), std::back_inserter(dataM));
+    RowListT().swap(rows);
+  }
+  if (statsM) timer.Count(text.length(), dataM.size(), CountCells());
+  Normalize();
 }
 
-void TableS::LoadTSV(const std::string& filename)
+void TableS::ParseSnapshot(const CellT data)
 {
-  std::ifstream inFile;
-  inFile.open(filename);
-  if (!inFile.is_open())
+  StatsS::TimerS timer(statsM, StatsS::PH_TOKENIZE);
+  const SnapshotS snapshot(data);
+  const std::size_t numRows(snapshot.NumRows() - 1);
+  headerM.assign(snapshot.NumCols(), CellT());
+  for (std::size_t col(0); col < headerM.size(); ++col) headerM[col] = snapshot.Cell(col);
+  // split rows into one range per thread with about the same number of cells, and build each range's row lists
+  //  into a list and arena of its own, then splice the lists together in order
+  const std::size_t threads(ParallelS::NumThreads(threadsM, snapshot.NumCells(), MIN_SNAPSHOT_CELLS));
+  std::vector<std::size_t> bounds(threads + 1, numRows);
+  bounds[0] = 0;
+  for (std::size_t part(1); part < threads; ++part)
   {
-    throw std::runtime_error(std::string("Failed to open input file: '") + filename + "' for read");
+    bounds[part] = bounds[part - 1];
+    const std::size_t cellTarget(snapshot.NumCells() * part / threads);
+    while (bounds[part] < numRows && snapshot.RowBegin(bounds[part] + 1) < cellTarget) ++bounds[part];
   }
-  Clear();
-  std::string line;
-  bool readingHeader(true);
-  while (std::getline(inFile, line))
+  std::vector<RowListT> partRows(threads);
+  std::vector<std::pmr::memory_resource*> partArenas(threads);
+  for (std::size_t part(0); part < threads; ++part)
   {
-    const TokenListT& t(Split(line, "\t"));
-    if (readingHeader)
+    const std::size_t partCells(snapshot.RowBegin(bounds[part + 1] + 1) - snapshot.RowBegin(bounds[part] + 1));
+    partArenas[part] = NewArena(partCells * sizeof(CellT));
+  }
+  ParallelS::Run(threads, [&snapshot, &bounds, &partRows, &partArenas](const std::size_t part)
+  {
+    RowListT& rows(partRows[part]);
+    rows.reserve(bounds[part + 1] - bounds[part]);
+    // (data row n is snapshot row n + 1)
+    for (std::size_t rowNum(bounds[part] + 1); rowNum <= bounds[part + 1]; ++rowNum)
     {
-      headerM = t;
-      readingHeader = false;
-      continue;
+      const std::size_t begin(snapshot.RowBegin(rowNum));
+      rows.emplace_back(snapshot.RowEnd(rowNum) - begin, CellT(), partArenas[part]);
+      ColListT& row(rows.back());
+      for (std::size_t col(0); col < row.size(); ++col) row[col] = snapshot.Cell(begin + col);
     }
-    dataM.push_back(t);
+  });
+  dataM.reserve(numRows);
+  for (RowListT& rows : partRows)
+  {
+    std::move(rows.begin(), rows.end(), std::back_inserter(dataM));
+    RowListT().swap(rows);
   }
-  inFile.close();
+  numColsM = snapshot.NumCols();
+  timer.Count(data.length(), dataM.size(), snapshot.NumCells());
   Normalize();
 }
 
+void TableS::ForEachTSVRow(const CellT text, const std::function<void(const ColListT&)>& rowFunc)
+{
+  RowSinkS<const std::function<void(const ColListT&)>&> sink(rowFunc);
+  TokenizeTSV(text, sink);
+}
+
 void TableS::LoadWiki(const std::string& filename)
 {
-  // TODO
-  throw std::runtime_error("TODO");
+  // open first, so that a failure leaves the current contents intact
+  MappedFileS inFile;
+  {
+    StatsS::TimerS timer(statsM, StatsS::PH_READ);
+    inFile.Open(filename);
+    timer.Count(inFile.View().length(), 0, 0);
+  }
+  Clear();
+  inputM = std::move(inFile);
+  ParseWiki(inputM.View());
+}
+
+void TableS::LoadWikiText(std::string&& text)
+{
+  Clear();
+  ParseWiki(StoreCell(std::move(text)));
+}
+
+void TableS::ParseWiki(const CellT text)
+{
+  StatsS::TimerS timer(statsM, StatsS::PH_TOKENIZE);
+  // cells of the data row being read, if any; copied out to dataM at their exact size once the row ends
+  std::pmr::memory_resource* const resource(NewArena(text.length()));
+  ColListT row;
+  bool rowOpen(false);
+  auto closeRow([this, &row, &rowOpen, resource]()
+  {
+    if (!rowOpen) return;
+    dataM.emplace_back(row.begin(), row.end(), resource);
+    numColsM = std::max(numColsM, row.size());
+    row.clear();
+    rowOpen = false;
+  });
+  ReadStateE readState(RS_TABLE);
+  // depth of the nested table being skipped, if any
+  std::size_t nestedDepth(0);
+  std::size_t lineStart(0);
+  while (readState != RS_DONE && lineStart < text.length())
+  {
+    std::size_t lineEnd(text.find('\n', lineStart));
+    if (lineEnd == CellT::npos) lineEnd = text.length();
+    const CellT line(text.substr(lineStart, lineEnd - lineStart));
+    lineStart = lineEnd + 1;
+    const WikiLineE lineType(ClassifyWikiLine(line));
+    // a table nested in a cell can't be represented in one, so its lines are skipped, leaving it to be read as a
+    //  table of its own (see FindWikiTables()); its row separators and end mustn't be taken for this table's
+    if (readState != RS_TABLE && (nestedDepth || lineType == WL_TABLE_START))
+    {
+      if      (lineType == WL_TABLE_START) ++nestedDepth;
+      else if (lineType == WL_TABLE_END)   --nestedDepth;
+      continue;
+    }
+    switch (readState)
+    {
+      // looking for table start
+      case RS_TABLE:
+      {
+        // start of table; advance to header read
+        if (lineType == WL_TABLE_START) readState = RS_HEADER;
+        // else swallow unknown line
+      }
+      break;
+
+      // looking for headers
+      case RS_HEADER:
+      {
+        if (lineType == WL_ROW_SEP)
+        {
+          // end of header row; advance to row read state
+          if (!headerM.empty()) readState = RS_DATA;
+          // else must be caption-header separator
+        }
+        else if (lineType == WL_HEADER)
+        {
+          // this line contains one or more column headers
+          // tokenize everything after the first character by "!!" in case of multiple headers in this line
+          Split(line.substr(1), "!!", headerM);
+        }
+        else if (lineType == WL_DATA)
+        {
+          // data before any header row: the table is headerless (Normalize() pads the header with empty values),
+          //  and this line starts its first data row
+          readState = RS_DATA;
+          rowOpen = true;
+          Split(line.substr(1), "||", row);
+        }
+        // end of a table with no data rows
+        else if (lineType == WL_TABLE_END) readState = RS_DONE;
+        // else swallow unknown line
+      }
+      break;
+
+      // looking for regular cell data within a row
+      case RS_DATA:
+      {
+        switch (lineType)
+        {
+          // end of row data
+          case WL_ROW_SEP: closeRow(); break;
+          // end of table
+          case WL_TABLE_END: closeRow(); readState = RS_DONE; break;
+          // this line contains one or more row data cells
+          // tokenize everything after the first character by "||" in case of multiple cells in this line
+          case WL_CAPTION:
+          case WL_DATA:
+          {
+            rowOpen = true;
+            Split(line.substr(1), "||", row);
+          }
+          break;
+          // else swallow unknown line
+          default: break;
+        }
+      }
+      break;
+
+      case RS_DONE: break;
+    }
+  }
+  closeRow();
+  if (statsM) timer.Count(text.length(), dataM.size(), CountCells());
   Normalize();
 }
 
+void TableS::FindWikiTables(const CellT text, std::vector<WikiTableS>& tables)
+{
+  tables.clear();
+  // tables not closed yet, innermost last, as indexes into tables
+  std::vector<std::size_t> open;
+  std::size_t lineStart(0);
+  while (lineStart < text.length())
+  {
+    const char* const newline(
+      static_cast<const char*>(std::memchr(text.data() + lineStart, '\n', text.length() - lineStart)));
+    const std::size_t lineEnd(newline ? static_cast<std::size_t>(newline - text.data()) + 1 : text.length());
+    const CellT line(text.substr(lineStart, lineEnd - lineStart));
+    switch (ClassifyWikiLine(line))
+    {
+      case WL_TABLE_START:
+      {
+        // runs to the end of text unless closed
+        open.push_back(tables.size());
+        tables.push_back(WikiTableS{text.substr(lineStart), CellT(), open.size() - 1});
+      }
+      break;
+
+      case WL_CAPTION:
+      {
+        if (!open.empty() && tables[open.back()].captionM.empty()) tables[open.back()].captionM = Strip(line.substr(2));
+      }
+      break;
+
+      case WL_TABLE_END:
+      {
+        if (open.empty()) break;
+        CellT& tableText(tables[open.back()].textM);
+        tableText = tableText.substr(0, lineEnd - static_cast<std::size_t>(tableText.data() - text.data()));
+        open.pop_back();
+      }
+      break;
+
+      default: break;
+    }
+    lineStart = lineEnd;
+  }
+}
+
+void TableS::ParseWikiTables(const std::vector<CellT>& texts, const unsigned threads, std::vector<TableS>& tables)
+{
+  tables.clear();
+  tables.resize(texts.size());
+  // tables vary widely in size, so each thread takes the next unparsed one as it becomes free, rather than a fixed
+  //  share of them
+  std::atomic<std::size_t> next(0);
+  ParallelS::Run(ParallelS::NumThreads(threads, texts.size(), 1), [&texts, &tables, &next](const std::size_t)
+  {
+    for (std::size_t tableNum(next++); tableNum < texts.size(); tableNum = next++)
+    {
+      tables[tableNum].ParseWiki(texts[tableNum]);
+    }
+  });
+}
+
 void TableS::PrintTSV() const
 {
+  StatsS::TimerS timer(statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintTSV(out);
+  out.Flush();
+}
+
+void TableS::PrintTSV(OutputS& out) const
+{
+  StatsS::TimerS timer(statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
   // now print the header row (if non-empty)
   if (!headerM.empty())
   {
@@ -137,11 +856,11 @@ void TableS::PrintTSV() const
     for (ColListT::const_iterator clCiter(headerM.begin());
          clCiter != headerM.end(); ++clCiter)
     {
-      if (prependTab) std::cout << "\t";
+      if (prependTab) out << '\t';
       else            prependTab = true;
-      std::cout << *clCiter;
+      out << *clCiter;
     }
-    std::cout << "\n";
+    out << '\n';
   }
   // now print the data rows
   for (RowListT::const_iterator rlCiter(dataM.begin());
@@ -151,204 +870,667 @@ void TableS::PrintTSV() const
     for (ColListT::const_iterator clCiter(rlCiter->begin());
          clCiter != rlCiter->end(); ++clCiter)
     {
-      if (prependTab) std::cout << "\t";
+      if (prependTab) out << '\t';
       else            prependTab = true;
-      std::cout << *clCiter;
+      out << *clCiter;
     }
-    std::cout << "\n";
+    // tabs before the missing trailing (empty) cells of a short row
+    for (std::size_t col(rlCiter->size()); col < numColsM; ++col) out << '\t';
+    out << '\n';
   }
+  timer.Count(out.BytesWritten() - startBytes, dataM.size(), (dataM.size() + 1) * numColsM);
 }
 
 void TableS::PrintWiki() const
+{
+  StatsS::TimerS timer(statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintWiki(out);
+  out.Flush();
+}
+
+void TableS::PrintWiki(OutputS& out) const
+{
+  StatsS::TimerS timer(statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  PrintWikiStart(headerM, headerM.size(), out);
+  for (RowListT::const_iterator rlCiter(dataM.begin());
+       rlCiter != dataM.end(); ++rlCiter)
+  {
+    PrintWikiRow(*rlCiter, numColsM, out);
+  }
+  PrintWikiEnd(out);
+  timer.Count(out.BytesWritten() - startBytes, dataM.size(), (dataM.size() + 1) * numColsM);
+}
+
+void TableS::PrintSnapshot() const
+{
+  StatsS::TimerS timer(statsM, StatsS::PH_EMIT);
+  OutputS out(OutputS::FD_STDOUT);
+  PrintSnapshot(out);
+  out.Flush();
+}
+
+void TableS::PrintSnapshot(OutputS& out) const
+{
+  StatsS::TimerS timer(statsM, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  // row 0 is the header, padded to the table width
+  SnapshotS::Write(numColsM, dataM.size() + 1,
+                   [this](const std::size_t row) { return row ? dataM[row - 1].size() : numColsM; },
+                   [this](const std::size_t row, const std::size_t col)
+                   {
+                     return row ? dataM[row - 1][col] : col < headerM.size() ? headerM[col] : CellT();
+                   },
+                   out);
+  if (statsM) timer.Count(out.BytesWritten() - startBytes, dataM.size(), CountCells());
+}
+
+void TableS::PrintWikiStart(const ColListT& header, const std::size_t numCols, OutputS& out)
 {
   // print table start, caption, separator
-  std::cout << "{| class=\"wikitable sortable\"\n";
-  std::cout << "|+ Games for IBM PC compatibles with MT-32 support\n";
-  std::cout << "|-\n";
+  out << "{| class=\"wikitable sortable\"\n";
+  out << "|+ Games for IBM PC compatibles with MT-32 support\n";
+  out << "|-\n";
   // print the header values
-  for (ColListT::const_iterator clCiter(headerM.begin());
-       clCiter != headerM.end(); ++clCiter)
+  for (std::size_t colNum(0); colNum < numCols; ++colNum)
   {
-    // std::cout << "! scope=\"col\" | " << *clCiter << "\n";
-    std::cout << "! " << *clCiter << "\n";
+    // out << "! scope=\"col\" | " << header[colNum] << "\n";
+    out << "! " << (colNum < header.size() ? header[colNum] : CellT()) << "\n";
   }
-  // print the row data
-  //  loop over rows
-  for (RowListT::const_iterator rlCiter(dataM.begin());
-       rlCiter != dataM.end(); ++rlCiter)
+}
+
+void TableS::PrintWikiRow(const ColListT& row, const std::size_t numCols, OutputS& out)
+{
+  // write a row separator line
+  out << "|-\n";
+  // loop over columns within row, treating any beyond the end of it as empty
+  const std::size_t rowCols(std::max(numCols, row.size()));
+  for (std::size_t colNum(0); colNum < rowCols; ++colNum)
   {
-    // write a row separator line
-    std::cout << "|-\n";
-    // loop over columns within row
-    std::size_t colNum(0);
-    for (ColListT::const_iterator clCiter(rlCiter->begin());
-         clCiter != rlCiter->end(); ++clCiter, ++colNum)
+    const CellT cell(colNum < row.size() ? row[colNum] : CellT());
+    // write title column on its own row, followed by start of next row
+    switch (colNum)
     {
-      // write title column on its own row, followed by start of next row
-      switch (colNum)
+      case 0: // title column
       {
-        case 0: // title column
-        {
-          // write pipe, data, newline
-          std::cout << "|" << *clCiter << std::endl;
-        }
-        break;
+        // write pipe, data, newline
+        out << "|" << cell << "\n";
+      }
+      break;
+
+      case 1: // first column of remaining data
+      {
+        // prepend with single pipe
+        out << "|";
+        // write data, or space if empty
+        if (cell.empty()) out << " ";
+        else              out << cell;
+        // no newline
+      }
+      break;
 
-        case 1: // first column of remaining data
+      default: // remaining columns
+      {
+        // prepend with double pipe
+        out << "||";
+        // write data, or space if empty
+        if (cell.empty()) out << " ";
+        else              out << cell;
+      }
+    }
+  }
+  out << "\n"; // end of row
+}
+
+void TableS::PrintWikiEnd(OutputS& out)
+{
+  // print table end
+  out << "|}\n";
+}
+
+std::size_t TableS::StreamTSVToWiki(const std::string& filename, const bool twoPass, OutputS& out,
+                                    StatsS* const stats)
+{
+  BlockReaderS reader(filename, true, PIPELINE_BLOCKS);
+  if (IsSnapshot(filename, reader))
+  {
+    // a file is mapped instead of read through blocks, but stdin can only be read from where the peek left off
+    MappedFileS inFile;
+    std::string stdinText;
+    CellT data;
+    if (filename == MappedFileS::STDIN_NAME)
+    {
+      stdinText = ReadAll(reader, stats);
+      data = stdinText;
+    }
+    else
+    {
+      reader.Stop();
+      StatsS::TimerS timer(stats, StatsS::PH_READ);
+      inFile.Open(filename);
+      data = inFile.View();
+      timer.Count(data.length(), 0, 0);
+    }
+    std::optional<SnapshotS> snapshot;
+    {
+      StatsS::TimerS timer(stats, StatsS::PH_TOKENIZE);
+      snapshot.emplace(data);
+      timer.Count(data.length(), 0, 0);
+    }
+    StatsS::TimerS timer(stats, StatsS::PH_EMIT);
+    const std::size_t startBytes(out.BytesWritten());
+    ColListT row;
+    for (std::size_t rowNum(0); rowNum < snapshot->NumRows(); ++rowNum)
+    {
+      row.clear();
+      for (std::size_t cell(snapshot->RowBegin(rowNum)); cell < snapshot->RowEnd(rowNum); ++cell)
+      {
+        row.push_back(snapshot->Cell(cell));
+      }
+      if (rowNum) PrintWikiRow(row, snapshot->NumCols(), out);
+      else        PrintWikiStart(row, snapshot->NumCols(), out);
+    }
+    PrintWikiEnd(out);
+    timer.Count(out.BytesWritten() - startBytes, snapshot->NumRows(), snapshot->NumCells());
+    return 0;
+  }
+  // optional first pass: find the widest row, counting cells only
+  std::size_t numCols(0);
+  if (twoPass)
+  {
+    if (filename == MappedFileS::STDIN_NAME)
+    {
+      throw std::runtime_error("Two-pass streaming needs an input file that can be read twice, not stdin");
+    }
+    WidthSinkS widthSink;
+    ForEachChunk(filename, stats, [&widthSink, stats](const CellT chunk)
+    {
+      StatsS::TimerS timer(stats, StatsS::PH_TOKENIZE);
+      TokenizeTSV(chunk, widthSink);
+      timer.Count(chunk.length(), 0, 0);
+    });
+    numCols = widthSink.maxColsM;
+  }
+  // main pass: print each row as it's read, padded to the header width, in a pipeline of three stages with bounded
+  //  queues between them: the reader thread fills blocks, a tokenizer thread splits each into a batch of rows, and
+  //  this thread prints them
+  bool readingHeader(true);
+  std::size_t wideRows(0);
+  std::size_t rows(0);
+  std::size_t cells(0);
+  auto rowFunc([&](const ColListT& row)
+  {
+    ++rows;
+    cells += row.size();
+    if (readingHeader)
+    {
+      if (row.size() > numCols) numCols = row.size();
+      PrintWikiStart(row, numCols, out);
+      readingHeader = false;
+      return;
+    }
+    if (row.size() > numCols) ++wideRows;
+    PrintWikiRow(row, numCols, out);
+  });
+  StatsS::TimerS timer(stats, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  if (std::thread::hardware_concurrency() < 2)
+  {
+    // with a single CPU, the tokenizing and printing stages would only take turns, so this thread does both
+    RowSinkS<decltype(rowFunc)> rowSink(rowFunc);
+    for (;;)
+    {
+      BlockReaderS::BlockS* const block(reader.Next());
+      if (!block) break;
+      TokenizeTSV(block->View(), rowSink);
+      reader.Release(block);
+    }
+  }
+  else
+  {
+    RowBatchS batches[PIPELINE_BATCHES];
+    ChannelS<RowBatchS*> fullBatches(PIPELINE_BATCHES);
+    ChannelS<RowBatchS*> freeBatches(PIPELINE_BATCHES);
+    for (RowBatchS& batch : batches) freeBatches.Push(&batch);
+    std::exception_ptr tokenizeError;
+    std::thread tokenizeThread([&reader, &fullBatches, &freeBatches, &tokenizeError]()
+    {
+      try
+      {
+        for (;;)
         {
-          // prepend with single pipe
-          std::cout << "|";
-          // write data, or space if empty
-          if (clCiter->empty()) std::cout << " ";
-          else                   std::cout << *clCiter;
-          // no newline
+          BlockReaderS::BlockS* const block(reader.Next());
+          if (!block) break;
+          RowBatchS* batch(nullptr);
+          if (!freeBatches.Pop(batch)) break;
+          batch->Reset(block);
+          TokenizeTSV(block->View(), *batch);
+          if (!fullBatches.Push(std::move(batch))) break;
         }
-        break;
-
-        default: // remaining columns
+      }
+      catch (...)
+      {
+        tokenizeError = std::current_exception();
+      }
+      fullBatches.Close();
+    });
+    try
+    {
+      ColListT row;
+      RowBatchS* batch(nullptr);
+      while (fullBatches.Pop(batch))
+      {
+        std::size_t rowStart(0);
+        for (const std::size_t rowEnd : batch->rowEndsM)
         {
-          // prepend with double pipe
-          std::cout << "||";
-          // write data, or space if empty
-          if (clCiter->empty()) std::cout << " ";
-          else                   std::cout << *clCiter;
+          row.assign(batch->cellsM.begin() + rowStart, batch->cellsM.begin() + rowEnd);
+          rowFunc(row);
+          rowStart = rowEnd;
         }
+        reader.Release(batch->blockM);
+        freeBatches.Push(std::move(batch));
       }
     }
-    std::cout << "\n"; // end of row
+    catch (...)
+    {
+      // unblock the other stages wherever they're waiting, so that they stop
+      reader.Stop();
+      fullBatches.Close();
+      freeBatches.Close();
+      tokenizeThread.join();
+      throw;
+    }
+    tokenizeThread.join();
+    if (tokenizeError) std::rethrow_exception(tokenizeError);
   }
-  // print table end
-  std::cout << "|}\n";
+  // empty file still gets an (empty) table
+  if (readingHeader) PrintWikiStart(ColListT(), numCols, out);
+  PrintWikiEnd(out);
+  timer.Count(out.BytesWritten() - startBytes, rows, cells);
+  return wideRows;
+}
+
+TableS::CellT TableS::StoreCell(std::string&& value)
+{
+  if (useArenasM && value.length() <= MAX_ARENA_CELL) return StoreCell({CellT(value)});
+  cellPoolM.push_back(std::move(value));
+  return cellPoolM.back();
+}
+
+TableS::CellT TableS::StoreCell(const std::initializer_list<CellT> parts)
+{
+  std::size_t length(0);
+  for (const CellT part : parts) length += part.length();
+  if (!useArenasM || length > MAX_ARENA_CELL)
+  {
+    std::string value;
+    value.reserve(length);
+    for (const CellT part : parts) value.append(part);
+    cellPoolM.push_back(std::move(value));
+    return cellPoolM.back();
+  }
+  if (!cellArenaM)
+  {
+    arenasM.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>());
+    cellArenaM = arenasM.back().get();
+  }
+  char* const data(static_cast<char*>(cellArenaM->allocate(length ? length : 1, 1)));
+  std::size_t offset(0);
+  for (const CellT part : parts)
+  {
+    if (part.empty()) continue;
+    std::memcpy(data + offset, part.data(), part.length());
+    offset += part.length();
+  }
+  return CellT(data, length);
+}
+
+std::pmr::memory_resource* TableS::NewArena(const std::size_t initialSize)
+{
+  if (!useArenasM) return std::pmr::new_delete_resource();
+  arenasM.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>(std::max<std::size_t>(initialSize, 1)));
+  return arenasM.back().get();
+}
+
+std::size_t TableS::CountCells() const
+{
+  std::size_t cells(headerM.size());
+  for (const ColListT& row : dataM) cells += row.size();
+  return cells;
+}
+
+TableS::CellT TableS::StripCell(const CellT cell)
+{
+  return Strip(cell);
+}
+
+bool TableS::CleanTitleCell(CellT& cell)
+{
+  // strip cell
+  cell = Strip(cell);
+  // do nothing if empty
+  if (cell.empty()) return false;
+  // prepend with italic markup if needed
+  if (cell.substr(0, MARKUP_ITALIC.length()) != MARKUP_ITALIC)
+  {
+    // append with italic markup if needed (a lone quote is completed by the prepended markup)
+    const bool endsItalic(cell.length() < MARKUP_ITALIC.length() ? cell == "'" :
+      cell.substr(cell.length() - MARKUP_ITALIC.length(), MARKUP_ITALIC.length()) == MARKUP_ITALIC);
+    cell = StoreCell({MARKUP_ITALIC, cell, endsItalic ? CellT() : CellT(MARKUP_ITALIC)});
+    return true;
+  }
+  // append with italic markup if needed
+  if (cell.substr(cell.length() - MARKUP_ITALIC.length(), MARKUP_ITALIC.length()) != MARKUP_ITALIC)
+  {
+    cell = StoreCell({cell, MARKUP_ITALIC});
+    return true;
+  }
+  return false;
+}
+
+bool TableS::CleanCheckCell(CellT& cell)
+{
+  // strip cell
+  cell = Strip(cell);
+  // check for mis-capitalized check markup
+  if (cell == "{{Ya}}" || cell == "{{yA}}" || cell == "{{YA}}")
+  {
+    cell = MARKUP_CHECK_YES;
+    return true;
+  }
+  return false;
 }
 
 void TableS::WikiTitleClean()
 {
+  StatsS::TimerS timer(statsM, StatsS::PH_CLEAN);
+  // number of cells rewritten, for stats
+  std::size_t changed(0);
   // loop over rows
   for (RowListT::iterator rlIter(dataM.begin());
        rlIter != dataM.end(); ++rlIter)
   {
-    // loop over columns within row
-    bool firstCol(true);
-    for (ColListT::iterator rowIter(rlIter->begin());
-         rowIter != rlIter->end(); ++rowIter)
-    {
-      std::string& cell(*rowIter);
-      // strip cell
-      cell = Strip(cell);
-      // perform context-specific tasks
-      if (firstCol)
-      {
-        // title column; italicize if needed
-        // do nothing if empty
-        if (cell.empty()) continue;
-        // prepend with italic markup if needed
-        if (cell.substr(0, MARKUP_ITALIC.length()) != MARKUP_ITALIC)
-          cell.insert(0, MARKUP_ITALIC);
-        // append with italic markup if needed
-        if (cell.substr(cell.length() - MARKUP_ITALIC.length(), MARKUP_ITALIC.length()) != MARKUP_ITALIC)
-          cell.append(MARKUP_ITALIC);
-        firstCol = false;
-        continue;
-      }
+    changed += CleanRow(*rlIter);
+  }
+  timer.Count(0, dataM.size(), changed);
+}
 
-      // non-title column
-      // check for mis-capitalized check markup
-      if (cell == "{{Ya}}" || cell == "{{yA}}" || cell == "{{YA}}")
-      {
-        cell = "{{ya}}";
-      }
+std::size_t TableS::CleanRow(ColListT& row)
+{
+  std::size_t changed(0);
+  // loop over columns within row
+  bool firstCol(true);
+  for (ColListT::iterator rowIter(row.begin());
+       rowIter != row.end(); ++rowIter)
+  {
+    CellT& cell(*rowIter);
+    // perform context-specific tasks
+    if (firstCol)
+    {
+      // title column; an empty one leaves the next column to be treated as the title
+      if (CleanTitleCell(cell)) ++changed;
+      if (!cell.empty()) firstCol = false;
+      continue;
     }
+    // non-title column
+    if (CleanCheckCell(cell)) ++changed;
   }
+  return changed;
 }
 
 void TableS::WikiTitleSort()
 {
+  StatsS::TimerS timer(statsM, StatsS::PH_SORT);
   // clean titles so that we can make assumptions
   WikiTitleClean();
-  // derive sort key from title column, then insert row into map by key
-  std::map<std::string, ColListT> sortMap;
-  for (auto rlIter(dataM.begin()); rlIter != dataM.end(); ++rlIter)
-  {
-    const std::string& title(rlIter->at(0));
-    std::string key;
-    // 5 cases are currently supported:
-    // ''[[...|KEY]]''
-    // ''[[KEY]]''
-    // ''{{ill|...|lt=KEY|...}}''
-    // ''{{ill|KEY|...}}''
-    // falls back on entire string if none of these apply
-    std::size_t keyStart(0);
-    std::size_t keyEnd(std::string::npos);
-    if (title.substr(0, 4) == "''[[")
-    {
-      // type 1 or 2; look for pipe
-      keyStart = title.find_last_of('|');
-      if (keyStart == std::string::npos)
-      {
-        // no pipe; this is type 2
-        keyStart = 4;
-      }
-      else
-      {
-        // this is type 1; key starts after pipe
-        ++keyStart;
-      }
-      keyEnd = title.length() - 4;
+  std::vector<SortEntryS> entries;
+  std::vector<std::string> keyArenas;
+  SortRows(dataM, ParallelS::NumThreads(threadsM, dataM.size(), MIN_SORT_ROWS), foldM, entries, keyArenas);
+  timer.Count(0, dataM.size(), 0);
+}
+
+bool TableS::WikiTitleSort(const std::string& indexFilename)
+{
+  StatsS::TimerS timer(statsM, StatsS::PH_SORT);
+  WikiTitleClean();
+  const std::size_t numRows(dataM.size());
+  const std::size_t threads(ParallelS::NumThreads(threadsM, numRows, MIN_SORT_ROWS));
+  // hash each row's title, and sort the hashes, so that they can be matched against the index's in a single pass
+  std::vector<SortIndexS::EntryS> rowHashes(numRows);
+  ParallelS::Run(threads, [this, threads, numRows, &rowHashes](const std::size_t part)
+  {
+    for (std::size_t rowNum(numRows * part / threads); rowNum < numRows * (part + 1) / threads; ++rowNum)
+    {
+      rowHashes[rowNum] = SortIndexS::EntryS{SortIndexS::Hash(Cell(dataM[rowNum], 0)), rowNum};
     }
-    else if (title.substr(0, 8) == "''{{ill|")
+  });
+  SortIndexS::SortByHash(rowHashes);
+  SortIndexS index;
+  const bool loaded(index.Load(indexFilename, foldM));
+  // rank of each row's title in the index, and the rows whose titles it doesn't have, in input order
+  const std::size_t numRanks(index.NumRanks());
+  std::vector<std::size_t> rowRanks(numRows, NO_RANK);
+  std::vector<std::size_t> changed;
+  // number of index entries matched by at least one row; if all are, and no row is unmatched, the index is current
+  std::size_t matchedEntries(0);
+  std::size_t entryNum(0);
+  for (const SortIndexS::EntryS& row : rowHashes)
+  {
+    for (; entryNum < index.NumEntries() && index.Entry(entryNum).hashM < row.hashM; ++entryNum) {}
+    if (entryNum < index.NumEntries() && index.Entry(entryNum).hashM == row.hashM)
     {
-      // type 3 or 4; look for link text sequence
-      keyStart = title.find("|lt=", 7);
-      if (keyStart == std::string::npos)
-      {
-        // no link text sequence; this is type 4
-        keyStart = 8;
-      }
-      else
-      {
-        // this is type 3; key starts after link text sequence
-        keyStart += 4;
-      }
-      // key ends just before next pipe
-      // TODO: this isn't very robust
-      keyEnd = title.find("|", keyStart) - 1;
+      if (&row == rowHashes.data() || (&row)[-1].hashM != row.hashM) ++matchedEntries;
+      rowRanks[row.valueM] = index.Entry(entryNum).valueM;
     }
     else
     {
-      // unknown type; grab the whole thing
-      keyStart = 0;
-      keyEnd = title.length() - 1;
+      changed.push_back(row.valueM);
     }
-    // increase keyStart if it's pointing at quotes
-    if (title.substr(keyStart, 2) == "''") keyStart += 2;
-    // decrease keyEnd if it's pointing at quotes
-    if (title.substr(keyEnd - 1, 2) == "''") keyEnd -= 2;
-    // extract the key
-    key = title.substr(keyStart, keyEnd - keyStart);
-    // now move any leading articles to the end
-    if (key.substr(0, 2) == "A ")
+  }
+  std::sort(changed.begin(), changed.end());
+  // ranked keys and title entries of the updated index; the entries are listed from rowHashes once every row's
+  //  (new) rank is known
+  std::vector<CellT> rankKeys;
+  std::vector<SortIndexS::EntryS> entries;
+  auto listEntries([&rowHashes, &rowRanks, &entries]()
+  {
+    for (const SortIndexS::EntryS& row : rowHashes)
     {
-      key = key.substr(2, key.length() - 2).append(", A");
+      if (entries.empty() || entries.back().hashM != row.hashM) entries.push_back({row.hashM, rowRanks[row.valueM]});
     }
-    else if (key.substr(0, 3) == "An ")
+  });
+  // fall back on a full sort without a usable index, or if so much has changed that it would be about as quick
+  if (!loaded || changed.size() > numRows / MAX_CHANGED_FRACTION)
+  {
+    std::vector<SortEntryS> sortEntries;
+    std::vector<std::string> keyArenas;
+    SortRows(dataM, threads, foldM, sortEntries, keyArenas);
+    for (const SortEntryS& entry : sortEntries)
     {
-      key = key.substr(3, key.length() - 3).append(", An");
+      if (rankKeys.empty() || rankKeys.back() != entry.keyM) rankKeys.push_back(entry.keyM);
+      rowRanks[entry.rowM] = rankKeys.size() - 1;
     }
-    else if (key.substr(0, 4) == "The ")
+    listEntries();
+    SortIndexS::Save(indexFilename, foldM, entries, rankKeys);
+    timer.Count(0, numRows, numRows);
+    return false;
+  }
+  // key the changed rows; those whose key is already ranked join that rank, and the rest are sorted among
+  //  themselves, to be slotted in between ranks
+  std::string keyArena;
+  std::size_t arenaSize(0);
+  for (const std::size_t rowNum : changed) arenaSize += TitleKeyS::MaxLength(Cell(dataM[rowNum], 0).length());
+  keyArena.reserve(arenaSize);
+  std::vector<SortEntryS> added;
+  for (const std::size_t rowNum : changed)
+  {
+    const std::size_t keyStart(keyArena.length());
+    TitleKeyS::Append(Cell(dataM[rowNum], 0), keyArena, foldM);
+    const CellT key(keyArena.data() + keyStart, keyArena.length() - keyStart);
+    std::size_t lo(0);
+    std::size_t hi(numRanks);
+    while (lo < hi)
+    {
+      const std::size_t mid(lo + (hi - lo) / 2);
+      if (index.RankKey(mid) < key) lo = mid + 1;
+      else                          hi = mid;
+    }
+    if (lo < numRanks && index.RankKey(lo) == key) rowRanks[rowNum] = lo;
+    else                                           added.push_back(SortEntryS{key, rowNum});
+  }
+  // (changed rows are in input order, so a stable sort keeps rows with equal keys in it)
+  std::stable_sort(added.begin(), added.end());
+  // bucket ranked rows by rank, in input order
+  std::vector<std::size_t> rankStart(numRanks + 1, 0);
+  for (const std::size_t rank : rowRanks)
+  {
+    if (rank != NO_RANK) ++rankStart[rank + 1];
+  }
+  for (std::size_t rank(1); rank <= numRanks; ++rank) rankStart[rank] += rankStart[rank - 1];
+  std::vector<std::size_t> byRank(rankStart[numRanks]);
+  {
+    std::vector<std::size_t> fill(rankStart.begin(), rankStart.end() - 1);
+    for (std::size_t rowNum(0); rowNum < numRows; ++rowNum)
     {
-      key = key.substr(4, key.length() - 4).append(", The");
+      if (rowRanks[rowNum] != NO_RANK) byRank[fill[rowRanks[rowNum]]++] = rowNum;
     }
-    // convert key to uppercase
-    std::transform(key.begin(), key.end(), key.begin(), ::toupper);
-    // we now have a fully-formed key
-    // swap row into map by key
-    sortMap[key].swap(*rlIter);
   }
-  // we've built a sorted map; swap entries back into the table
-  auto rlIter(dataM.begin());
-  auto smIter(sortMap.begin());
-  for (; smIter != sortMap.end(); ++smIter, ++rlIter)
+  // now interleave the ranks with the added rows, which go before the first rank with a greater key, renumbering
+  //  ranks for the updated index along the way (ranks no row has any more are dropped)
+  RowListT sorted;
+  sorted.reserve(numRows);
+  auto addRow([this, &sorted, &rankKeys, &rowRanks](const std::size_t rowNum, const CellT key)
+  {
+    sorted.push_back(std::move(dataM[rowNum]));
+    if (rankKeys.empty() || rankKeys.back() != key) rankKeys.push_back(key);
+    rowRanks[rowNum] = rankKeys.size() - 1;
+  });
+  std::size_t addedNum(0);
+  for (std::size_t rank(0); rank < numRanks; ++rank)
+  {
+    const CellT key(index.RankKey(rank));
+    for (; addedNum < added.size() && added[addedNum].keyM < key; ++addedNum)
+    {
+      addRow(added[addedNum].rowM, added[addedNum].keyM);
+    }
+    for (std::size_t pos(rankStart[rank]); pos < rankStart[rank + 1]; ++pos) addRow(byRank[pos], key);
+  }
+  for (; addedNum < added.size(); ++addedNum) addRow(added[addedNum].rowM, added[addedNum].keyM);
+  dataM.swap(sorted);
+  // the index only needs rewriting if titles have come or gone
+  if (!changed.empty() || matchedEntries != index.NumEntries())
+  {
+    listEntries();
+    SortIndexS::Save(indexFilename, foldM, entries, rankKeys);
+  }
+  timer.Count(0, numRows, changed.size());
+  return true;
+}
+
+void TableS::SortTSVExternal(const std::string& filename, const std::size_t memBudget, const unsigned threads,
+                             const TitleKeyS::FoldE fold, OutputS& out, StatsS* const stats)
+{
+  BlockReaderS reader(filename, true);
+  if (IsSnapshot(filename, reader))
+  {
+    TableS table;
+    table.threadsM = threads;
+    table.statsM = stats;
+    table.foldM = fold;
+    // a file is mapped instead of read through blocks, but stdin can only be read from where the peek left off
+    if (filename == MappedFileS::STDIN_NAME)
+    {
+      table.ParseSnapshot(table.StoreCell(ReadAll(reader, stats)));
+    }
+    else
+    {
+      reader.Stop();
+      table.LoadTSV(filename);
+    }
+    table.WikiTitleSort();
+    table.PrintTSV(out);
+    return;
+  }
+  const std::size_t runBytes(std::max<std::size_t>(memBudget / 4, 1));
+  // header row, as a TSV line
+  std::string headerLine;
+  // maximum column count across all rows read so far
+  std::size_t numCols(0);
+  // sorted runs spilled so far
+  std::vector<FilePtrT> runFiles;
+  // most recently loaded run
+  TableS run;
+  run.threadsM = threads;
+  run.statsM = stats;
+  run.foldM = fold;
+  // load and sort each run; spill all but the last one
+  std::string runText;
+  bool firstRun(true);
+  auto loadRun([&]()
+  {
+    run.LoadTSVText(std::move(runText), firstRun);
+    runText = std::string();
+    run.WikiTitleSort();
+    numCols = std::max(numCols, run.headerM.size());
+    if (firstRun)
+    {
+      AppendTSVLine(run.headerM, headerLine);
+      headerLine.pop_back();
+      firstRun = false;
+    }
+  });
+  ForEachChunk(reader, stats, [&](const CellT chunk)
+  {
+    // spill once the run would outgrow its share of the budget
+    // runs end on chunk boundaries, which are always at the end of a line
+    if (!runText.empty() && runText.length() + chunk.length() > runBytes)
+    {
+      loadRun();
+      StatsS::TimerS timer(stats, StatsS::PH_EMIT);
+      runFiles.push_back(WriteRunFile(run.dataM));
+      run.Clear();
+    }
+    StatsS::TimerS timer(stats, StatsS::PH_READ);
+    runText.append(chunk);
+  });
+  loadRun();
+  // if everything fit in one run, just print it
+  if (runFiles.empty())
+  {
+    run.PrintTSV(out);
+    return;
+  }
+  // otherwise spill the last run too, and merge
+  StatsS::TimerS timer(stats, StatsS::PH_EMIT);
+  const std::size_t startBytes(out.BytesWritten());
+  runFiles.push_back(WriteRunFile(run.dataM));
+  run.Clear();
+  // print header row, padded to the full table width
+  PrintPaddedLine(headerLine, numCols, out);
+  // k-way merge all runs with a heap ordered on (key, run number), so that equal keys come out in input order
+  std::vector<RunReaderS> readers;
+  readers.reserve(runFiles.size());
+  const std::size_t readBufferSize(std::max<std::size_t>(memBudget / 2 / runFiles.size(), 1 << 16));
+  for (const FilePtrT& runFile : runFiles) readers.emplace_back(runFile.get(), readBufferSize, fold);
+  auto later([&readers](const std::size_t a, const std::size_t b)
+  {
+    const int order(readers[a].keyM.compare(readers[b].keyM));
+    return order > 0 || (order == 0 && a > b);
+  });
+  std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)> heap(later);
+  for (std::size_t runNum(0); runNum < readers.size(); ++runNum)
+  {
+    if (readers[runNum].Next()) heap.push(runNum);
+  }
+  std::size_t rows(0);
+  while (!heap.empty())
   {
-    rlIter->swap(smIter->second);
+    const std::size_t runNum(heap.top());
+    heap.pop();
+    PrintPaddedLine(readers[runNum].lineM, numCols, out);
+    ++rows;
+    if (readers[runNum].Next()) heap.push(runNum);
   }
+  timer.Count(out.BytesWritten() - startBytes, rows, rows * numCols);
 }
@@ -1,19 +1,60 @@
 #ifndef TABLES_H
 #define TABLES_H
 
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "MappedFileS.h"
+#include "TitleKeyS.h"
+
+struct OutputS;
+struct StatsS;
+
 // utility class for modeling and managing a data table
+// cells are views into storage owned by the table: normally the memory-mapped input file, plus a pool of strings
+//  for the (few) cell values that had to be rewritten
+// row cell lists use polymorphic allocators; rows created by the table are allocated at their exact size from
+//  monotonic arenas owned by the table (one per thread that filled it), so that loading a table doesn't make one heap
+//  allocation per row, rows are packed together in memory, and releasing them is a few frees rather than millions
+// tables are therefore movable but not copyable
 struct TableS
 {
-  typedef std::vector<std::string> ColListT;
-  typedef std::vector<ColListT>    RowListT;
+  typedef std::string_view           CellT;
+  typedef std::pmr::vector<CellT>    ColListT;
+  typedef std::vector<ColListT>      RowListT;
 
   // list of column headers
   ColListT headerM;
   // list of table data rows, each containing a list of column data values for that row
+  // rows may be shorter than numColsM; their missing trailing cells read as empty
   RowListT dataM;
+  // logical column count of header and data rows, maintained as rows are loaded; code that adds rows to dataM
+  //  directly must widen it to match
+  std::size_t numColsM;
+  // contents of the most recently loaded input file
+  MappedFileS inputM;
+  // owned storage for cell values that don't exist verbatim in the input file
+  // a deque, so that existing entries never move as new ones are added
+  std::deque<std::string> cellPoolM;
+  // arenas holding row cell lists and short owned cell values
+  // declared after the containers using them, so that moving a table into another releases the old rows first
+  std::vector<std::unique_ptr<std::pmr::monotonic_buffer_resource>> arenasM;
+  // arena used by StoreCell(), or nullptr if not created yet
+  std::pmr::monotonic_buffer_resource* cellArenaM;
+  // whether to use arenas (the default); if not, rows and owned cells are allocated individually on the heap
+  bool useArenasM;
+  // maximum number of worker threads used by table operations (0 means one per hardware thread)
+  unsigned threadsM;
+  // per-phase statistics collector for table operations, or nullptr (the default) to not collect any
+  StatsS* statsM;
+  // how WikiTitleSort() folds letters in title sort keys (default: by case only)
+  TitleKeyS::FoldE foldM;
 
   enum FileTypeE
   {
@@ -22,42 +63,201 @@ struct TableS
     FT_WIKI
   };
 
-  // construct a table instance from a file of the specified type
+  // construct an empty, single-threaded table instance
+  TableS();
+
+  // construct a table instance from a file of the specified type, using up to the given number of threads
   // throws std::runtime_error if file cannot be opened
   // automatically calls Normalize()
-  TableS(const std::string& filename, const FileTypeE fileType = FT_TSV);
+  TableS(const std::string& filename, const FileTypeE fileType = FT_TSV, unsigned threads = 1);
+
+  // releases rows before the arenas they're in
+  ~TableS();
+
+  TableS(TableS&&) = default;
+  TableS& operator=(TableS&&) = default;
+  TableS(const TableS&) = delete;
+  TableS& operator=(const TableS&) = delete;
 
-  // clear header and data contents
+  // clear header and data contents, and release all backing storage
   void Clear();
 
-  // normalize header and data rows to the same column count, by adding empty column values as needed
+  // normalize header and data rows to the same column count: widens numColsM to the header width, and pads the
+  //  header with empty values to numColsM
+  // data rows are not padded, but read as if they were (see Cell()), so this doesn't depend on the row count
   void Normalize();
 
+  // cell of a data row, or an empty value past the end of a short row
+  static CellT Cell(const ColListT& row, const std::size_t col) { return col < row.size() ? row[col] : CellT(); }
+
   // clear table and populate with data from TSV file
-  // throws std::runtime_error if file cannot be opened
+  // the file is memory-mapped (or read into a single buffer if it can't be), and cells are stored as whitespace-
+  //  stripped views into it, so no per-cell allocations are made
+  // large files are split into newline-aligned chunks that are tokenized in parallel, according to threadsM
+  // a table snapshot (see SnapshotS) is accepted in place of a TSV file, and loaded with ParseSnapshot()
+  // throws std::runtime_error if file cannot be opened, or is an invalid snapshot
   // automatically calls Normalize()
   void LoadTSV(const std::string& filename);
 
+  // clear table and populate with data from TSV text, taking ownership of it
+  // if hasHeader is false, all lines are treated as data rows (and the header is left empty, aside from padding)
+  // automatically calls Normalize()
+  void LoadTSVText(std::string&& text, bool hasHeader = true);
+
+  // populate (already cleared) table from TSV text that will outlive its contents; shared by the LoadTSV*() methods
+  // automatically calls Normalize()
+  void ParseTSV(CellT text, bool hasHeader);
+
+  // populate (already cleared) table from snapshot data that will outlive its contents
+  // cells are views into the snapshot's blob; only the row lists are built, in parallel according to threadsM
+  // throws std::runtime_error if data isn't a valid snapshot
+  void ParseSnapshot(CellT data);
+
+  // split TSV text into rows of cells as ParseTSV() does, handing each row to rowFunc in turn, without storing it
+  // the row passed is reused between calls
+  static void ForEachTSVRow(CellT text, const std::function<void(const ColListT&)>& rowFunc);
+
   // clear table and populate with data from wiki-formatted file
+  // reads the first table in the file, from its column header lines ("!") through its end ("|}"); as with LoadTSV(),
+  //  the file is memory-mapped and cells are views into it
   // throws std::runtime_error if file cannot be opened
   // automatically calls Normalize()
   void LoadWiki(const std::string& filename);
 
-  // print table to stdout in TSV format
+  // clear table and populate with data from wiki markup text, taking ownership of it
+  // automatically calls Normalize()
+  void LoadWikiText(std::string&& text);
+
+  // populate (already cleared) table from wiki markup text that will outlive its contents; shared by the
+  //  LoadWiki*() methods
+  // reads the first table in text; lines of any tables nested in it are skipped
+  // automatically calls Normalize()
+  void ParseWiki(CellT text);
+
+  // a table found in wiki markup by FindWikiTables()
+  struct WikiTableS
+  {
+    // its markup, from its "{|" line through the "|}" line that closes it (or the end of the text, if none does)
+    CellT       textM;
+    // the rest of its first "|+" line, stripped, or empty if it has no caption
+    CellT       captionM;
+    // number of tables it's nested in
+    std::size_t depthM;
+  };
+
+  // find every table in wiki markup text, in order of their "{|" lines, in a single pass that classifies each line
+  //  by its first two characters
+  // tables nested in others are found as well as the tables containing them, which they follow in tables
+  static void FindWikiTables(CellT text, std::vector<WikiTableS>& tables);
+
+  // replace tables with one table per entry of texts, parsed from its wiki markup (which must outlive them) with
+  //  ParseWiki()
+  // as the tables are independent of each other, up to the given number of them are parsed at once
+  static void ParseWikiTables(const std::vector<CellT>& texts, unsigned threads, std::vector<TableS>& tables);
+
+  // print table in TSV format, to stdout or the given output
+  // throws std::runtime_error on write failure
   void PrintTSV() const;
+  void PrintTSV(OutputS& out) const;
 
-  // print table to stdout in wiki format
+  // print table in wiki format, to stdout or the given output
+  // throws std::runtime_error on write failure
   void PrintWiki() const;
+  void PrintWiki(OutputS& out) const;
+
+  // write table as a binary snapshot (see SnapshotS), to stdout or the given output
+  // throws std::runtime_error on write failure
+  void PrintSnapshot() const;
+  void PrintSnapshot(OutputS& out) const;
+
+  // building blocks of PrintWiki(), for printing rows without first loading them into a table
+  // header and rows are padded with empty values to numCols columns; wider rows are printed in full
+  static void PrintWikiStart(const ColListT& header, std::size_t numCols, OutputS& out);
+  static void PrintWikiRow(const ColListT& row, std::size_t numCols, OutputS& out);
+  static void PrintWikiEnd(OutputS& out);
+
+  // print TSV file (or stdin, if it's MappedFileS::STDIN_NAME) to output in wiki format, one row at a time as it's
+  //  read, so that memory use doesn't depend on file size
+  // the file is read on a thread of its own, and (given more than one CPU) tokenized on another, so that reading,
+  //  tokenizing and printing overlap
+  // rows are padded to the header width; if twoPass is set, the file is first scanned for the widest row, so that
+  //  output is identical to LoadTSV() + PrintWiki() (this requires a file that can be read twice, so not stdin)
+  // a table snapshot is printed straight from its memory-mapped rows; as its header is already as wide as the
+  //  table, output is always that of two-pass mode
+  // returns the number of data rows that were wider than the header (always zero in two-pass mode)
+  // throws std::runtime_error if file cannot be opened or read, or if twoPass is set for stdin
+  // waiting for reads in the first pass is recorded in stats as the read phase, the rest of it as tokenize, and the
+  //  whole main pass as emit
+  static std::size_t StreamTSVToWiki(const std::string& filename, bool twoPass, OutputS& out,
+                                     StatsS* stats = nullptr);
+
+  // copy value into table-owned storage, and return a cell referencing it
+  // short values are copied into an arena; long ones (such as whole input texts) are kept as they are
+  CellT StoreCell(std::string&& value);
+
+  // concatenate parts into table-owned storage, and return a cell referencing the result
+  CellT StoreCell(std::initializer_list<CellT> parts);
+
+  // memory resource for allocating rows from a single thread: a new arena with the given initial size, or the heap if
+  //  arenas aren't in use
+  std::pmr::memory_resource* NewArena(std::size_t initialSize);
+
+  // total number of cells in header and data rows
+  std::size_t CountCells() const;
 
   // perform various cleanups for wiki export:
   // - strip leading/trailing whitespace from all cells
   // - ensure all title column values are italicized
   // - lowercase all checkbox column markup
+  // only cells whose value actually changes beyond stripping are given their own storage
   void WikiTitleClean();
 
+  // cell with leading and trailing whitespace removed, as all loaded cells are
+  static CellT StripCell(CellT cell);
+
+  // WikiTitleClean() treatment of a single title cell: strip it, and make sure it's italicized
+  // returns true if the value was rewritten beyond stripping, in which case it's given table-owned storage
+  bool CleanTitleCell(CellT& cell);
+
+  // WikiTitleClean() treatment of a single non-title cell: strip it, and lowercase checkbox markup
+  // returns true if the value was rewritten beyond stripping
+  static bool CleanCheckCell(CellT& cell);
+
+  // WikiTitleClean() treatment of a single data row: its title cell as with CleanTitleCell(), and the rest as with
+  //  CleanCheckCell(); a row with an empty title has its next cell treated as the title instead, and so on
+  // returns the number of cells rewritten beyond stripping
+  std::size_t CleanRow(ColListT& row);
+
+  // print cleaned and title-sorted copy of TSV file to output, as LoadTSV() + WikiTitleSort() + PrintTSV() would,
+  //  but without holding more than about memBudget bytes of the table in memory at once
+  // the file is read in runs of up to a quarter of memBudget bytes each, which are loaded, sorted (using up to the
+  //  given number of threads) and spilled to temporary files; these are then merged to output, keeping the header
+  //  row first, and rows with equal keys in their original order
+  // if the whole file fits in a single run, it is printed directly without using temporary files
+  // a table snapshot is sorted in memory regardless of memBudget: its cells stay in the memory-mapped file, leaving
+  //  only the row lists and sort keys to hold
+  // throws std::runtime_error if file cannot be opened, or temporary files cannot be created/written
+  // each run's load and sort is recorded in stats as usual; spilling and merging are recorded as emit
+  // keys are folded according to fold, as with foldM
+  static void SortTSVExternal(const std::string& filename, std::size_t memBudget, unsigned threads,
+                              TitleKeyS::FoldE fold, OutputS& out, StatsS* stats = nullptr);
+
   // extract wiki display text from first column of each data row, then perform title sort on that data
+  // the sort is stable, so rows with the same title keep their relative order
+  // large tables are sorted in parallel, according to threadsM
   // calls WikiTitleClean() to enforce italicizing
   void WikiTitleSort();
+
+  // WikiTitleSort(), using and updating the sort index (see SortIndexS) in the given file, which is created if
+  //  missing
+  // rows whose titles are in the index are placed by their rank in it, in one pass without comparing keys; only the
+  //  rest have keys derived, and are binary-searched into place, so that re-sorting an edited table costs about
+  //  O(changed * log(rows)) on top of a linear pass
+  // falls back on a full sort (and rewrites the index) if the index is missing, corrupt or out of date, or if more
+  //  than a quarter of the rows have titles it doesn't know; the result is the same either way
+  // returns true if the index was used
+  // throws std::runtime_error if the index can't be written
+  bool WikiTitleSort(const std::string& indexFilename);
 };
 
 #endif
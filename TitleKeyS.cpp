@@ -0,0 +1,333 @@
+#include "TitleKeyS.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+  typedef std::string_view ViewT;
+
+  // lowercase letters with a single uppercase counterpart, as ranges of code points: every stepM-th code point from
+  //  firstM to lastM is lowercase, and its uppercase counterpart is deltaM away
+  // covers Latin, modern Greek, Cyrillic, Armenian and fullwidth Latin, along with CASE_PAIRS
+  struct CaseRangeS
+  {
+    char32_t     firstM;
+    char32_t     lastM;
+    char32_t     stepM;
+    std::int32_t deltaM;
+  };
+  const CaseRangeS CASE_RANGES[] =
+  {
+    {0x0061, 0x007A, 1, -0x20},  {0x00B5, 0x00B5, 1, 0x2E7},  {0x00E0, 0x00F6, 1, -0x20},
+    {0x00F8, 0x00FE, 1, -0x20},  {0x00FF, 0x00FF, 1, 0x79},   {0x0101, 0x012F, 2, -1},
+    {0x0131, 0x0131, 1, -0xE8},  {0x0133, 0x0137, 2, -1},     {0x013A, 0x0148, 2, -1},
+    {0x014B, 0x0177, 2, -1},     {0x017A, 0x017E, 2, -1},     {0x017F, 0x017F, 1, -0x12C},
+    {0x01CE, 0x01DC, 2, -1},     {0x01DF, 0x01EF, 2, -1},     {0x01F5, 0x01F5, 1, -1},
+    {0x01F9, 0x021F, 2, -1},     {0x0223, 0x0233, 2, -1},     {0x03AC, 0x03AC, 1, -0x26},
+    {0x03AD, 0x03AF, 1, -0x25},  {0x03B1, 0x03C1, 1, -0x20},  {0x03C2, 0x03C2, 1, -0x1F},
+    {0x03C3, 0x03CB, 1, -0x20},  {0x03CC, 0x03CC, 1, -0x40},  {0x03CD, 0x03CE, 1, -0x3F},
+    {0x0430, 0x044F, 1, -0x20},  {0x0450, 0x045F, 1, -0x50},  {0x0461, 0x0481, 2, -1},
+    {0x048B, 0x04BF, 2, -1},     {0x04C2, 0x04CE, 2, -1},     {0x04CF, 0x04CF, 1, -0xF},
+    {0x04D1, 0x052F, 2, -1},     {0x0561, 0x0586, 1, -0x30},  {0x1E01, 0x1E95, 2, -1},
+    {0x1EA1, 0x1EFF, 2, -1},     {0xFF41, 0xFF5A, 1, -0x20}
+  };
+
+  // other lowercase letters and their uppercase counterparts, in pairs of UTF-8 code points: the rest of Latin
+  //  Extended-B (with its titlecase digraphs folding to uppercase ones), and the IPA letters used in African
+  //  and Azerbaijani alphabets
+  const char* const CASE_PAIRS =
+    "ƀɃƃƂƅƄƈƇƌƋƒƑƕǶƙƘƚȽƞȠơƠƣƢƥƤƨƧƭƬưƯƴƳƶƵƹƸƽƼƿǷǅǄǆǄǈǇǉǇǋǊǌǊǝƎǲǱǳǱȼȻɂɁɇɆɉɈɋɊɍɌɏɎ"
+    "ɓƁɔƆɖƉɗƊəƏɛƐɠƓɣƔɨƗɩƖɯƜɲƝɵƟʀƦʃƩʈƮʉɄʊƱʋƲʌɅʒƷ";
+
+  // base letters (minus diacritics) of a block of code points from firstM on, one per code point, in UTF-8; code
+  //  points without one (including letters such as Æ or ß that are distinct rather than accented) stand for
+  //  themselves
+  // covers Latin-1, Latin Extended-A and B, accented Greek, the Cyrillic letters of Russian, Ukrainian and
+  //  Belarusian, and Latin Extended Additional (largely Vietnamese)
+  struct BaseBlockS
+  {
+    char32_t    firstM;
+    const char* basesM;
+  };
+  const BaseBlockS BASE_BLOCKS[] =
+  {
+    {0x00C0, "AAAAAAÆCEEEEIIIIDNOOOOO×OUUUUYÞßaaaaaaæceeeeiiiidnooooo÷ouuuuyþy"
+             "AaAaAaCcCcCcCcDdDdEeEeEeEeEeGgGgGgGgHhHhIiIiIiIiIiĲĳJjKkĸLlLlLlĿ"
+             "ŀLlNnNnNnŉŊŋOoOoOoŒœRrRrRrSsSsSsSsTtTtTtUuUuUuUuUuUuWwYyYZzZzZzſ"
+             "bƁƂƃƄƅƆƇƈƉƊƋƌƍƎƏƐƑƒƓƔƕƖIƘƙlƛƜƝƞƟOoƢƣƤƥƦƧƨƩƪƫƬƭƮUuƱƲƳƴƵƶƷƸƹƺƻƼƽƾƿ"
+             "ǀǁǂǃǄǅǆǇǈǉǊǋǌAaIiOoUuUuUuUuUuǝAaAaÆæGgGgKkOoOoƷʒjǱǲǳGgǶǷNnAaÆæØø"
+             "AaAaEeEeIiIiOoOoRrRrUuUuSsTtȜȝHhȠȡȢȣȤȥAaEeOoOoOoOoYyȴȵȶȷȸȹȺCcLTȿ"
+             "ɀɁɂBɄɅEeJjɊɋRrYy"},
+    {0x0386, "Α·ΕΗΙ΋Ο΍ΥΩιΑΒΓΔΕΖΗΘΙΚΛΜΝΞΟΠΡ΢ΣΤΥΦΧΨΩΙΥαεηιυαβγδεζηθικλμνξοπρςστυ"
+             "φχψωιυουω"},
+    {0x0400, "ЕЕЂГЄЅІІЈЉЊЋКИУЏАБВГДЕЖЗИИКЛМНОПРСТУФХЦЧШЩЪЫЬЭЮЯабвгдежзииклмноп"
+             "рстуфхцчшщъыьэюяееђгєѕііјљњћкиуџ"},
+    {0x1E00, "AaBbBbBbCcDdDdDdDdDdEeEeEeEeEeFfGgHhHhHhHhHhIiIiKkKkKkLlLlLlLlMm"
+             "MmMmNnNnNnNnOoOoOoOoPpPpRrRrRrRrSsSsSsSsSsTtTtTtTtUuUuUuUuUuVvVv"
+             "WwWwWwWwWwXxXxYyZzZzZzhtwyẚſẜẝẞẟAaAaAaAaAaAaAaAaAaAaAaAaEeEeEeEe"
+             "EeEeEeEeIiIiOoOoOoOoOoOoOoOoOoOoOoOoUuUuUuUuUuUuUuYyYyYyYyỺỻỼỽỾỿ"}
+  };
+
+  // combining diacritical marks, which are dropped along with other diacritics
+  const char32_t COMBINING_FIRST(0x0300);
+  const char32_t COMBINING_LAST(0x036F);
+
+  // code points that keys may fold to something other than themselves, beyond ASCII: all of those encoded in 2
+  //  bytes of UTF-8, Latin Extended Additional, and fullwidth ASCII
+  struct TableRangeS
+  {
+    char32_t firstM;
+    char32_t lastM;
+  };
+  const TableRangeS TABLE_RANGES[] = {{0x0080, 0x07FF}, {0x1E00, 0x1EFF}, {0xFF00, 0xFF5F}};
+  const std::size_t NOT_IN_TABLE(static_cast<std::size_t>(-1));
+
+  // position of code point c in the fold tables, or NOT_IN_TABLE
+  std::size_t TableIndex(const char32_t c)
+  {
+    std::size_t start(0);
+    for (const TableRangeS& range : TABLE_RANGES)
+    {
+      if (c >= range.firstM && c <= range.lastM) return start + (c - range.firstM);
+      start += range.lastM - range.firstM + 1;
+    }
+    return NOT_IN_TABLE;
+  }
+
+  // decode the UTF-8 sequence of at most 3 bytes at the start of s (of length bytes) into c; returns its length, or
+  //  0 if it isn't a valid one
+  // 4-byte sequences (beyond the Basic Multilingual Plane) are left to the caller as invalid, since no fold table
+  //  covers them
+  inline std::size_t DecodeUTF8(const unsigned char* const s, const std::size_t length, char32_t& c)
+  {
+    if (s[0] < 0x80)
+    {
+      c = s[0];
+      return 1;
+    }
+    if (s[0] >= 0xC2 && s[0] <= 0xDF && length >= 2 && (s[1] & 0xC0) == 0x80)
+    {
+      c = (char32_t(s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+      return 2;
+    }
+    if ((s[0] & 0xF0) == 0xE0 && length >= 3 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80)
+    {
+      c = (char32_t(s[0] & 0x0F) << 12) | (char32_t(s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+      // reject overlong encodings
+      return c >= 0x800 ? 3 : 0;
+    }
+    return 0;
+  }
+
+  // encode code point c (below U+10000) as UTF-8 into out; returns its length
+  inline std::size_t EncodeUTF8(const char32_t c, char* const out)
+  {
+    if (c < 0x80)
+    {
+      out[0] = static_cast<char>(c);
+      return 1;
+    }
+    if (c < 0x800)
+    {
+      out[0] = static_cast<char>(0xC0 | (c >> 6));
+      out[1] = static_cast<char>(0x80 | (c & 0x3F));
+      return 2;
+    }
+    out[0] = static_cast<char>(0xE0 | (c >> 12));
+    out[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out[2] = static_cast<char>(0x80 | (c & 0x3F));
+    return 3;
+  }
+
+  // uppercase counterpart of code point c, or c itself if it has none
+  char32_t Upper(const char32_t c)
+  {
+    for (const CaseRangeS& range : CASE_RANGES)
+    {
+      if (c >= range.firstM && c <= range.lastM && !((c - range.firstM) % range.stepM))
+      {
+        return static_cast<char32_t>(static_cast<std::int32_t>(c) + range.deltaM);
+      }
+    }
+    const ViewT pairs(CASE_PAIRS);
+    for (std::size_t pos(0); pos < pairs.length();)
+    {
+      char32_t lower(0);
+      char32_t upper(0);
+      pos += DecodeUTF8(reinterpret_cast<const unsigned char*>(pairs.data() + pos), pairs.length() - pos, lower);
+      pos += DecodeUTF8(reinterpret_cast<const unsigned char*>(pairs.data() + pos), pairs.length() - pos, upper);
+      if (c == lower) return upper;
+    }
+    return c;
+  }
+
+  // what a code point is replaced with in a key: up to 3 bytes of UTF-8, never longer than the code point's own
+  //  encoding, so that a key can be written over the title text it's derived from
+  struct FoldS
+  {
+    char          bytesM[3];
+    unsigned char lengthM;
+  };
+
+  // per-byte and per-code point fold tables for each fold mode
+  struct FoldTablesS
+  {
+    // ASCII byte -> uppercase byte, as with ::toupper() in the "C" locale
+    char               upperM[256];
+    // replacement of each code point in TABLE_RANGES, by TableIndex()
+    std::vector<FoldS> foldsM[TitleKeyS::FO_COUNT];
+
+    FoldTablesS()
+    {
+      for (unsigned c(0); c < 256; ++c)
+      {
+        upperM[c] = static_cast<char>((c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c);
+      }
+      std::size_t tableSize(0);
+      for (const TableRangeS& range : TABLE_RANGES) tableSize += range.lastM - range.firstM + 1;
+      // base letter of each code point in the table, with 0 standing for one that's dropped
+      std::vector<char32_t> bases(tableSize);
+      for (const TableRangeS& range : TABLE_RANGES)
+      {
+        for (char32_t c(range.firstM); c <= range.lastM; ++c) bases[TableIndex(c)] = c;
+      }
+      for (const BaseBlockS& block : BASE_BLOCKS)
+      {
+        const ViewT text(block.basesM);
+        char32_t c(block.firstM);
+        for (std::size_t pos(0); pos < text.length(); ++c)
+        {
+          char32_t base(0);
+          pos += DecodeUTF8(reinterpret_cast<const unsigned char*>(text.data() + pos), text.length() - pos, base);
+          bases[TableIndex(c)] = base;
+        }
+      }
+      for (char32_t c(COMBINING_FIRST); c <= COMBINING_LAST; ++c) bases[TableIndex(c)] = 0;
+      for (unsigned fold(0); fold < TitleKeyS::FO_COUNT; ++fold)
+      {
+        foldsM[fold].resize(tableSize);
+        for (const TableRangeS& range : TABLE_RANGES)
+        {
+          for (char32_t c(range.firstM); c <= range.lastM; ++c)
+          {
+            FoldS& entry(foldsM[fold][TableIndex(c)]);
+            const std::size_t length(EncodeUTF8(c, entry.bytesM));
+            entry.lengthM = static_cast<unsigned char>(length);
+            // sharp s has no single uppercase letter, and is spelled out instead
+            if (c == 0x00DF || c == 0x1E9E)
+            {
+              entry.bytesM[0] = entry.bytesM[1] = 'S';
+              entry.lengthM = 2;
+              continue;
+            }
+            const char32_t base(fold == TitleKeyS::FO_DIACRITICS ? bases[TableIndex(c)] : c);
+            if (!base)
+            {
+              entry.lengthM = 0;
+              continue;
+            }
+            char bytes[3];
+            const std::size_t foldLength(EncodeUTF8(Upper(base), bytes));
+            // (a few uppercase letters take more bytes than their lowercase ones; these are left as they are)
+            if (foldLength > length) continue;
+            for (std::size_t i(0); i < foldLength; ++i) entry.bytesM[i] = bytes[i];
+            entry.lengthM = static_cast<unsigned char>(foldLength);
+          }
+        }
+      }
+    }
+  };
+  const FoldTablesS FOLD_TABLES;
+
+  inline bool StartsWith(const ViewT s, const ViewT prefix)
+  {
+    return s.length() >= prefix.length() && !s.compare(0, prefix.length(), prefix);
+  }
+
+  inline bool EndsWith(const ViewT s, const ViewT suffix)
+  {
+    return s.length() >= suffix.length() && !s.compare(s.length() - suffix.length(), suffix.length(), suffix);
+  }
+
+  // append case-folded copy of s to out
+  // it's copied first, and then folded in place: a folded code point never takes more bytes than the original, so
+  //  writing never overtakes reading; ASCII bytes take a single table lookup, and anything that isn't valid UTF-8
+  //  is copied as it is
+  inline void AppendFolded(const ViewT s, const TitleKeyS::FoldE fold, std::string& out)
+  {
+    const std::size_t outStart(out.length());
+    out.append(s);
+    char* const dest(&out[outStart]);
+    const unsigned char* const source(reinterpret_cast<const unsigned char*>(dest));
+    const char* const upper(FOLD_TABLES.upperM);
+    const FoldS* const folds(FOLD_TABLES.foldsM[fold].data());
+    std::size_t write(0);
+    for (std::size_t read(0); read < s.length();)
+    {
+      const unsigned char c(source[read]);
+      if (c < 0x80)
+      {
+        dest[write++] = upper[c];
+        ++read;
+        continue;
+      }
+      char32_t codePoint(0);
+      const std::size_t length(DecodeUTF8(source + read, s.length() - read, codePoint));
+      const std::size_t index(length ? TableIndex(codePoint) : NOT_IN_TABLE);
+      if (index == NOT_IN_TABLE)
+      {
+        // copy the sequence (or the lone invalid byte) as it is
+        const std::size_t copyLength(length ? length : 1);
+        for (std::size_t i(0); i < copyLength; ++i) dest[write++] = static_cast<char>(source[read++]);
+        continue;
+      }
+      const FoldS& entry(folds[index]);
+      for (std::size_t i(0); i < entry.lengthM; ++i) dest[write++] = entry.bytesM[i];
+      read += length;
+    }
+    out.resize(outStart + write);
+  }
+}
+
+void TitleKeyS::Append(const ViewT title, std::string& out, const FoldE fold)
+{
+  // locate key within title
+  std::size_t keyStart(0);
+  std::size_t keyEnd(title.length());
+  if (StartsWith(title, "''[["))
+  {
+    // type 1 or 2; key starts after last pipe if any (type 1), else after the brackets (type 2)
+    const std::size_t pipe(title.rfind('|'));
+    keyStart = (pipe == ViewT::npos ? 4 : pipe + 1);
+    // key ends before closing brackets and italic markup
+    keyEnd = title.length() - 4;
+  }
+  else if (StartsWith(title, "''{{ill|"))
+  {
+    // type 3 or 4; key starts after link text sequence if any (type 3), else after the template name (type 4)
+    const std::size_t linkText(title.find("|lt=", 7));
+    keyStart = (linkText == ViewT::npos ? 8 : linkText + 4);
+    // key ends before next parameter or end of template
+    keyEnd = keyStart;
+    while (keyEnd < title.length() && title[keyEnd] != '|' && title[keyEnd] != '}') ++keyEnd;
+  }
+  if (keyEnd < keyStart) keyEnd = keyStart;
+  ViewT key(title.substr(keyStart, keyEnd - keyStart));
+  // ignore italic markup on either end of key
+  if (StartsWith(key, "''")) key.remove_prefix(2);
+  if (EndsWith(key, "''"))   key.remove_suffix(2);
+  // now move any leading article to the end
+  ViewT article;
+  if      (StartsWith(key, "A "))   article = key.substr(0, 1);
+  else if (StartsWith(key, "An "))  article = key.substr(0, 2);
+  else if (StartsWith(key, "The ")) article = key.substr(0, 3);
+  if (!article.empty()) key.remove_prefix(article.length() + 1);
+  // write folded key
+  AppendFolded(key, fold, out);
+  if (!article.empty())
+  {
+    out.append(", ");
+    AppendFolded(article, fold, out);
+  }
+}
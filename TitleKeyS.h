@@ -0,0 +1,51 @@
+#ifndef TITLEKEYS_H
+#define TITLEKEYS_H
+
+#include <string>
+#include <string_view>
+
+// title sort key extraction
+// a key is the display text of a (cleaned, i.e. italicized) title column value, with any leading article moved to
+//  the end and letters case-folded, so that keys can be compared bytewise
+// titles are taken to be UTF-8: letters are folded to uppercase through tables built once at startup, covering
+//  Latin, Greek, Cyrillic, Armenian and fullwidth Latin letters, independently of the locale; since UTF-8 sorts
+//  bytewise in code point order, other scripts (such as Japanese) sort by code point, and bytes that aren't valid
+//  UTF-8 are kept as they are
+// a key is never longer than the text it's derived from (bar a moved article's ", ")
+// 5 title forms are currently supported:
+//  ''[[...|KEY]]''
+//  ''[[KEY]]''
+//  ''{{ill|...|lt=KEY|...}}''
+//  ''{{ill|KEY|...}}''
+//  falls back on entire value (minus italic markup) if none of these apply
+struct TitleKeyS
+{
+  // how letters are folded in keys
+  enum FoldE
+  {
+    // by case only (e.g. "é" -> "É", which sorts after "Z")
+    FO_CASE,
+    // by case and diacritics (e.g. "é" -> "E"), so that accented letters sort along with their base letters; this
+    //  also drops combining diacritical marks
+    FO_DIACRITICS,
+    FO_COUNT
+  };
+
+  // append the sort key for title to out, in a single pass over the key text and without temporary strings
+  // out is typically a reusable buffer or arena shared by many keys; reserving MaxLength() bytes per title up front
+  //  guarantees that appending won't reallocate it
+  static void Append(std::string_view title, std::string& out, FoldE fold = FO_CASE);
+
+  // upper bound on the length of the key for a title of the given length
+  static std::size_t MaxLength(const std::size_t titleLength) { return titleLength + 2; }
+
+  // convenience version of Append() that returns the key as a new string
+  static std::string Get(const std::string_view title, const FoldE fold = FO_CASE)
+  {
+    std::string key;
+    Append(title, key, fold);
+    return key;
+  }
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ArgsS.h"
+#include "TableGenS.h"
+#include "TitleKeyS.h"
+
+namespace
+{
+  void PrintUsage(const std::string& argv0)
+  {
+    std::cerr << "USAGE: " << argv0 << " [--titles=N] [--rounds=N] [--threads=N] [--seed=N]\n";
+    std::cerr << "Measure TitleKeyS sort key extraction throughput on generated titles\n";
+    std::cerr << "  --titles=N   number of distinct titles (default 100000)\n";
+    std::cerr << "  --rounds=N   number of passes over the titles per thread (default 50)\n";
+    std::cerr << "  --threads=N  run N threads concurrently, each with its own key buffer (default 1)\n";
+    std::cerr << "  --seed=N     random seed for title generation (default 1)\n";
+  }
+
+  // generate titles spread evenly across the five supported forms, some with leading articles
+  std::vector<std::string> MakeTitles(const unsigned count, const unsigned seed)
+  {
+    TableGenS generator(seed);
+    std::vector<std::string> titles;
+    titles.reserve(count);
+    for (unsigned titleNum(0); titleNum < count; ++titleNum) titles.push_back(generator.Title(titleNum));
+    return titles;
+  }
+
+  // extract keys for all titles, rounds times over, into a reused buffer; returns a checksum to defeat optimization
+  std::uint64_t RunRounds(const std::vector<std::string>& titles, const unsigned rounds)
+  {
+    std::size_t bufferSize(0);
+    for (const std::string& title : titles) bufferSize += TitleKeyS::MaxLength(title.length());
+    std::string buffer;
+    buffer.reserve(bufferSize);
+    std::uint64_t checksum(0);
+    for (unsigned round(0); round < rounds; ++round)
+    {
+      buffer.clear();
+      for (const std::string& title : titles) TitleKeyS::Append(title, buffer);
+      checksum += buffer.length();
+    }
+    return checksum;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned titleCount(100000);
+  unsigned rounds(50);
+  unsigned threads(1);
+  unsigned seed(1);
+  for (int argNum(1); argNum < argc; ++argNum)
+  {
+    const std::string arg(argv[argNum]);
+    bool valid(false);
+    if      (!arg.compare(0, 9, "--titles="))  valid = ArgsS::ParseCount(arg.substr(9), titleCount) && titleCount;
+    else if (!arg.compare(0, 9, "--rounds="))  valid = ArgsS::ParseCount(arg.substr(9), rounds) && rounds;
+    else if (!arg.compare(0, 10, "--threads=")) valid = ArgsS::ParseCount(arg.substr(10), threads) && threads;
+    else if (!arg.compare(0, 7, "--seed="))    valid = ArgsS::ParseCount(arg.substr(7), seed);
+    if (!valid)
+    {
+      std::cerr << argv[0] << ": Invalid argument '" << arg << "'\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+  }
+
+  const std::vector<std::string> titles(MakeTitles(titleCount, seed));
+  // warm up caches and page in the buffer
+  std::uint64_t checksum(RunRounds(titles, 1));
+
+  std::vector<std::uint64_t> checksums(threads, 0);
+  const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+  std::vector<std::thread> workers;
+  for (unsigned threadNum(0); threadNum < threads; ++threadNum)
+  {
+    workers.emplace_back([&titles, rounds, &checksums, threadNum]()
+    {
+      checksums[threadNum] = RunRounds(titles, rounds);
+    });
+  }
+  for (std::thread& worker : workers) worker.join();
+  const double seconds(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  for (const std::uint64_t c : checksums) checksum += c;
+
+  const double keys(static_cast<double>(titleCount) * rounds * threads);
+  std::cout << "titles:           " << titleCount << "\n";
+  std::cout << "rounds:           " << rounds << "\n";
+  std::cout << "threads:          " << threads << "\n";
+  std::cout << "seconds:          " << seconds << "\n";
+  std::cout << "keys/s:           " << keys / seconds << "\n";
+  std::cout << "keys/s/thread:    " << keys / seconds / threads << "\n";
+  std::cout << "ns/key/thread:    " << seconds * 1e9 * threads / keys << "\n";
+  std::cout << "checksum:         " << checksum << "\n";
+
+  return 0;
+}
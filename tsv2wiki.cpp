@@ -1,26 +1,145 @@
 #include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include "ArgsS.h"
+#include "BatchS.h"
+#include "MappedFileS.h"
+#include "OutputS.h"
+#include "StatsS.h"
 #include "TableS.h"
 
 namespace
 {
   void PrintUsage(const std::string& argv0)
   {
-    std::cerr << "USAGE: " << argv0 << " FILE\n";
-    std::cerr << "Convert FILE from TSV to Wikimedia markup table and write to stdout\n";
+    std::cerr << "USAGE: " << argv0 << " [--threads=N] [--stream[=two-pass]] [--stats[=json]] FILE\n";
+    std::cerr << "       " << argv0 << " [--threads=N] [--stream[=two-pass]] [--dir=DIR] [--files-from=LIST]"
+              << " [--out-dir=DIR] [FILE...]\n";
+    std::cerr << "Convert FILE ('-': stdin) from TSV to Wikimedia markup table and write to stdout\n";
+    std::cerr << "FILE may also be a table snapshot (see tsvsort --output=snapshot), which loads without parsing\n";
+    std::cerr << "  --threads=N        load FILE using up to N threads (0: one per CPU; default 1)\n";
+    std::cerr << "  --stream           convert row by row as FILE is read, using constant memory, with reading,\n";
+    std::cerr << "                     tokenizing and printing overlapped on three threads; rows are padded to\n";
+    std::cerr << "                     the header width\n";
+    std::cerr << "  --stream=two-pass  as --stream, but read FILE twice to pad all rows to the widest (not stdin)\n";
+    std::cerr << "  --stats[=json]     print time, size and memory use of each phase to stderr\n";
+    std::cerr << "Batch mode (more than one FILE, or any of these options) converts each file in turn:\n";
+    std::cerr << "  --threads=N        convert up to N files at once, each using one thread\n";
+    std::cerr << "  --dir=DIR          convert all files in DIR\n";
+    std::cerr << "  --files-from=LIST  convert the files named in LIST, one per line ('-': stdin)\n";
+    std::cerr << "  --out-dir=DIR      write each output to DIR/NAME.wiki, instead of all to stdout in input order\n";
+    std::cerr << "  a per-file report is written to stderr; a file that fails doesn't stop the others\n";
   }
 }
 
 int main(int argc, char* argv[])
 {
-  if (argc != 2)
+  bool stream(false);
+  bool twoPass(false);
+  unsigned threads(1);
+  bool stats(false);
+  bool statsJson(false);
+  BatchS batch(".wiki");
+  std::string filename;
+  std::size_t numFiles(0);
+  for (int argNum(1); argNum < argc; ++argNum)
+  {
+    const std::string arg(argv[argNum]);
+    if      (arg == "--stream")          stream = true;
+    else if (arg == "--stream=two-pass") stream = twoPass = true;
+    else if (arg == "--stats")           stats = true;
+    else if (arg == "--stats=json")      stats = statsJson = true;
+    else if (batch.ParseArg(arg))        {}
+    else if (!arg.compare(0, 10, "--threads="))
+    {
+      if (!ArgsS::ParseCount(arg.substr(10), threads))
+      {
+        std::cerr << argv[0] << ": Invalid thread count '" << arg.substr(10) << "'\n\n";
+        PrintUsage(argv[0]);
+        return -1;
+      }
+    }
+    else if (arg.size() > 1 && arg[0] == '-')
+    {
+      std::cerr << argv[0] << ": Unknown option '" << arg << "'\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+    else
+    {
+      filename = arg;
+      batch.AddFile(arg);
+      ++numFiles;
+    }
+  }
+  if (numFiles > 1 || batch.Batched())
+  {
+    if (stats)
+    {
+      std::cerr << argv[0] << ": --stats is not supported in batch mode\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+    batch.threadsM = threads;
+    return batch.Main(argv[0], [stream, twoPass](const std::string& input, OutputS& out)
+    {
+      if (stream)
+      {
+        const std::size_t wideRows(TableS::StreamTSVToWiki(input, twoPass, out));
+        return wideRows ? std::to_string(wideRows) + " row(s) wider than header" : std::string();
+      }
+      TableS table;
+      table.LoadTSV(input);
+      table.PrintWiki(out);
+      return std::string();
+    });
+  }
+  if (numFiles != 1)
   {
     std::cerr << argv[0] << ": Incorrect number of input files specified\n\n";
     PrintUsage(argv[0]);
     return -1;
   }
+  if (twoPass && filename == MappedFileS::STDIN_NAME)
+  {
+    std::cerr << argv[0] << ": --stream=two-pass can't read stdin twice\n\n";
+    PrintUsage(argv[0]);
+    return -1;
+  }
 
-  TableS table(argv[1], TableS::FT_TSV);
-  table.PrintWiki();
+  // only constructed with --stats, as doing so turns on allocation counting
+  std::optional<StatsS> statsData;
+  if (stats) statsData.emplace();
+  StatsS* const statsPtr(statsData ? &*statsData : nullptr);
+  try
+  {
+    if (stream)
+    {
+      OutputS out(OutputS::FD_STDOUT);
+      const std::size_t wideRows(TableS::StreamTSVToWiki(filename, twoPass, out, statsPtr));
+      out.Flush();
+      if (wideRows)
+      {
+        std::cerr << argv[0] << ": " << wideRows
+                  << " row(s) wider than header; use --stream=two-pass to pad header\n";
+      }
+    }
+    else
+    {
+      TableS table;
+      table.threadsM = threads;
+      table.statsM = statsPtr;
+      table.LoadTSV(filename);
+      table.PrintWiki();
+    }
+  }
+  catch (const std::runtime_error& e)
+  {
+    std::cerr << argv[0] << ": " << e.what() << "\n";
+    return -2;
+  }
+  if (statsData) statsData->Print(std::cerr, statsJson);
 
   return 0;
 }
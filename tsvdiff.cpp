@@ -0,0 +1,143 @@
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+#include "ArgsS.h"
+#include "MappedFileS.h"
+#include "OutputS.h"
+#include "SnapshotS.h"
+#include "StatsS.h"
+#include "TableDiffS.h"
+#include "TableS.h"
+
+namespace
+{
+  // true if text is wiki markup rather than TSV: that is, if a line of it starts a table
+  bool IsWikiText(const std::string_view text)
+  {
+    return text.substr(0, 2) == "{|" || text.find("\n{|") != std::string_view::npos;
+  }
+
+  // load and clean file (or stdin, if it's MappedFileS::STDIN_NAME) into empty table, as a table snapshot, TSV or
+  //  wiki markup according to its contents
+  // the file is read just once, so it may be a pipe
+  // if rawRows is given, the data rows are copied to it as loaded, before they're cleaned
+  // throws std::runtime_error if file cannot be opened
+  void LoadTable(const std::string& filename, TableS& table, TableS::RowListT* const rawRows = nullptr)
+  {
+    {
+      StatsS::TimerS timer(table.statsM, StatsS::PH_READ);
+      table.inputM.Open(filename);
+      timer.Count(table.inputM.View().length(), 0, 0);
+    }
+    const std::string_view text(table.inputM.View());
+    if      (SnapshotS::Detect(text)) table.ParseSnapshot(text);
+    else if (IsWikiText(text))       table.ParseWiki(text);
+    else                             table.ParseTSV(text, true);
+    if (rawRows) *rawRows = table.dataM;
+    table.WikiTitleClean();
+  }
+
+  void PrintUsage(const std::string& argv0)
+  {
+    std::cerr << "USAGE: " << argv0 << " [--threads=N] [--format=list|wiki] [--stats[=json]] OLD NEW\n";
+    std::cerr << "Compare tables OLD and NEW row by row, and write the differences to stdout\n";
+    std::cerr << "Each may be a TSV file, a table snapshot, or wiki markup (such as article text) containing the\n";
+    std::cerr << "table, and either one (but not both) may be '-' for stdin; both are cleaned as tsvsort would,\n";
+    std::cerr << "and rows are matched up by their title sort keys\n";
+    std::cerr << "  --threads=N     load and hash using up to N threads (0: one per CPU; default 1)\n";
+    std::cerr << "  --format=list   write a TSV list of inserted, deleted, moved and changed rows and cells\n";
+    std::cerr << "                  (default)\n";
+    std::cerr << "  --format=wiki   write a unified diff from the tsv2wiki markup of OLD to that of NEW, changing\n";
+    std::cerr << "                  only the lines that differ, with three lines of context as diff -u gives\n";
+    std::cerr << "  --stats[=json]  print time, size and memory use of each phase to stderr\n";
+    std::cerr << "Exits with 0 if the tables are the same, 1 if they differ, 2 on error\n";
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned threads(1);
+  bool wiki(false);
+  bool stats(false);
+  bool statsJson(false);
+  std::vector<std::string> filenames;
+  for (int argNum(1); argNum < argc; ++argNum)
+  {
+    const std::string arg(argv[argNum]);
+    if      (arg == "--format=list") wiki = false;
+    else if (arg == "--format=wiki") wiki = true;
+    else if (arg == "--stats")       stats = true;
+    else if (arg == "--stats=json")  stats = statsJson = true;
+    else if (!arg.compare(0, 10, "--threads="))
+    {
+      if (!ArgsS::ParseCount(arg.substr(10), threads))
+      {
+        std::cerr << argv[0] << ": Invalid thread count '" << arg.substr(10) << "'\n\n";
+        PrintUsage(argv[0]);
+        return 2;
+      }
+    }
+    else if (arg.size() > 1 && arg[0] == '-')
+    {
+      std::cerr << argv[0] << ": Unknown option '" << arg << "'\n\n";
+      PrintUsage(argv[0]);
+      return 2;
+    }
+    else
+    {
+      filenames.push_back(arg);
+    }
+  }
+  if (filenames.size() != 2)
+  {
+    std::cerr << argv[0] << ": Incorrect number of input files specified\n\n";
+    PrintUsage(argv[0]);
+    return 2;
+  }
+  if (filenames[0] == MappedFileS::STDIN_NAME && filenames[1] == MappedFileS::STDIN_NAME)
+  {
+    std::cerr << argv[0] << ": Only one of OLD and NEW can be read from stdin\n\n";
+    PrintUsage(argv[0]);
+    return 2;
+  }
+
+  // only constructed with --stats, as doing so turns on allocation counting
+  std::optional<StatsS> statsData;
+  if (stats) statsData.emplace();
+  StatsS* const statsPtr(statsData ? &*statsData : nullptr);
+  TableS oldTable;
+  TableS newTable;
+  for (TableS* const table : {&oldTable, &newTable})
+  {
+    table->threadsM = threads;
+    table->statsM = statsPtr;
+  }
+  // errors are told apart from differences by their exit code, as with diff
+  bool same(true);
+  try
+  {
+    // the wiki patch applies to OLD as it is, so its rows are kept from before cleaning
+    TableS::RowListT oldRows;
+    LoadTable(filenames[0], oldTable, wiki ? &oldRows : nullptr);
+    LoadTable(filenames[1], newTable);
+    const TableDiffS diff(oldTable, newTable, threads, statsPtr);
+    {
+      StatsS::TimerS timer(statsPtr, StatsS::PH_EMIT);
+      OutputS out(OutputS::FD_STDOUT);
+      if (wiki) diff.PrintWikiPatch(oldRows, filenames[0], filenames[1], out);
+      else      diff.PrintList(out);
+      out.Flush();
+      timer.Count(out.BytesWritten(), diff.editsM.size(), 0);
+    }
+    same = diff.Empty();
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << argv[0] << ": " << e.what() << "\n";
+    return 2;
+  }
+  if (statsData) statsData->Print(std::cerr, statsJson);
+
+  return same ? 0 : 1;
+}
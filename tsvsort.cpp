@@ -1,28 +1,257 @@
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include "ArgsS.h"
+#include "BatchS.h"
+#include "ColTableS.h"
+#include "DictTableS.h"
+#include "LazyTableS.h"
+#include "OutputS.h"
+#include "StatsS.h"
 #include "TableS.h"
+#include "TitleKeyS.h"
 
 namespace
 {
+  enum LayoutE
+  {
+    // TableS: a cell list per row
+    LA_ROWS,
+    // DictTableS: dictionary-encoded columns
+    LA_DICT,
+    // ColTableS: a byte buffer per column
+    LA_COLS,
+    // LazyTableS: rows split only when cleaning needs them
+    LA_LAZY
+  };
+
+  // load, clean, sort and write table as TSV or a snapshot, for any table layout with the methods of DictTableS
+  template <typename TableT>
+  void SortTable(TableT& table, const std::string& filename, const bool snapshot, OutputS& out)
+  {
+    table.LoadTSV(filename);
+    table.WikiTitleClean();
+    table.WikiTitleSort();
+    if (snapshot) table.PrintSnapshot(out);
+    else          table.PrintTSV(out);
+  }
+
+  // size of file in bytes, or -1 if unknown
+  std::streamoff FileSize(const std::string& filename)
+  {
+    std::ifstream inFile(filename, std::ios::binary | std::ios::ate);
+    return inFile.is_open() ? static_cast<std::streamoff>(inFile.tellg()) : -1;
+  }
+
+  // write cleaned+sorted copy of file to out, as a TSV file or a table snapshot, using the given memory budget and
+  //  threads, table layout, sort key folding, and the given sort index file (if any); the file is sorted out of core
+  //  if it's larger than the budget (or its size can't be determined), unless a snapshot is wanted or an index is
+  //  used, which need the whole table in memory
+  void SortFile(const std::string& filename, const std::size_t memBudget, const unsigned threads,
+                const LayoutE layout, const TitleKeyS::FoldE fold, const bool snapshot,
+                const std::string& indexFilename, OutputS& out, StatsS* const stats)
+  {
+    const std::streamoff fileSize(FileSize(filename));
+    if (!snapshot && indexFilename.empty() && (fileSize < 0 || static_cast<std::size_t>(fileSize) > memBudget))
+    {
+      TableS::SortTSVExternal(filename, memBudget, threads, fold, out, stats);
+    }
+    else if (layout == LA_DICT)
+    {
+      DictTableS table;
+      table.tableM.threadsM = threads;
+      table.tableM.statsM = stats;
+      table.tableM.foldM = fold;
+      SortTable(table, filename, snapshot, out);
+    }
+    else if (layout == LA_COLS)
+    {
+      ColTableS table;
+      table.tableM.threadsM = threads;
+      table.tableM.statsM = stats;
+      table.tableM.foldM = fold;
+      SortTable(table, filename, snapshot, out);
+    }
+    else if (layout == LA_LAZY)
+    {
+      LazyTableS table;
+      table.tableM.threadsM = threads;
+      table.tableM.statsM = stats;
+      table.tableM.foldM = fold;
+      SortTable(table, filename, snapshot, out);
+    }
+    else
+    {
+      TableS table;
+      table.threadsM = threads;
+      table.statsM = stats;
+      table.foldM = fold;
+      table.LoadTSV(filename);
+      table.WikiTitleClean();
+      if (indexFilename.empty()) table.WikiTitleSort();
+      else                       table.WikiTitleSort(indexFilename);
+      if (snapshot) table.PrintSnapshot(out);
+      else          table.PrintTSV(out);
+    }
+  }
+
   void PrintUsage(const std::string& argv0)
   {
-    std::cerr << "USAGE: " << argv0 << " FILE\n";
-    std::cerr << "Write cleaned+sorted copy of TSV-formatted FILE to stdout\n";
+    std::cerr << "USAGE: " << argv0 << " [--threads=N] [--mem=SIZE] [--layout=rows|dict|cols|lazy]"
+              << " [--fold=case|diacritics] [--output=tsv|snapshot] [--index=INDEX] [--stats[=json]] FILE\n";
+    std::cerr << "       " << argv0 << " [--threads=N] [--mem=SIZE] [--layout=rows|dict|cols|lazy]"
+              << " [--fold=case|diacritics] [--output=tsv|snapshot] [--dir=DIR] [--files-from=LIST]"
+              << " [--out-dir=DIR] [FILE...]\n";
+    std::cerr << "Write cleaned+sorted copy of TSV-formatted FILE (or a table snapshot) to stdout\n";
+    std::cerr << "FILE may be '-' to read stdin, which is sorted as if larger than the memory budget, its size\n";
+    std::cerr << "being unknown\n";
+    std::cerr << "  --threads=N     use up to N threads (0: one per CPU; default 1)\n";
+    std::cerr << "  --mem=SIZE      memory budget, with optional K/M/G suffix (default 1G); inputs larger than\n";
+    std::cerr << "                  this are sorted in bounded runs via temporary files, then merged\n";
+    std::cerr << "  --layout=dict   dictionary-encode columns as FILE is loaded, so that cleaning and sorting work\n";
+    std::cerr << "                  on distinct values, and cells take 4 bytes each (in-memory sorts only;\n";
+    std::cerr << "                  default: rows)\n";
+    std::cerr << "  --layout=cols   store each column's values back to back, so that cleaning and sorting read only\n";
+    std::cerr << "                  the columns they need, and sorting moves row numbers rather than rows\n";
+    std::cerr << "                  (in-memory sorts only)\n";
+    std::cerr << "  --layout=lazy   load only each row's title, and copy the rest of its line to the output as it\n";
+    std::cerr << "                  is, splitting only rows whose other cells need cleaning (in-memory sorts only)\n";
+    std::cerr << "  --fold=diacritics\n";
+    std::cerr << "                  sort accented letters along with their base letters (e.g. 'É' with 'E')\n";
+    std::cerr << "                  rather than after 'Z' (default: case, which only ignores case)\n";
+    std::cerr << "  --output=snapshot\n";
+    std::cerr << "                  write a binary table snapshot instead of TSV, which this and tsv2wiki load\n";
+    std::cerr << "                  without parsing (the table is always sorted in memory; default: tsv)\n";
+    std::cerr << "  --index=INDEX   keep the title sort keys in file INDEX (created if missing), so that later runs\n";
+    std::cerr << "                  only derive keys for rows whose titles have changed, and place the others by\n";
+    std::cerr << "                  their stored order (the table is always sorted in memory; default rows layout\n";
+    std::cerr << "                  and single FILE only)\n";
+    std::cerr << "  --stats[=json]  print time, size and memory use of each phase to stderr\n";
+    std::cerr << "Batch mode (more than one FILE, or any of these options) sorts each file in turn:\n";
+    std::cerr << "  --threads=N     sort up to N files at once, each using one thread and an equal share of the\n";
+    std::cerr << "                  memory budget\n";
+    std::cerr << "  --dir=DIR       sort all files in DIR\n";
+    std::cerr << "  --files-from=LIST\n";
+    std::cerr << "                  sort the files named in LIST, one per line ('-': stdin)\n";
+    std::cerr << "  --out-dir=DIR   write each output to DIR/NAME.tsv (or .snap),\n";
+    std::cerr << "                  instead of all to stdout in input order\n";
+    std::cerr << "  a per-file report is written to stderr; a file that fails doesn't stop the others\n";
   }
 }
 
 int main(int argc, char* argv[])
 {
-  if (argc != 2)
+  unsigned threads(1);
+  std::size_t memBudget(std::size_t(1) << 30);
+  LayoutE layout(LA_ROWS);
+  TitleKeyS::FoldE fold(TitleKeyS::FO_CASE);
+  bool snapshot(false);
+  std::string indexFilename;
+  bool stats(false);
+  bool statsJson(false);
+  BatchS batch(".tsv");
+  std::string filename;
+  std::size_t numFiles(0);
+  for (int argNum(1); argNum < argc; ++argNum)
+  {
+    const std::string arg(argv[argNum]);
+    if      (arg == "--stats")           stats = true;
+    else if (arg == "--stats=json")      stats = statsJson = true;
+    else if (arg == "--layout=rows")     layout = LA_ROWS;
+    else if (arg == "--layout=dict")     layout = LA_DICT;
+    else if (arg == "--layout=cols")     layout = LA_COLS;
+    else if (arg == "--layout=lazy")     layout = LA_LAZY;
+    else if (arg == "--fold=case")       fold = TitleKeyS::FO_CASE;
+    else if (arg == "--fold=diacritics") fold = TitleKeyS::FO_DIACRITICS;
+    else if (arg == "--output=tsv")      snapshot = false;
+    else if (arg == "--output=snapshot") snapshot = true;
+    else if (batch.ParseArg(arg))        {}
+    else if (!arg.compare(0, 10, "--threads="))
+    {
+      if (!ArgsS::ParseCount(arg.substr(10), threads))
+      {
+        std::cerr << argv[0] << ": Invalid thread count '" << arg.substr(10) << "'\n\n";
+        PrintUsage(argv[0]);
+        return -1;
+      }
+    }
+    else if (!arg.compare(0, 8, "--index=") && arg.length() > 8)
+    {
+      indexFilename = arg.substr(8);
+    }
+    else if (!arg.compare(0, 6, "--mem="))
+    {
+      if (!ArgsS::ParseSize(arg.substr(6), memBudget))
+      {
+        std::cerr << argv[0] << ": Invalid memory budget '" << arg.substr(6) << "'\n\n";
+        PrintUsage(argv[0]);
+        return -1;
+      }
+    }
+    else if (arg.size() > 1 && arg[0] == '-')
+    {
+      std::cerr << argv[0] << ": Unknown option '" << arg << "'\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+    else
+    {
+      filename = arg;
+      batch.AddFile(arg);
+      ++numFiles;
+    }
+  }
+  if (layout != LA_ROWS && !indexFilename.empty())
+  {
+    std::cerr << argv[0] << ": --index is only supported with --layout=rows\n\n";
+    PrintUsage(argv[0]);
+    return -1;
+  }
+  if (numFiles > 1 || batch.Batched())
+  {
+    if (stats || !indexFilename.empty())
+    {
+      std::cerr << argv[0] << ": " << (stats ? "--stats" : "--index") << " is not supported in batch mode\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+    batch.threadsM = threads;
+    if (snapshot) batch.outExtM = ".snap";
+    return batch.Main(argv[0], [&batch, memBudget, layout, fold, snapshot](const std::string& input, OutputS& out)
+    {
+      // each file gets its share of the budget
+      SortFile(input, std::max<std::size_t>(memBudget / batch.Workers(), 1), 1, layout, fold, snapshot, std::string(),
+               out, nullptr);
+      return std::string();
+    });
+  }
+  if (numFiles != 1)
   {
     std::cerr << argv[0] << ": Incorrect number of input files specified\n\n";
     PrintUsage(argv[0]);
     return -1;
   }
 
-  TableS table(argv[1], TableS::FT_TSV);
-  table.WikiTitleClean();
-  table.WikiTitleSort();
-  table.PrintTSV();
+  // only constructed with --stats, as doing so turns on allocation counting
+  std::optional<StatsS> statsData;
+  if (stats) statsData.emplace();
+  StatsS* const statsPtr(statsData ? &*statsData : nullptr);
+  try
+  {
+    OutputS out(OutputS::FD_STDOUT);
+    SortFile(filename, memBudget, threads, layout, fold, snapshot, indexFilename, out, statsPtr);
+    StatsS::TimerS timer(statsPtr, StatsS::PH_EMIT);
+    out.Flush();
+  }
+  catch (const std::runtime_error& e)
+  {
+    std::cerr << argv[0] << ": " << e.what() << "\n";
+    return -2;
+  }
+  if (statsData) statsData->Print(std::cerr, statsJson);
 
   return 0;
 }
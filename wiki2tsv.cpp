@@ -1,304 +1,467 @@
 #include <cctype>
-#include <iostream>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
-#include <string>
-#include <vector>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <unordered_set>
+#include "ArgsS.h"
+#include "BatchS.h"
+#include "DumpReaderS.h"
+#include "MappedFileS.h"
+#include "OutputS.h"
+#include "SortIndexS.h"
+#include "StatsS.h"
+#include "TableS.h"
 
 namespace
 {
-  enum ReadStateE
+  // which of a file's tables to convert
+  struct SelectS
   {
-    // find table start
-    RS_TABLE,
-    // find and read column headers until row end
-    RS_HEADER,
-    // find and read column data until row end
-    RS_DATA,
-    // found table or file end
-    RS_DONE
+    // number of the table among those whose caption matches, from 1; 0 for all of them
+    std::size_t indexM;
+    // text that a matching table's caption must contain (all tables match if empty)
+    std::string captionM;
+    // true if chosen by option, rather than defaulting to the first table
+    bool        explicitM;
   };
 
-  struct WikitableS
+  // load the tables of wiki file selected by select, parsing up to the given number of them at once, along with their
+  //  numbers among all of its tables (from 1, counting nested tables in order of their start lines)
+  // file holds the input, which the tables' cells are views into
+  // if a single table is selected by default and the file has none, an empty table (numbered 0) results
+  // throws std::runtime_error if file cannot be opened, or if a single table is selected explicitly and none matches
+  void LoadTables(const std::string& filename, const SelectS& select, const unsigned threads, StatsS* const stats,
+    MappedFileS& file, std::vector<TableS>& tables, std::vector<std::size_t>& numbers)
   {
-    typedef std::vector<std::string> RowT;
-    typedef std::vector<RowT> DataT;
-    RowT headerM;
-    DataT dataM;
-    void NormalizeColumns()
     {
-      // scan header and data for maximum column count
-      std::size_t numColumns(headerM.size());
-      for (DataT::const_iterator dCiter(dataM.begin()); dCiter != dataM.end(); ++dCiter)
-      {
-        if (dCiter->size() > numColumns) numColumns = dCiter->size();
-      }
-      // now scan them again and adjust as needed
-      const std::string emptyString;
-      while (headerM.size() < numColumns)
-      {
-        headerM.push_back(emptyString);
-      }
-      for (DataT::iterator dIter(dataM.begin()); dIter != dataM.end(); ++dIter)
-      {
-        while (dIter->size() < numColumns) dIter->push_back(emptyString);
-      }
+      StatsS::TimerS timer(stats, StatsS::PH_READ);
+      file.Open(filename);
+      timer.Count(file.View().length(), 0, 0);
     }
-  };
-
-  bool IsCaption(const std::string& s)
-  {
-    return (!s.find("|+"));
+    StatsS::TimerS timer(stats, StatsS::PH_TOKENIZE);
+    std::vector<TableS::WikiTableS> found;
+    TableS::FindWikiTables(file.View(), found);
+    std::vector<TableS::CellT> texts;
+    numbers.clear();
+    std::size_t numMatches(0);
+    for (std::size_t tableNum(0); tableNum < found.size(); ++tableNum)
+    {
+      if (found[tableNum].captionM.find(select.captionM) == TableS::CellT::npos) continue;
+      if (select.indexM && ++numMatches != select.indexM) continue;
+      texts.push_back(found[tableNum].textM);
+      numbers.push_back(tableNum + 1);
+      if (select.indexM) break;
+    }
+    if (texts.empty() && select.indexM)
+    {
+      if (select.explicitM) throw std::runtime_error("No matching table in '" + filename + "'");
+      texts.emplace_back();
+      numbers.push_back(0);
+    }
+    TableS::ParseWikiTables(texts, threads, tables);
+    if (!stats) return;
+    std::size_t numRows(0);
+    std::size_t numCells(0);
+    for (const TableS& table : tables)
+    {
+      numRows += table.dataM.size();
+      numCells += table.CountCells();
+    }
+    timer.Count(file.View().length(), numRows, numCells);
   }
 
-  bool IsData(const std::string& s)
+  // print tables loaded by LoadTables() from file to out: a single table as plain TSV, otherwise each preceded by a
+  //  tag line of "#table", the file name and the table's number, separated by tabs
+  void PrintTables(const std::string& filename, const SelectS& select, const std::vector<TableS>& tables,
+    const std::vector<std::size_t>& numbers, OutputS& out)
   {
-    return (!s.find("|"));
+    if (select.indexM)
+    {
+      tables[0].PrintTSV(out);
+      return;
+    }
+    for (std::size_t tableNum(0); tableNum < tables.size(); ++tableNum)
+    {
+      out << "#table\t" << filename << '\t' << std::to_string(numbers[tableNum]) << '\n';
+      tables[tableNum].PrintTSV(out);
+    }
   }
 
-  bool IsHeader(const std::string& s)
+  // convert the tables of wiki text on stdin selected by select to out, as LoadTables() and PrintTables() do for a
+  //  file, but while the text is still being read: see DumpReaderS::ForEachTable()
+  // each table is parsed into table, using text to hold the markup its cells view, and printed as soon as it's
+  //  complete; table is left holding the last one converted (or empty, if none was)
+  // returns the number of tables converted
+  // throws std::runtime_error on read or write failure, or if a single table is selected explicitly and none matches
+  std::size_t StreamTables(const SelectS& select, OutputS& out, std::string& text, TableS& table)
   {
-    return (!s.find("!"));
+    std::size_t numMatches(0);
+    std::size_t numTables(0);
+    std::vector<TableS::WikiTableS> found;
+    DumpReaderS::ForEachTable(MappedFileS::STDIN_NAME, [&select, &out, &text, &table, &numMatches, &numTables, &found](
+      DumpReaderS::TableTextS&& tableText)
+    {
+      // once a single table is converted, the rest of the input is only read through
+      if (select.indexM && numTables) return;
+      table.Clear();
+      text = std::move(tableText.textM);
+      // the text's first table, then any nested in it
+      TableS::FindWikiTables(text, found);
+      for (std::size_t tableNum(0); tableNum < found.size(); ++tableNum)
+      {
+        if (found[tableNum].captionM.find(select.captionM) == TableS::CellT::npos) continue;
+        if (select.indexM && ++numMatches != select.indexM) continue;
+        table.Clear();
+        table.ParseWiki(found[tableNum].textM);
+        ++numTables;
+        if (select.indexM)
+        {
+          table.PrintTSV(out);
+          return;
+        }
+        out << "#table\t" << MappedFileS::STDIN_NAME << '\t' << std::to_string(tableText.indexM + tableNum) << '\n';
+        table.PrintTSV(out);
+      }
+    }, false);
+    if (select.indexM && !numTables)
+    {
+      if (select.explicitM) throw std::runtime_error("No matching table on stdin");
+      table.Clear();
+    }
+    return numTables;
   }
 
-  bool IsRowSep(const std::string& s)
-  {
-    return (!s.find("|-"));
-  }
+  // characters of page titles that are replaced to make file names
+  const std::string UNSAFE_CHARS("/\\:*?\"<>|");
 
-  bool IsTableEnd(const std::string& s)
-  {
-    return (!s.find("|}"));
-  }
+  // longest page title used whole in a file name, in bytes; with the table number, suffix and extension added, names
+  //  stay within the 255 bytes most file systems allow
+  const std::size_t MAX_TITLE_BYTES(200);
 
-  bool IsTableStart(const std::string& s)
+  // name of the file for table number index of page: the page title, with any characters unsafe in file names
+  //  replaced, then the table number
+  // a title longer than MAX_TITLE_BYTES is cut short (at a UTF-8 character boundary), and ends with "~" and a hash
+  //  of the whole title instead, to keep titles that only differ after the cut apart
+  // replacing characters can make different titles alike (e.g. "A/B" and "A_B"), so a name already in set used gets a
+  //  suffix of "~" and a count from 2, which no unsuffixed name ends with; names are compared ignoring ASCII case, as
+  //  file systems may do, and the name returned is added to used
+  std::string TableFileName(const std::string& page, const std::size_t index, std::unordered_set<std::string>& used)
   {
-    return (!s.find("{|"));
+    std::string name(page.empty() ? std::string("untitled") : page);
+    for (char& c : name)
+    {
+      if (UNSAFE_CHARS.find(c) != std::string::npos || static_cast<unsigned char>(c) < ' ') c = '_';
+    }
+    if (name.length() > MAX_TITLE_BYTES)
+    {
+      const std::uint64_t hash(SortIndexS::Hash(page));
+      char hashText[10];
+      std::snprintf(hashText, sizeof(hashText), "~%08x", static_cast<unsigned>((hash ^ hash >> 32) & 0xffffffff));
+      std::size_t length(MAX_TITLE_BYTES - std::strlen(hashText));
+      while (length && (static_cast<unsigned char>(name[length]) & 0xc0) == 0x80) --length;
+      name.resize(length);
+      name += hashText;
+    }
+    name += "." + std::to_string(index);
+    std::string unique(name);
+    for (std::size_t copy(2); ; ++copy)
+    {
+      std::string key(unique);
+      for (char& c : key) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      if (used.insert(std::move(key)).second) break;
+      unique = name + "~" + std::to_string(copy);
+    }
+    return unique + ".tsv";
   }
 
-  void PrintUsage(const std::string& argv0)
+  // convert every table in XML dump file to TSV: each to its own file in outDir, or (if outDir is empty) all to
+  //  stdout, each preceded by a tag line of "#table", its page title and its number in the page, separated by tabs
+  // tables nested in others are converted separately, numbered after the table containing them
+  // tables are parsed on this thread while the dump is scanned for more on another
+  // a table whose file can't be written is reported and skipped, without stopping the rest
+  // returns the tool's exit code, which is nonzero if any table failed
+  int ExtractDump(const std::string& argv0, const std::string& filename, const std::string& outDir)
   {
-    std::cerr << "USAGE: " << argv0 << " FILE\n";
-    std::cerr << "Convert FILE to TSV and write to stdout\n";
+    std::size_t numPages(0);
+    std::size_t numTables(0);
+    std::size_t numFailed(0);
+    try
+    {
+      if (!outDir.empty()) std::filesystem::create_directories(outDir);
+      OutputS stdOut(OutputS::FD_STDOUT);
+      TableS table;
+      std::vector<TableS::WikiTableS> found;
+      // names of the files written so far, so that no table overwrites another's
+      std::unordered_set<std::string> usedNames;
+      numPages = DumpReaderS::ForEachTable(filename,
+        [&argv0, &outDir, &numTables, &numFailed, &stdOut, &table, &found, &usedNames](
+        DumpReaderS::TableTextS&& tableText)
+      {
+        // the text's first table, then any nested in it
+        TableS::FindWikiTables(tableText.textM, found);
+        for (std::size_t tableNum(0); tableNum < found.size(); ++tableNum)
+        {
+          const std::size_t index(tableText.indexM + tableNum);
+          table.Clear();
+          table.ParseWiki(found[tableNum].textM);
+          ++numTables;
+          if (outDir.empty())
+          {
+            stdOut << "#table\t" << tableText.pageM << '\t' << std::to_string(index) << '\n';
+            table.PrintTSV(stdOut);
+            continue;
+          }
+          const std::string outName(
+            (std::filesystem::path(outDir) / TableFileName(tableText.pageM, index, usedNames)).string());
+          bool created(false);
+          try
+          {
+            std::ofstream outFile(outName, std::ios::binary | std::ios::trunc);
+            if (!outFile.is_open())
+            {
+              throw std::runtime_error("Failed to open output file: '" + outName + "' for write");
+            }
+            created = true;
+            OutputS out(outFile);
+            table.PrintTSV(out);
+            out.Flush();
+            // the stream buffers too, so an error may only show once it's flushed on close
+            outFile.close();
+            if (!outFile) throw std::runtime_error("Failed to write output file: '" + outName + "'");
+          }
+          catch (const std::runtime_error& e)
+          {
+            std::cerr << argv0 << ": " << e.what() << "\n";
+            ++numFailed;
+            if (created) std::remove(outName.c_str());
+          }
+        }
+      });
+      stdOut.Flush();
+    }
+    catch (const std::runtime_error& e)
+    {
+      std::cerr << argv0 << ": " << e.what() << "\n";
+      return -2;
+    }
+    std::cerr << "\npages: " << numPages << ", tables: " << numTables << ", failed: " << numFailed << "\n";
+    return numFailed ? -2 : 0;
   }
 
-  std::string Strip(const std::string& s)
+  void PrintUsage(const std::string& argv0)
   {
-      std::string::const_iterator sIter(s.begin());
-      std::string::const_reverse_iterator sRiter(s.rbegin());
-      while (std::isspace(*sIter))  ++sIter;
-      // special case: return empty string if s is empty or all whitespace
-      if (sIter == s.end()) return std::string();
-
-      while (std::isspace(*sRiter)) ++sRiter;
-      return std::string(sIter, sRiter.base());
+    std::cerr << "USAGE: " << argv0 << " [--table=N|all] [--caption=TEXT] [--threads=N] [--stats[=json]] FILE\n";
+    std::cerr << "       " << argv0 << " [--table=N|all] [--caption=TEXT] [--threads=N] [--dir=DIR]\n";
+    std::cerr << "       " << std::string(argv0.length(), ' ') << " [--files-from=LIST] [--out-dir=DIR] [FILE...]\n";
+    std::cerr << "       " << argv0 << " --dump [--out-dir=DIR] DUMP\n";
+    std::cerr << "Convert a table in FILE to TSV and write to stdout\n";
+    std::cerr << "FILE (or DUMP) may be '-' to read stdin, which is converted table by table as it's read\n";
+    std::cerr << "  --table=N          convert the Nth table (from 1; default 1), counting tables nested in others,\n";
+    std::cerr << "                     in order of their start lines\n";
+    std::cerr << "  --table=all        convert every table, each preceded by a line of '#table', file name and table\n";
+    std::cerr << "                     number, separated by tabs\n";
+    std::cerr << "  --caption=TEXT     count only tables whose caption contains TEXT\n";
+    std::cerr << "  --threads=N        parse up to N tables at once (0: one per CPU; default 1)\n";
+    std::cerr << "  --stats[=json]     print time, size and memory use of each phase to stderr\n";
+    std::cerr << "Batch mode (more than one FILE, or any of these options) converts each file in turn:\n";
+    std::cerr << "  --threads=N        convert up to N files at once (0: one per CPU; default 1)\n";
+    std::cerr << "  --dir=DIR          convert all files in DIR\n";
+    std::cerr << "  --files-from=LIST  convert the files named in LIST, one per line ('-': stdin)\n";
+    std::cerr << "  --out-dir=DIR      write each output to DIR/NAME.tsv, instead of all to stdout in input order\n";
+    std::cerr << "  a per-file report is written to stderr; a file that fails doesn't stop the others\n";
+    std::cerr << "Dump mode converts every table in a MediaWiki XML dump (such as pages-articles.xml):\n";
+    std::cerr << "  --dump             read DUMP in one streaming pass, writing each table's TSV to stdout after a\n";
+    std::cerr << "                     line of '#table', page title and table number (from 1), separated by tabs\n";
+    std::cerr << "  --out-dir=DIR      write each table to DIR/TITLE.NUMBER.tsv instead (TITLE.NUMBER~2.tsv and\n";
+    std::cerr << "                     so on, if replacing characters unsafe in file names makes titles clash);\n";
+    std::cerr << "                     a table that can't be written is reported and skipped\n";
   }
+}
 
-  typedef std::vector<std::string> TokenListT;
-  // split string 's' into a vector of tokens, by delimiter string 'delim'
-  // delimiter at string start will be interpreted as being preceded by an empty token
-  // delimiter at string end will be interpreted as being followed by an empty token
-  // all tokens will be stripped of leading/trailing whitepsace
-  // empty string will result in a single empty token
-  TokenListT Split(const std::string& s, const std::string& delim)
+int main(int argc, char* argv[])
+{
+  bool dump(false);
+  SelectS select{1, std::string(), false};
+  bool stats(false);
+  bool statsJson(false);
+  BatchS batch(".tsv");
+  std::string filename;
+  std::size_t numFiles(0);
+  for (int argNum(1); argNum < argc; ++argNum)
   {
-    TokenListT tList;
-    std::size_t delimStart(0);
-    std::size_t tokenStart(0);
-    while (delimStart != std::string::npos)
+    const std::string arg(argv[argNum]);
+    if      (arg == "--dump")       dump = true;
+    else if (arg == "--stats")      stats = true;
+    else if (arg == "--stats=json") stats = statsJson = true;
+    else if (arg == "--table=all")
+    {
+      select.indexM = 0;
+      select.explicitM = true;
+    }
+    else if (!arg.compare(0, 10, "--caption="))
+    {
+      select.captionM = arg.substr(10);
+      select.explicitM = true;
+    }
+    else if (batch.ParseArg(arg))   {}
+    else if (!arg.compare(0, 8, "--table="))
     {
-      // find next delimiter start
-      delimStart = s.find(delim, tokenStart);
-      // if not found, snap off the rest of the string as the last token
-      if (delimStart == std::string::npos)
+      unsigned index(0);
+      if (!ArgsS::ParseCount(arg.substr(8), index) || !index)
       {
-        tList.push_back(Strip(s.substr(tokenStart)));
-        break;
+        std::cerr << argv[0] << ": Invalid table number '" << arg.substr(8) << "'\n\n";
+        PrintUsage(argv[0]);
+        return -1;
       }
-      // found a delimiter; push everything since the last one
-      tList.push_back(Strip(s.substr(tokenStart, delimStart - tokenStart)));
-      // advance token start marker past end of delimiter
-      tokenStart = delimStart + delim.length();
-      // if we go off the edge, the delimiter was at the end
-      if (tokenStart >= s.length())
+      select.indexM = index;
+      select.explicitM = true;
+    }
+    else if (!arg.compare(0, 10, "--threads="))
+    {
+      if (!ArgsS::ParseCount(arg.substr(10), batch.threadsM))
       {
-        // push an empty token as the last one
-        tList.push_back(std::string());
-        break;
+        std::cerr << argv[0] << ": Invalid thread count '" << arg.substr(10) << "'\n\n";
+        PrintUsage(argv[0]);
+        return -1;
       }
     }
-    return tList;
+    else if (arg.size() > 1 && arg[0] == '-')
+    {
+      std::cerr << argv[0] << ": Unknown option '" << arg << "'\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+    else
+    {
+      filename = arg;
+      batch.AddFile(arg);
+      ++numFiles;
+    }
   }
-}
-
-int main(int argc, char* argv[])
-{
-  if (argc != 2)
+  if (dump)
+  {
+    if (stats)
+    {
+      std::cerr << argv[0] << ": --stats is not supported in dump mode\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+    if (select.explicitM)
+    {
+      std::cerr << argv[0] << ": --table and --caption are not supported in dump mode\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+    try
+    {
+      batch.Expand();
+    }
+    catch (const std::runtime_error& e)
+    {
+      std::cerr << argv[0] << ": " << e.what() << "\n";
+      return -1;
+    }
+    if (batch.filesM.size() != 1)
+    {
+      std::cerr << argv[0] << ": Incorrect number of input files specified\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+    return ExtractDump(argv[0], batch.filesM[0].inputM, batch.outDirM);
+  }
+  if (numFiles > 1 || batch.Batched())
+  {
+    if (stats)
+    {
+      std::cerr << argv[0] << ": --stats is not supported in batch mode\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+    // files are converted in parallel, so each one's tables are parsed in turn
+    return batch.Main(argv[0], [&select](const std::string& input, OutputS& out)
+    {
+      MappedFileS file;
+      std::vector<TableS> tables;
+      std::vector<std::size_t> numbers;
+      LoadTables(input, select, 1, nullptr, file, tables, numbers);
+      PrintTables(input, select, tables, numbers, out);
+      return select.indexM ? std::string() : "tables: " + std::to_string(tables.size());
+    });
+  }
+  if (numFiles != 1)
   {
     std::cerr << argv[0] << ": Incorrect number of input files specified\n\n";
     PrintUsage(argv[0]);
     return -1;
   }
 
-  std::ifstream inFile;
-  inFile.open(argv[1]);
-  if (!inFile.is_open())
+  // only constructed with --stats, as doing so turns on allocation counting
+  std::optional<StatsS> statsData;
+  if (stats) statsData.emplace();
+  StatsS* const statsPtr(statsData ? &*statsData : nullptr);
+  const bool fromStdin(filename == MappedFileS::STDIN_NAME);
+  MappedFileS file;
+  std::vector<TableS> tables;
+  std::vector<std::size_t> numbers;
+  // markup of the last table converted from stdin, which its cells view
+  std::string text;
+  std::size_t numTables(0);
+  try
+  {
+    if (fromStdin)
+    {
+      // stdin is converted table by table as it's read, rather than read whole first
+      tables.resize(1);
+      tables[0].statsM = statsPtr;
+      OutputS out(OutputS::FD_STDOUT);
+      numTables = StreamTables(select, out, text, tables[0]);
+      out.Flush();
+    }
+    else
+    {
+      LoadTables(filename, select, batch.threadsM, statsPtr, file, tables, numbers);
+      numTables = tables.size();
+    }
+  }
+  catch (const std::runtime_error& e)
   {
-    std::cerr << argv[0] << ": Failed to open input file '" << argv[1] << "' for read\n\n";
+    std::cerr << argv[0] << ": " << e.what() << "\n\n";
     PrintUsage(argv[0]);
     return -2;
   }
 
-  ReadStateE readState = RS_TABLE; // file read state
-  std::string line; // file read line buffer
-  WikitableS::RowT row; // in-progress data row buffer
-  WikitableS table; // our table
-  while (readState != RS_DONE)
+  // now print the table data to stdout as tab-separated values
+  if (!fromStdin)
   {
-    if (!std::getline(inFile, line)) readState = RS_DONE;
-    switch (readState)
+    StatsS::TimerS timer(statsPtr, StatsS::PH_EMIT);
+    OutputS out(OutputS::FD_STDOUT);
+    PrintTables(filename, select, tables, numbers, out);
+    out.Flush();
+    std::size_t numRows(0);
+    std::size_t numCells(0);
+    for (const TableS& table : tables)
     {
-      // looking for table start
-      case RS_TABLE:
-      {
-        if (IsTableStart(line))
-        {
-          // start of table
-          // advance to header read
-          readState = RS_HEADER;
-        }
-        // else swallow unknown line
-      }
-      break;
-
-      // looking for headers
-      case RS_HEADER:
-      {
-        if (IsRowSep(line))
-        {
-          // end of header row
-          if (!table.headerM.empty())
-          {
-            // advance to row read state
-            readState = RS_DATA;
-          }
-          // else must be caption-header separator?
-          // TODO: this doesn't work for headerless tables
-        }
-        else if (IsHeader(line))
-        {
-          // this line contains one or more column headers
-          // tokenize everything after the first character by "!!" in case of multiple headers in this line
-          const TokenListT& headerList(Split(line.substr(1), "!!"));
-/*
-          // process tokens
-          for (TokenListT::const_iterator tlCiter(headerList.begin());
-               tlCiter != headerList.end(); ++tlCiter)
-          {
-            const std::string& t(*tlCiter);
-            // for each token, grab the part after any '|' separator
-            //  find last pipe symbol
-            std::size_t start(t.find_last_of('|'));
-            // if npos, reset start to zero to grab whole string
-            // else advance past pipe, or npos if pipe at end
-            start = (
-              start == std::string::npos ? 0 :
-              start + 1 >= t.length() ? std::string::npos :
-              start + 1
-            );
-            // push stripped header string
-            table.headerM.push_back(Strip(t.substr(start)));
-          }
-*/
-          // append token list to header list
-          if (!headerList.empty()) table.headerM.insert(table.headerM.end(), headerList.begin(), headerList.end());
-        }
-        // else swallow unknown line
-      }
-      break;
-
-      // looking for regular cell data within a row
-      case RS_DATA:
-      {
-        // check data separator last, because it's a subset of everything else
-        if (IsRowSep(line))
-        {
-          // end of row data
-          // push scratch to table and clear it
-          if (!row.empty())
-          {
-            table.dataM.push_back(row);
-            row.clear();
-          }
-        }
-        else if (IsTableEnd(line))
-        {
-          // end of table
-          // push scratch to table and clear it
-          if (!row.empty())
-          {
-            table.dataM.push_back(row);
-            row.clear();
-          }
-          // advance to end state
-          readState = RS_DONE;
-        }
-        else if (IsData(line))
-        {
-          // this line contains one or more row data cells
-          // tokenize everything after the first character by "||" in case of multiple cells in this line
-          const TokenListT& dataList(Split(line.substr(1), "||"));
-          // append token list to row data buffer
-          if (!dataList.empty()) row.insert(row.end(), dataList.begin(), dataList.end());
-        }
-        // else swallow unknown line
-      }
-      break;
-
-      case RS_DONE:
-      {
-        // we're done
-        // if we have a partially-constructed row, just push it
-        if (!row.empty()) table.dataM.push_back(row);
-      }
-      break;
+      numRows += table.dataM.size();
+      numCells += (table.dataM.size() + 1) * table.headerM.size();
     }
+    timer.Count(out.BytesWritten(), numRows, numCells);
   }
-  // done building table
-  // close input file
-  inFile.close();
 
-  // now print the table data to stdout as tab-separated values
-  // first, normalize table's column count across header and row data
-  table.NormalizeColumns();
-  // now print the header row (if non-empty)
-  if (!table.headerM.empty())
+  // all rows have the header's width after loading, even if the table has no data rows
+  if (select.indexM)
   {
-    bool prependTab(false);
-    for (WikitableS::RowT::const_iterator rowCiter(table.headerM.begin());
-         rowCiter != table.headerM.end(); ++rowCiter)
-    {
-      if (prependTab) std::cout << "\t";
-      else            prependTab = true;
-      std::cout << *rowCiter;
-    }
-    std::cout << "\n";
+    std::cerr << "\nrows: " << tables[0].dataM.size() << ", cols: " << tables[0].headerM.size() << "\n";
   }
-  // now print the data rows
-  for (WikitableS::DataT::const_iterator dataCiter(table.dataM.begin());
-       dataCiter != table.dataM.end(); ++dataCiter)
+  else
   {
-    bool prependTab(false);
-    for (WikitableS::RowT::const_iterator rowCiter(dataCiter->begin());
-         rowCiter != dataCiter->end(); ++rowCiter)
-    {
-      if (prependTab) std::cout << "\t";
-      else            prependTab = true;
-      std::cout << *rowCiter;
-    }
-    std::cout << "\n";
+    std::cerr << "\ntables: " << numTables << "\n";
   }
-
-  std::cerr << "\nrows: " << table.dataM.size() << ", cols: " << table.dataM.begin()->size() << "\n";
+  if (statsData) statsData->Print(std::cerr, statsJson);
 
   return 0;
 }
@@ -0,0 +1,206 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ArgsS.h"
+#include "MappedFileS.h"
+#include "OutputS.h"
+#include "StatsS.h"
+#include "TableS.h"
+#include "TitleKeyS.h"
+
+namespace
+{
+  enum StageE
+  {
+    ST_LOAD_WIKI,
+    ST_LOAD_TSV,
+    ST_CLEAN,
+    ST_SORT,
+    ST_EMIT_TSV,
+    ST_EMIT_WIKI
+  };
+
+  enum StageArgE
+  {
+    SA_NONE,
+    SA_OPTIONAL,
+    SA_REQUIRED
+  };
+
+  // a stage of the chain, as given on the command line
+  struct StageS
+  {
+    StageE      typeM;
+    // file to load or emit to, or sort index file; empty for none (emitting to stdout)
+    std::string argM;
+  };
+
+  struct StageNameS
+  {
+    const char* nameM;
+    StageE      typeM;
+    StageArgE   argM;
+  };
+
+  const StageNameS STAGE_NAMES[] =
+  {
+    {"load-wiki", ST_LOAD_WIKI, SA_REQUIRED},
+    {"load-tsv",  ST_LOAD_TSV,  SA_REQUIRED},
+    {"clean",     ST_CLEAN,     SA_NONE},
+    {"sort",      ST_SORT,      SA_OPTIONAL},
+    {"emit-tsv",  ST_EMIT_TSV,  SA_OPTIONAL},
+    {"emit-wiki", ST_EMIT_WIKI, SA_OPTIONAL}
+  };
+
+  // parse a stage of the form NAME or NAME=ARG into 'stage'; returns false (leaving it untouched) if invalid
+  bool ParseStage(const std::string& s, StageS& stage)
+  {
+    const std::size_t equals(s.find('='));
+    const std::string name(s.substr(0, equals));
+    for (const StageNameS& stageName : STAGE_NAMES)
+    {
+      if (name != stageName.nameM) continue;
+      if (equals == std::string::npos ? stageName.argM == SA_REQUIRED
+                                      : stageName.argM == SA_NONE || equals + 1 == s.length())
+      {
+        return false;
+      }
+      stage.typeM = stageName.typeM;
+      stage.argM = equals == std::string::npos ? std::string() : s.substr(equals + 1);
+      return true;
+    }
+    return false;
+  }
+
+  // write table to stage's file (or stdout, if it has none), as TSV or wiki markup according to its type
+  // loaded is the file the table was loaded from, whose contents its cells may view
+  // throws std::runtime_error if the file cannot be opened or written, or is the loaded file
+  void Emit(const StageS& stage, const std::string& loaded, const TableS& table)
+  {
+    if (stage.argM.empty() || stage.argM == MappedFileS::STDIN_NAME)
+    {
+      OutputS out(OutputS::FD_STDOUT);
+      if (stage.typeM == ST_EMIT_WIKI) table.PrintWiki(out);
+      else                             table.PrintTSV(out);
+      out.Flush();
+      return;
+    }
+    // the loaded file is memory-mapped, so truncating it would pull the rug out from under the table
+    std::error_code error;
+    if (std::filesystem::equivalent(stage.argM, loaded, error))
+    {
+      throw std::runtime_error("Output file '" + stage.argM + "' is the input file");
+    }
+    std::ofstream outFile(stage.argM, std::ios::binary | std::ios::trunc);
+    if (!outFile.is_open()) throw std::runtime_error("Failed to open output file: '" + stage.argM + "' for write");
+    OutputS out(outFile);
+    if (stage.typeM == ST_EMIT_WIKI) table.PrintWiki(out);
+    else                             table.PrintTSV(out);
+    out.Flush();
+  }
+
+  void PrintUsage(const std::string& argv0)
+  {
+    std::cerr << "USAGE: " << argv0 << " [--threads=N] [--fold=case|diacritics] [--stats[=json]] STAGE...\n";
+    std::cerr << "Run a chain of stages, in order, on one table held in memory, so that it's parsed once and only\n";
+    std::cerr << "formatted for output; for example, 'load-wiki=article.txt sort emit-wiki' does the work of\n";
+    std::cerr << "'wiki2tsv article.txt | tsvsort - | tsv2wiki -' without the two intermediate TSV copies\n";
+    std::cerr << "Stages (the first must be a load; FILE may be '-' for stdin/stdout):\n";
+    std::cerr << "  load-wiki=FILE    replace the table with the first table in wiki markup FILE, as wiki2tsv does\n";
+    std::cerr << "  load-tsv=FILE     replace the table with TSV file (or table snapshot) FILE, as tsv2wiki does\n";
+    std::cerr << "  clean             clean cells for wiki export, as tsvsort does\n";
+    std::cerr << "  sort[=INDEX]      clean and sort rows by title, as tsvsort does (using and updating sort index\n";
+    std::cerr << "                    file INDEX, if given, as with tsvsort --index)\n";
+    std::cerr << "  emit-tsv[=FILE]   write the table as TSV to FILE (default: stdout)\n";
+    std::cerr << "  emit-wiki[=FILE]  write the table as wiki markup to FILE (default: stdout)\n";
+    std::cerr << "  --threads=N       load and sort using up to N threads (0: one per CPU; default 1)\n";
+    std::cerr << "  --fold=diacritics sort accented letters along with their base letters, as with tsvsort\n";
+    std::cerr << "                    (default: case)\n";
+    std::cerr << "  --stats[=json]    print time, size and memory use of each phase to stderr\n";
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned threads(1);
+  TitleKeyS::FoldE fold(TitleKeyS::FO_CASE);
+  bool stats(false);
+  bool statsJson(false);
+  std::vector<StageS> stages;
+  for (int argNum(1); argNum < argc; ++argNum)
+  {
+    const std::string arg(argv[argNum]);
+    StageS stage{ST_CLEAN, std::string()};
+    if      (arg == "--stats")           stats = true;
+    else if (arg == "--stats=json")      stats = statsJson = true;
+    else if (arg == "--fold=case")       fold = TitleKeyS::FO_CASE;
+    else if (arg == "--fold=diacritics") fold = TitleKeyS::FO_DIACRITICS;
+    else if (!arg.compare(0, 10, "--threads="))
+    {
+      if (!ArgsS::ParseCount(arg.substr(10), threads))
+      {
+        std::cerr << argv[0] << ": Invalid thread count '" << arg.substr(10) << "'\n\n";
+        PrintUsage(argv[0]);
+        return -1;
+      }
+    }
+    else if (ParseStage(arg, stage))
+    {
+      stages.push_back(stage);
+    }
+    else
+    {
+      std::cerr << argv[0] << ": " << (arg[0] == '-' ? "Unknown option" : "Invalid stage") << " '" << arg << "'\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+  }
+  if (stages.empty() || (stages[0].typeM != ST_LOAD_WIKI && stages[0].typeM != ST_LOAD_TSV))
+  {
+    std::cerr << argv[0] << ": The first stage must load a table\n\n";
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  // only constructed with --stats, as doing so turns on allocation counting
+  std::optional<StatsS> statsData;
+  if (stats) statsData.emplace();
+  TableS table;
+  table.threadsM = threads;
+  table.statsM = statsData ? &*statsData : nullptr;
+  table.foldM = fold;
+  // file the table was last loaded from
+  std::string loaded;
+  try
+  {
+    for (const StageS& stage : stages)
+    {
+      switch (stage.typeM)
+      {
+        case ST_LOAD_WIKI: table.LoadWiki(stage.argM); loaded = stage.argM; break;
+        case ST_LOAD_TSV:  table.LoadTSV(stage.argM);  loaded = stage.argM; break;
+        case ST_CLEAN:     table.WikiTitleClean();                          break;
+        case ST_SORT:
+        {
+          if (stage.argM.empty()) table.WikiTitleSort();
+          else                    table.WikiTitleSort(stage.argM);
+        }
+        break;
+        case ST_EMIT_TSV:
+        case ST_EMIT_WIKI: Emit(stage, loaded, table); break;
+      }
+    }
+  }
+  catch (const std::runtime_error& e)
+  {
+    std::cerr << argv[0] << ": " << e.what() << "\n";
+    return -2;
+  }
+  if (statsData) statsData->Print(std::cerr, statsJson);
+
+  return 0;
+}
@@ -0,0 +1,343 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ArgsS.h"
+#include "DelimScanS.h"
+#include "ColTableS.h"
+#include "DictTableS.h"
+#include "LazyTableS.h"
+#include "OutputS.h"
+#include "StatsS.h"
+#include "TableGenS.h"
+#include "TableS.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define WIKITSV_BENCH_POSIX 1
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  // timing and size of one benchmarked phase
+  struct ResultS
+  {
+    const char* phaseM;
+    std::size_t rowsM;
+    std::size_t bytesM;
+    double      secondsM;
+    long        peakRssKbM;
+    long        rssKbM;
+  };
+
+  // parse a comma-separated list of positive row counts with optional K/M (decimal) suffixes into 'scales';
+  //  returns false (leaving it untouched) if invalid
+  bool ParseScales(const std::string& s, std::vector<std::size_t>& scales)
+  {
+    std::vector<std::size_t> parsed;
+    std::size_t start(0);
+    while (start <= s.length())
+    {
+      std::size_t end(s.find(',', start));
+      if (end == std::string::npos) end = s.length();
+      std::string item(s.substr(start, end - start));
+      std::size_t scale(1);
+      if (!item.empty() && (item.back() == 'K' || item.back() == 'k'))
+      {
+        scale = 1000;
+        item.pop_back();
+      }
+      else if (!item.empty() && (item.back() == 'M' || item.back() == 'm'))
+      {
+        scale = 1000000;
+        item.pop_back();
+      }
+      unsigned count(0);
+      if (!ArgsS::ParseCount(item, count) || !count) return false;
+      parsed.push_back(count * scale);
+      start = end + 1;
+    }
+    scales.swap(parsed);
+    return true;
+  }
+
+  void PrintUsage(const std::string& argv0)
+  {
+    std::cerr << "USAGE: " << argv0
+              << " [--rows=N[,N...]] [--repeat=N] [--threads=N] [--seed=N] [--heap] [--layout=rows|dict|cols|lazy]"
+              << " [--json] [--dir=PATH]\n";
+    std::cerr << "Measure TableS throughput, phase by phase, on generated tables\n";
+    std::cerr << "  --rows=N,...  table sizes to run, with optional K/M suffix (default 1K,10K,100K,1M)\n";
+    std::cerr << "  --repeat=N    run each size N times, and report the fastest time for each phase (default 1)\n";
+    std::cerr << "  --threads=N   use up to N threads for table operations (0: one per CPU; default 1)\n";
+    std::cerr << "  --seed=N      random seed for table generation (default 1)\n";
+    std::cerr << "  --heap        allocate table rows individually on the heap, instead of from arenas (rows\n";
+    std::cerr << "                layout only)\n";
+    std::cerr << "  --layout=dict measure the dictionary-encoded table layout (DictTableS) instead of TableS\n";
+    std::cerr << "  --layout=cols measure the column-major table layout (ColTableS) instead of TableS\n";
+    std::cerr << "  --layout=lazy measure the lazily split table layout (LazyTableS) instead of TableS\n";
+    std::cerr << "  --json        write results as JSON, one object per line, instead of TSV\n";
+    std::cerr << "  --dir=PATH    directory for generated input files (default: system temporary directory)\n";
+  }
+
+  // reset the peak resident set size to the current one where the platform allows it (Linux), so that each table
+  //  size reports its own peak rather than that of a larger earlier one
+  void ResetPeakRss()
+  {
+#ifdef __linux__
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+#endif
+  }
+
+  // output that discards everything written to it, as cheaply as the platform allows
+  struct NullOutputS
+  {
+#ifdef WIKITSV_BENCH_POSIX
+    NullOutputS() : fdM(::open("/dev/null", O_WRONLY)), outM(fdM) {}
+    ~NullOutputS() { outM.Flush(); ::close(fdM); }
+    int fdM;
+#else
+    NullOutputS() : fileM("NUL", std::ios::binary), outM(fileM) {}
+    std::ofstream fileM;
+#endif
+    OutputS outM;
+  };
+
+  // size of file in bytes
+  std::size_t FileSize(const std::string& filename)
+  {
+    return static_cast<std::size_t>(std::filesystem::file_size(filename));
+  }
+
+  // time a call to func
+  template <typename Func>
+  double Time(Func func)
+  {
+    const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+    func();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  // append a result for a phase that just finished, along with the current memory use
+  void Record(const char* const phase, const std::size_t rows, const std::size_t bytes, const double seconds,
+              std::vector<ResultS>& results)
+  {
+    results.push_back({phase, rows, bytes, seconds, StatsS::PeakRssKb(), StatsS::CurrentRssKb()});
+  }
+
+  // run all phases once on the given generated TSV file, appending a result for each to results
+  void RunPhases(const std::string& tsvFile, const std::string& wikiFile, const unsigned threads, const bool heap,
+                 std::vector<ResultS>& results)
+  {
+    const std::size_t tsvBytes(FileSize(tsvFile));
+    TableS table;
+    table.threadsM = threads;
+    table.useArenasM = !heap;
+
+    // load, including the implicit Normalize()
+    double seconds(Time([&table, &tsvFile]() { table.LoadTSV(tsvFile); }));
+    const std::size_t rows(table.dataM.size());
+    Record("LoadTSV", rows, tsvBytes, seconds, results);
+
+    // rows are padded lazily, so this only pads the header; still timed, so that results line up with older ones
+    seconds = Time([&table]() { table.Normalize(); });
+    Record("Normalize", rows, tsvBytes, seconds, results);
+
+    seconds = Time([&table]() { table.WikiTitleClean(); });
+    Record("WikiTitleClean", rows, tsvBytes, seconds, results);
+
+    seconds = Time([&table]() { table.WikiTitleSort(); });
+    Record("WikiTitleSort", rows, tsvBytes, seconds, results);
+
+    {
+      NullOutputS null;
+      seconds = Time([&table, &null]() { table.PrintTSV(null.outM); null.outM.Flush(); });
+      Record("PrintTSV", rows, null.outM.BytesWritten(), seconds, results);
+    }
+    {
+      NullOutputS null;
+      seconds = Time([&table, &null]() { table.PrintWiki(null.outM); null.outM.Flush(); });
+      Record("PrintWiki", rows, null.outM.BytesWritten(), seconds, results);
+    }
+
+    // wiki input for the parse phase is the table as printed above
+    {
+      std::ofstream wikiStream(wikiFile, std::ios::binary | std::ios::trunc);
+      OutputS wikiOut(wikiStream);
+      table.PrintWiki(wikiOut);
+      wikiOut.Flush();
+    }
+    table.Clear();
+    TableS wikiTable;
+    wikiTable.threadsM = threads;
+    wikiTable.useArenasM = !heap;
+    seconds = Time([&wikiTable, &wikiFile]() { wikiTable.LoadWiki(wikiFile); });
+    Record("LoadWiki", wikiTable.dataM.size(), FileSize(wikiFile), seconds, results);
+
+    // teardown; the resident set left behind shows how much freed memory the allocator held on to
+    const std::size_t wikiRows(wikiTable.dataM.size());
+    seconds = Time([&wikiTable]() { wikiTable.Clear(); });
+    Record("Clear", wikiRows, 0, seconds, results);
+  }
+
+  // as RunPhases(), for the phases the alternative table layouts (DictTableS, ColTableS, LazyTableS) support
+  template <typename TableT>
+  void RunLayoutPhases(const std::string& tsvFile, const unsigned threads, std::vector<ResultS>& results)
+  {
+    const std::size_t tsvBytes(FileSize(tsvFile));
+    TableT table;
+    table.tableM.threadsM = threads;
+
+    double seconds(Time([&table, &tsvFile]() { table.LoadTSV(tsvFile); }));
+    const std::size_t rows(table.NumRows());
+    Record("LoadTSV", rows, tsvBytes, seconds, results);
+
+    seconds = Time([&table]() { table.WikiTitleClean(); });
+    Record("WikiTitleClean", rows, tsvBytes, seconds, results);
+
+    seconds = Time([&table]() { table.WikiTitleSort(); });
+    Record("WikiTitleSort", rows, tsvBytes, seconds, results);
+
+    {
+      NullOutputS null;
+      seconds = Time([&table, &null]() { table.PrintTSV(null.outM); null.outM.Flush(); });
+      Record("PrintTSV", rows, null.outM.BytesWritten(), seconds, results);
+    }
+    {
+      NullOutputS null;
+      seconds = Time([&table, &null]() { table.PrintWiki(null.outM); null.outM.Flush(); });
+      Record("PrintWiki", rows, null.outM.BytesWritten(), seconds, results);
+    }
+
+    seconds = Time([&table]() { table = TableT(); });
+    Record("Clear", rows, 0, seconds, results);
+  }
+
+  void PrintResult(const ResultS& result, const std::size_t scale, const bool json, OutputS& out)
+  {
+    const double rowsPerSec(result.secondsM > 0 ? result.rowsM / result.secondsM : 0);
+    const double mbPerSec(result.secondsM > 0 ? result.bytesM / result.secondsM / (1 << 20) : 0);
+    char line[512];
+    if (json)
+    {
+      std::snprintf(line, sizeof(line),
+        "{\"scale\":%zu,\"phase\":\"%s\",\"rows\":%zu,\"bytes\":%zu,\"seconds\":%.6f,\"rows_per_s\":%.0f,"
+        "\"mb_per_s\":%.1f,\"peak_rss_kb\":%ld,\"rss_kb\":%ld}\n",
+        scale, result.phaseM, result.rowsM, result.bytesM, result.secondsM, rowsPerSec, mbPerSec,
+        result.peakRssKbM, result.rssKbM);
+    }
+    else
+    {
+      std::snprintf(line, sizeof(line), "%zu\t%s\t%zu\t%zu\t%.6f\t%.0f\t%.1f\t%ld\t%ld\n",
+        scale, result.phaseM, result.rowsM, result.bytesM, result.secondsM, rowsPerSec, mbPerSec,
+        result.peakRssKbM, result.rssKbM);
+    }
+    out.Write(line);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  std::vector<std::size_t> scales{1000, 10000, 100000, 1000000};
+  unsigned repeat(1);
+  unsigned threads(1);
+  unsigned seed(1);
+  bool heap(false);
+  // table layout: rows (TableS), dict, cols or lazy
+  std::string layout("rows");
+  bool json(false);
+  std::string dir;
+  for (int argNum(1); argNum < argc; ++argNum)
+  {
+    const std::string arg(argv[argNum]);
+    bool valid(false);
+    if      (!arg.compare(0, 7, "--rows="))    valid = ParseScales(arg.substr(7), scales);
+    else if (!arg.compare(0, 9, "--repeat="))  valid = ArgsS::ParseCount(arg.substr(9), repeat) && repeat;
+    else if (!arg.compare(0, 10, "--threads=")) valid = ArgsS::ParseCount(arg.substr(10), threads);
+    else if (!arg.compare(0, 7, "--seed="))    valid = ArgsS::ParseCount(arg.substr(7), seed);
+    else if (arg == "--heap")                  valid = heap = true;
+    else if (!arg.compare(0, 9, "--layout="))
+    {
+      layout = arg.substr(9);
+      valid = (layout == "rows" || layout == "dict" || layout == "cols" || layout == "lazy");
+    }
+    else if (arg == "--json")                  valid = json = true;
+    else if (!arg.compare(0, 6, "--dir="))     valid = !(dir = arg.substr(6)).empty();
+    if (!valid)
+    {
+      std::cerr << argv[0] << ": Invalid argument '" << arg << "'\n\n";
+      PrintUsage(argv[0]);
+      return -1;
+    }
+  }
+  // the other layouts allocate their own storage, so --heap would only mislabel their results
+  if (heap && layout != "rows")
+  {
+    std::cerr << argv[0] << ": --heap is only supported with --layout=rows\n\n";
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  try
+  {
+    if (dir.empty()) dir = std::filesystem::temp_directory_path().string();
+    // describe the build, so that runs on different machines/builds aren't compared by mistake
+    std::cerr << "scanner: " << DelimScanS::Name(DelimScanS::Best()) << ", threads: " << threads << ", seed: " << seed
+              << ", allocation: " << (heap ? "heap" : "arena") << ", layout: " << layout << "\n";
+
+    OutputS out(OutputS::FD_STDOUT);
+    if (!json) out.Write("scale\tphase\trows\tbytes\tseconds\trows_per_s\tmb_per_s\tpeak_rss_kb\trss_kb\n");
+    for (const std::size_t scale : scales)
+    {
+      const std::string base((std::filesystem::path(dir) /
+                              ("wikitsv_bench_" + std::to_string(scale) + "_" + std::to_string(seed))).string());
+      const std::string tsvFile(base + ".tsv");
+      const std::string wikiFile(base + ".wiki");
+      {
+        std::ofstream tsvStream(tsvFile, std::ios::binary | std::ios::trunc);
+        if (!tsvStream.is_open()) throw std::runtime_error("Failed to create benchmark input file: '" + tsvFile + "'");
+        OutputS tsvOut(tsvStream);
+        TableGenS(seed).WriteTSV(scale, tsvOut);
+        tsvOut.Flush();
+      }
+
+      ResetPeakRss();
+      std::vector<ResultS> best;
+      for (unsigned run(0); run < repeat; ++run)
+      {
+        std::vector<ResultS> results;
+        if      (layout == "dict") RunLayoutPhases<DictTableS>(tsvFile, threads, results);
+        else if (layout == "cols") RunLayoutPhases<ColTableS>(tsvFile, threads, results);
+        else if (layout == "lazy") RunLayoutPhases<LazyTableS>(tsvFile, threads, results);
+        else                       RunPhases(tsvFile, wikiFile, threads, heap, results);
+        if (best.empty())
+        {
+          best = results;
+          continue;
+        }
+        for (std::size_t phaseNum(0); phaseNum < results.size(); ++phaseNum)
+        {
+          if (results[phaseNum].secondsM < best[phaseNum].secondsM) best[phaseNum] = results[phaseNum];
+        }
+      }
+      std::remove(tsvFile.c_str());
+      std::remove(wikiFile.c_str());
+
+      for (const ResultS& result : best) PrintResult(result, scale, json, out);
+      out.Flush();
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << argv[0] << ": " << e.what() << "\n";
+    return -2;
+  }
+
+  return 0;
+}